@@ -0,0 +1,302 @@
+// ======================================================================
+
+#include "Aggregation.h"
+#include "Utils.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <unordered_map>
+#include <variant>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+const char *countColumn = "count";
+
+// Append value to group key. The variant index separates values of different types;
+// variable length values are prefixed with their length
+
+void appendKey(std::pmr::string &theKey, const TimeSeries::Value &theValue)
+{
+  theKey += static_cast<char>('0' + theValue.index());
+
+  auto appendString = [&theKey](const std::string &theString)
+  {
+    theKey += Fmi::to_string(theString.size());
+    theKey += ':';
+    theKey += theString;
+  };
+
+  if (const auto *s = std::get_if<std::string>(&theValue))
+    appendString(*s);
+  else if (const auto *i = std::get_if<int>(&theValue))
+    theKey.append(reinterpret_cast<const char *>(i), sizeof(*i));
+  else if (const auto *d = std::get_if<double>(&theValue))
+    theKey.append(reinterpret_cast<const char *>(d), sizeof(*d));
+  else if (const auto *t = std::get_if<Fmi::LocalDateTime>(&theValue))
+    appendString(Fmi::to_iso_string(t->utc_time()));
+  else if (const auto *p = std::get_if<TimeSeries::LonLat>(&theValue))
+  {
+    theKey.append(reinterpret_cast<const char *>(&p->lon), sizeof(p->lon));
+    theKey.append(reinterpret_cast<const char *>(&p->lat), sizeof(p->lat));
+  }
+}
+
+// Start of the time interval as an utc time string
+
+TimeSeries::Value intervalStart(const TimeSeries::Value &theValue, std::int64_t theInterval)
+{
+  auto t = timeValue(theValue);
+
+  if (!t)
+    return TimeSeries::None();
+
+  std::int64_t seconds = (*t - Fmi::epoch_time()).total_seconds();
+  std::int64_t remainder = seconds % theInterval;
+
+  if (remainder < 0)
+    remainder += theInterval;
+
+  return Fmi::to_iso_extended_string(Fmi::epoch_time() + Fmi::Seconds(seconds - remainder)) +
+         "Z";
+}
+
+}  // anonymous namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Group values and counts
+ */
+// ----------------------------------------------------------------------
+
+class Aggregation::Groups
+{
+ public:
+  Groups(const std::vector<Key> &theKeys, std::pmr::memory_resource *theArena)
+      : itsKeys(theKeys), itsValues(theKeys.size()), itsIndex(theArena), itsKey(theArena)
+  {
+  }
+
+  // Count the rows of a station or of rejected messages
+
+  void add(const SmartMet::Engine::Avi::QueryValues &theValues)
+  {
+    static const SmartMet::Engine::Avi::ValueVector noValues;
+
+    std::vector<const SmartMet::Engine::Avi::ValueVector *> keyValues;
+    std::size_t nRows = 0;
+
+    for (const auto &values : theValues)
+      nRows = std::max(nRows, values.second.size());
+
+    for (const auto &key : itsKeys)
+    {
+      auto values = theValues.find(key.itsColumn);
+      keyValues.push_back((values != theValues.end()) ? &values->second : &noValues);
+    }
+
+    std::vector<TimeSeries::Value> group(itsKeys.size());
+
+    for (std::size_t row = 0; (row < nRows); row++)
+    {
+      itsKey.clear();
+
+      for (std::size_t k = 0; (k < itsKeys.size()); k++)
+      {
+        const auto &values = *keyValues[k];
+        auto &value = group[k];
+
+        if (row >= values.size())
+          value = TimeSeries::None();
+        else if (itsKeys[k].itsInterval > 0)
+          value = intervalStart(values[row], itsKeys[k].itsInterval);
+        else
+          value = values[row];
+
+        appendKey(itsKey, value);
+      }
+
+      auto pos = itsIndex.emplace(itsKey, itsCounts.size());
+
+      if (pos.second)
+      {
+        for (std::size_t k = 0; (k < itsKeys.size()); k++)
+          itsValues[k].push_back(std::move(group[k]));
+
+        itsCounts.push_back(0);
+      }
+
+      itsCounts[pos.first->second]++;
+    }
+  }
+
+  // Group columns and counts
+
+  SmartMet::Engine::Avi::QueryValues result()
+  {
+    SmartMet::Engine::Avi::QueryValues values;
+
+    // Without keys all rows belong to the only group
+
+    if (itsKeys.empty() && itsCounts.empty())
+      itsCounts.push_back(0);
+
+    for (std::size_t k = 0; (k < itsKeys.size()); k++)
+      values[itsKeys[k].itsName] = std::move(itsValues[k]);
+
+    auto &counts = values[countColumn];
+
+    for (auto count : itsCounts)
+      counts.push_back(static_cast<int>(count));
+
+    return values;
+  }
+
+ private:
+  const std::vector<Key> &itsKeys;
+  std::vector<SmartMet::Engine::Avi::ValueVector> itsValues;  // by key
+  std::vector<std::size_t> itsCounts;
+  std::pmr::unordered_map<std::pmr::string, std::size_t> itsIndex;
+  std::pmr::string itsKey;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+Aggregation::Aggregation(std::vector<Key> theKeys) : itsKeys(std::move(theKeys))
+{
+  try
+  {
+    for (auto key = itsKeys.begin(); (key != itsKeys.end()); key++)
+    {
+      if (key->itsInterval < 0)
+        throw Fmi::Exception(BCP, "Aggregation interval can't be negative");
+
+      if (std::find_if(itsKeys.begin(),
+                       key,
+                       [&key](const Key &other) { return (other.itsName == key->itsName); }) !=
+          key)
+        throw Fmi::Exception(BCP, "Duplicate aggregation key '" + key->itsName + "'");
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Result columns; types of the group columns are taken from the query result
+ */
+// ----------------------------------------------------------------------
+
+SmartMet::Engine::Avi::Columns Aggregation::columns(
+    const SmartMet::Engine::Avi::Columns &theColumns) const
+{
+  try
+  {
+    SmartMet::Engine::Avi::Columns columns;
+
+    for (const auto &key : itsKeys)
+    {
+      auto type = SmartMet::Engine::Avi::ColumnType::String;
+      auto column = std::find_if(theColumns.begin(),
+                                 theColumns.end(),
+                                 [&key](const SmartMet::Engine::Avi::Column &column)
+                                 { return (column.itsName == key.itsColumn); });
+
+      if ((key.itsInterval == 0) && (column != theColumns.end()))
+        type = column->itsType;
+
+      columns.emplace_back(type, key.itsName);
+    }
+
+    columns.emplace_back(SmartMet::Engine::Avi::ColumnType::Integer, countColumn);
+
+    return columns;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Aggregate stations' messages
+ */
+// ----------------------------------------------------------------------
+
+void Aggregation::apply(SmartMet::Engine::Avi::StationQueryData &theStationData,
+                        std::pmr::memory_resource *theArena) const
+{
+  try
+  {
+    Groups groups(itsKeys, theArena);
+
+    for (auto stationId : theStationData.itsStationIds)
+    {
+      auto values = theStationData.itsValues.find(stationId);
+
+      if (values != theStationData.itsValues.end())
+        groups.add(values->second);
+    }
+
+    auto columns = this->columns(theStationData.itsColumns);
+    auto values = groups.result();
+
+    theStationData.itsColumns.swap(columns);
+    theStationData.itsValues.clear();
+    theStationData.itsStationIds.clear();
+
+    if (values[countColumn].empty())
+      return;
+
+    theStationData.itsValues[0] = std::move(values);
+    theStationData.itsStationIds.push_back(0);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Aggregate rejected messages
+ */
+// ----------------------------------------------------------------------
+
+void Aggregation::apply(SmartMet::Engine::Avi::QueryData &theQueryData,
+                        std::pmr::memory_resource *theArena) const
+{
+  try
+  {
+    Groups groups(itsKeys, theArena);
+    groups.add(theQueryData.itsValues);
+
+    auto columns = this->columns(theQueryData.itsColumns);
+
+    theQueryData.itsColumns.swap(columns);
+    theQueryData.itsValues = groups.result();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,61 @@
+// ======================================================================
+/*!
+ * \brief Message counts grouped by column values and time intervals
+ *
+ * Query result rows are counted in a single pass into a hash table keyed
+ * by the group values; only the aggregated table is returned. Groups are
+ * returned in the order of their first row.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class Aggregation
+{
+ public:
+  struct Key
+  {
+    std::string itsName;       // output column
+    std::string itsColumn;     // query result column
+    std::int64_t itsInterval;  // time interval in seconds; 0 to group by value
+  };
+
+  explicit Aggregation(std::vector<Key> theKeys);
+  Aggregation() = delete;
+
+  const std::vector<Key> &keys() const { return itsKeys; }
+
+  // Replace the result with group columns and 'count'. Station data is returned
+  // as a single (pseudo) station with id 0; without keys there is always one row
+
+  void apply(SmartMet::Engine::Avi::StationQueryData &theStationData,
+             std::pmr::memory_resource *theArena = std::pmr::get_default_resource()) const;
+  void apply(SmartMet::Engine::Avi::QueryData &theQueryData,
+             std::pmr::memory_resource *theArena = std::pmr::get_default_resource()) const;
+
+ private:
+  class Groups;
+
+  SmartMet::Engine::Avi::Columns columns(const SmartMet::Engine::Avi::Columns &theColumns) const;
+
+  std::vector<Key> itsKeys;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
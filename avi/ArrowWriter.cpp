@@ -0,0 +1,731 @@
+// ======================================================================
+
+#include "ArrowWriter.h"
+#include "Utils.h"
+#include <macgyver/DateTime.h>
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+// Arrow format constants (Schema.fbs and Message.fbs)
+
+const std::int16_t metadataVersionV5 = 4;
+const std::uint8_t headerSchema = 1;
+const std::uint8_t headerRecordBatch = 3;
+const std::uint8_t typeInt = 2;
+const std::uint8_t typeFloatingPoint = 3;
+const std::uint8_t typeUtf8 = 5;
+const std::uint8_t typeTimestamp = 10;
+const std::int16_t precisionDouble = 2;
+const std::int16_t timeUnitSecond = 0;
+const std::uint32_t continuationMarker = 0xFFFFFFFF;
+
+template <typename T>
+void appendLE(std::string &theOutput, T theValue)
+{
+  std::uint64_t bits = 0;
+  std::memcpy(&bits, &theValue, sizeof(T));
+
+  for (std::size_t i = 0; (i < sizeof(T)); i++, bits >>= 8)
+    theOutput += static_cast<char>(bits & 0xff);
+}
+
+void pad(std::string &theOutput, std::size_t theAlignment)
+{
+  while (theOutput.size() % theAlignment != 0)
+    theOutput += '\0';
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Minimal flatbuffer builder
+ *
+ *        Objects are written front to back: a table is written before the
+ *        strings, vectors and tables it refers to, and the offsets to them
+ *        are patched when they are written. Vtables precede their tables.
+ */
+// ----------------------------------------------------------------------
+
+class FlatBuffer
+{
+ public:
+  struct Slot
+  {
+    int itsId;
+    std::size_t itsSize;  // 1, 2, 4 or 8; offsets have size 4
+    std::int64_t itsValue;
+  };
+
+  using Positions = std::map<int, std::size_t>;
+
+  FlatBuffer() { appendLE<std::uint32_t>(itsData, 0); }
+
+  const std::string &data() const { return itsData; }
+
+  void setRoot(std::size_t theTable) { patchOffset(0, theTable); }
+
+  // Returns the table position and the positions of the slots for patching offsets
+
+  std::size_t table(std::vector<Slot> theSlots, Positions &thePositions)
+  {
+    // Inline fields by decreasing size for packing
+
+    std::stable_sort(theSlots.begin(),
+                     theSlots.end(),
+                     [](const Slot &a, const Slot &b) { return a.itsSize > b.itsSize; });
+
+    std::vector<std::size_t> fieldOffsets;
+    std::size_t tableSize = 4;
+    int nSlots = 0;
+
+    for (const auto &slot : theSlots)
+    {
+      tableSize = (tableSize + slot.itsSize - 1) / slot.itsSize * slot.itsSize;
+      fieldOffsets.push_back(tableSize);
+      tableSize += slot.itsSize;
+      nSlots = std::max(nSlots, slot.itsId + 1);
+    }
+
+    std::vector<std::uint16_t> vtable(nSlots, 0);
+
+    for (std::size_t i = 0; (i < theSlots.size()); i++)
+      vtable[theSlots[i].itsId] = static_cast<std::uint16_t>(fieldOffsets[i]);
+
+    align(2);
+    auto vtablePos = itsData.size();
+    appendLE<std::uint16_t>(itsData, static_cast<std::uint16_t>(4 + 2 * nSlots));
+    appendLE<std::uint16_t>(itsData, static_cast<std::uint16_t>(tableSize));
+
+    for (auto offset : vtable)
+      appendLE<std::uint16_t>(itsData, offset);
+
+    align(8);
+    auto tablePos = itsData.size();
+    appendLE<std::int32_t>(itsData, static_cast<std::int32_t>(tablePos - vtablePos));
+    itsData.resize(tablePos + tableSize, '\0');
+
+    for (std::size_t i = 0; (i < theSlots.size()); i++)
+    {
+      auto pos = tablePos + fieldOffsets[i];
+      thePositions[theSlots[i].itsId] = pos;
+      patch(pos, theSlots[i].itsValue, theSlots[i].itsSize);
+    }
+
+    return tablePos;
+  }
+
+  std::size_t string(std::string_view theValue)
+  {
+    align(4);
+    auto pos = itsData.size();
+    appendLE<std::uint32_t>(itsData, static_cast<std::uint32_t>(theValue.size()));
+    itsData.append(theValue.data(), theValue.size());
+    itsData += '\0';
+    return pos;
+  }
+
+  // Vector of structs of two longs (FieldNode, Buffer)
+
+  std::size_t longPairs(const std::vector<std::pair<std::int64_t, std::int64_t>> &thePairs)
+  {
+    while ((itsData.size() + 4) % 8 != 0)
+      itsData += '\0';
+
+    auto pos = itsData.size();
+    appendLE<std::uint32_t>(itsData, static_cast<std::uint32_t>(thePairs.size()));
+
+    for (const auto &pair : thePairs)
+    {
+      appendLE<std::int64_t>(itsData, pair.first);
+      appendLE<std::int64_t>(itsData, pair.second);
+    }
+
+    return pos;
+  }
+
+  // Vector of tables; returns element positions for patching as offsets
+
+  std::size_t tableVector(std::size_t theSize, std::vector<std::size_t> &theElements)
+  {
+    align(4);
+    auto pos = itsData.size();
+    appendLE<std::uint32_t>(itsData, static_cast<std::uint32_t>(theSize));
+
+    for (std::size_t i = 0; (i < theSize); i++)
+    {
+      theElements.push_back(itsData.size());
+      appendLE<std::uint32_t>(itsData, 0);
+    }
+
+    return pos;
+  }
+
+  void patchOffset(std::size_t theField, std::size_t theTarget)
+  {
+    patch(theField, static_cast<std::int64_t>(theTarget - theField), 4);
+  }
+
+ private:
+  void align(std::size_t theAlignment) { pad(itsData, theAlignment); }
+
+  void patch(std::size_t thePos, std::int64_t theValue, std::size_t theSize)
+  {
+    auto bits = static_cast<std::uint64_t>(theValue);
+
+    for (std::size_t i = 0; (i < theSize); i++, bits >>= 8)
+      itsData[thePos + i] = static_cast<char>(bits & 0xff);
+  }
+
+  std::string itsData;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write encapsulated message: continuation marker, metadata size,
+ *        metadata padded to 8 bytes and the body
+ */
+// ----------------------------------------------------------------------
+
+void writeMessage(std::string &theOutput, const FlatBuffer &theMetadata, const std::string &theBody)
+{
+  auto metadataSize = (theMetadata.data().size() + 7) / 8 * 8;
+
+  appendLE<std::uint32_t>(theOutput, continuationMarker);
+  appendLE<std::int32_t>(theOutput, static_cast<std::int32_t>(metadataSize));
+  theOutput += theMetadata.data();
+  theOutput.append(metadataSize - theMetadata.data().size(), '\0');
+  theOutput += theBody;
+}
+
+// Message table with given header; returns header offset position
+
+std::size_t messageTable(FlatBuffer &theBuffer,
+                         std::uint8_t theHeaderType,
+                         std::int64_t theBodySize)
+{
+  FlatBuffer::Positions positions;
+  auto message = theBuffer.table({{0, 2, metadataVersionV5},
+                                  {1, 1, theHeaderType},
+                                  {2, 4, 0},
+                                  {3, 8, theBodySize}},
+                                 positions);
+  theBuffer.setRoot(message);
+  return positions[2];
+}
+
+// Union type id and type table of field
+
+std::uint8_t typeId(ArrowWriter::Type theType)
+{
+  switch (theType)
+  {
+    case ArrowWriter::Type::Int64:
+      return typeInt;
+    case ArrowWriter::Type::Float64:
+      return typeFloatingPoint;
+    case ArrowWriter::Type::Utf8:
+      return typeUtf8;
+    case ArrowWriter::Type::Timestamp:
+      return typeTimestamp;
+  }
+
+  throw Fmi::Exception(BCP, "Unsupported arrow type");
+}
+
+std::size_t typeTable(FlatBuffer &theBuffer, ArrowWriter::Type theType)
+{
+  FlatBuffer::Positions positions;
+
+  switch (theType)
+  {
+    case ArrowWriter::Type::Int64:
+      return theBuffer.table({{0, 4, 64}, {1, 1, 1}}, positions);
+    case ArrowWriter::Type::Float64:
+      return theBuffer.table({{0, 2, precisionDouble}}, positions);
+    case ArrowWriter::Type::Utf8:
+      return theBuffer.table({}, positions);
+    case ArrowWriter::Type::Timestamp:
+    {
+      auto table = theBuffer.table({{0, 2, timeUnitSecond}, {1, 4, 0}}, positions);
+      theBuffer.patchOffset(positions[1], theBuffer.string("UTC"));
+      return table;
+    }
+  }
+
+  throw Fmi::Exception(BCP, "Unsupported arrow type");
+}
+
+}  // anonymous namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+ArrowWriter::ArrowWriter(std::vector<Field> theFields)
+    : itsFields(std::move(theFields)), itsColumns(itsFields.size())
+{
+  for (std::size_t i = 0; (i < itsFields.size()); i++)
+    if (itsFields[i].itsType == Type::Utf8)
+      itsColumns[i].itsOffsets.push_back(0);
+}
+
+namespace
+{
+std::vector<ArrowWriter::Field> resultFields(const SmartMet::Engine::Avi::Columns &theColumns)
+{
+  std::vector<ArrowWriter::Field> fields;
+
+  for (const auto &column : theColumns)
+    fields.push_back({column.itsName, ArrowWriter::type(column.itsType)});
+
+  return fields;
+}
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct writer of result columns
+ */
+// ----------------------------------------------------------------------
+
+ArrowWriter::ArrowWriter(const SmartMet::Engine::Avi::Columns &theColumns,
+                         ColumnValues theValues,
+                         std::size_t theStations)
+    : itsFields(resultFields(theColumns)),
+      itsColumns(itsFields.size()),
+      itsValues(std::move(theValues)),
+      itsStations(theStations)
+{
+  try
+  {
+    for (const auto &column : theColumns)
+      itsTypes.push_back(column.itsType);
+
+    for (std::size_t i = 0; (i < itsFields.size()); i++)
+      if (itsFields[i].itsType == Type::Utf8)
+        itsColumns[i].itsOffsets.push_back(0);
+
+    if (itsValues.size() != itsTypes.size() * itsStations)
+      throw Fmi::Exception(BCP, "Number of column values does not match the columns");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append validity bit of the next value
+ */
+// ----------------------------------------------------------------------
+
+ArrowWriter::Column &ArrowWriter::column(std::size_t theColumn, bool isValid)
+{
+  auto &col = itsColumns.at(theColumn);
+
+  if (col.itsLength % 8 == 0)
+    col.itsValidity.push_back(0);
+
+  if (isValid)
+    col.itsValidity.back() |= static_cast<std::uint8_t>(1 << (col.itsLength % 8));
+  else
+    col.itsNullCount++;
+
+  col.itsLength++;
+
+  return col;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append values
+ */
+// ----------------------------------------------------------------------
+
+void ArrowWriter::appendNull(std::size_t theColumn)
+{
+  auto &col = column(theColumn, false);
+
+  if (itsFields[theColumn].itsType == Type::Utf8)
+    col.itsOffsets.push_back(col.itsOffsets.back());
+  else
+    col.itsData.append(8, '\0');
+}
+
+void ArrowWriter::appendInt(std::size_t theColumn, std::int64_t theValue)
+{
+  auto type = itsFields.at(theColumn).itsType;
+
+  if ((type != Type::Int64) && (type != Type::Timestamp))
+    throw Fmi::Exception(BCP, "Integer value for non-integer arrow column");
+
+  appendLE(column(theColumn, true).itsData, theValue);
+}
+
+void ArrowWriter::appendDouble(std::size_t theColumn, double theValue)
+{
+  if (itsFields.at(theColumn).itsType != Type::Float64)
+    throw Fmi::Exception(BCP, "Floating point value for non-floating point arrow column");
+
+  appendLE(column(theColumn, true).itsData, theValue);
+}
+
+void ArrowWriter::appendString(std::size_t theColumn, std::string_view theValue)
+{
+  if (itsFields.at(theColumn).itsType != Type::Utf8)
+    throw Fmi::Exception(BCP, "String value for non-string arrow column");
+
+  auto &col = column(theColumn, true);
+
+  if (col.itsData.size() + theValue.size() >
+      static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max()))
+    throw Fmi::Exception(BCP, "Arrow string column batch too large");
+
+  col.itsData.append(theValue.data(), theValue.size());
+  col.itsOffsets.push_back(static_cast<std::int32_t>(col.itsData.size()));
+}
+
+std::size_t ArrowWriter::rows() const
+{
+  return (itsColumns.empty() ? 0 : itsColumns.front().itsLength);
+}
+
+std::size_t ArrowWriter::bytes() const
+{
+  std::size_t bytes = 0;
+
+  for (const auto &col : itsColumns)
+    bytes += col.itsData.size();
+
+  return bytes;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write schema message
+ */
+// ----------------------------------------------------------------------
+
+void ArrowWriter::writeSchema(std::string &theOutput) const
+{
+  try
+  {
+    FlatBuffer buffer;
+    FlatBuffer::Positions positions;
+
+    auto header = messageTable(buffer, headerSchema, 0);
+    buffer.patchOffset(header, buffer.table({{1, 4, 0}}, positions));
+
+    std::vector<std::size_t> fields;
+    buffer.patchOffset(positions[1], buffer.tableVector(itsFields.size(), fields));
+
+    for (std::size_t i = 0; (i < itsFields.size()); i++)
+    {
+      // Nullable field with name, type and no children
+
+      const auto &field = itsFields[i];
+      FlatBuffer::Positions fieldPositions;
+
+      buffer.patchOffset(
+          fields[i],
+          buffer.table({{0, 4, 0}, {1, 1, 1}, {2, 1, typeId(field.itsType)}, {3, 4, 0}, {5, 4, 0}},
+                       fieldPositions));
+      buffer.patchOffset(fieldPositions[0], buffer.string(field.itsName));
+      buffer.patchOffset(fieldPositions[3], typeTable(buffer, field.itsType));
+
+      std::vector<std::size_t> noChildren;
+      buffer.patchOffset(fieldPositions[5], buffer.tableVector(0, noChildren));
+    }
+
+    writeMessage(theOutput, buffer, "");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write current batch
+ */
+// ----------------------------------------------------------------------
+
+void ArrowWriter::writeBatch(std::string &theOutput)
+{
+  try
+  {
+    if (!itsSchemaWritten)
+    {
+      writeSchema(theOutput);
+      itsSchemaWritten = true;
+    }
+
+    auto nRows = rows();
+
+    if (nRows == 0)
+      return;
+
+    // Body buffers: validity bitmap (empty if no nulls), offsets for strings and values
+
+    std::string body;
+    std::vector<std::pair<std::int64_t, std::int64_t>> nodes;
+    std::vector<std::pair<std::int64_t, std::int64_t>> buffers;
+
+    auto addBuffer = [&](const char *theData, std::size_t theSize)
+    {
+      buffers.emplace_back(body.size(), theSize);
+      body.append(theData, theSize);
+      pad(body, 8);
+    };
+
+    for (std::size_t i = 0; (i < itsColumns.size()); i++)
+    {
+      auto &col = itsColumns[i];
+
+      if (col.itsLength != nRows)
+      {
+        Fmi::Exception exception(BCP, "Arrow columns have different number of values");
+        exception.addParameter("Column", itsFields[i].itsName);
+        exception.addParameter("Values", Fmi::to_string(col.itsLength));
+        exception.addParameter("Rows", Fmi::to_string(nRows));
+        throw exception;
+      }
+
+      nodes.emplace_back(col.itsLength, col.itsNullCount);
+
+      if (col.itsNullCount > 0)
+        addBuffer(reinterpret_cast<const char *>(col.itsValidity.data()), col.itsValidity.size());
+      else
+        addBuffer(nullptr, 0);
+
+      if (itsFields[i].itsType == Type::Utf8)
+      {
+        std::string offsets;
+        offsets.reserve(4 * col.itsOffsets.size());
+
+        for (auto offset : col.itsOffsets)
+          appendLE(offsets, offset);
+
+        addBuffer(offsets.data(), offsets.size());
+      }
+
+      addBuffer(col.itsData.data(), col.itsData.size());
+
+      col = Column();
+
+      if (itsFields[i].itsType == Type::Utf8)
+        col.itsOffsets.push_back(0);
+    }
+
+    FlatBuffer buffer;
+    FlatBuffer::Positions positions;
+
+    auto header = messageTable(buffer, headerRecordBatch, static_cast<std::int64_t>(body.size()));
+    buffer.patchOffset(
+        header,
+        buffer.table({{0, 8, static_cast<std::int64_t>(nRows)}, {1, 4, 0}, {2, 4, 0}}, positions));
+    buffer.patchOffset(positions[1], buffer.longPairs(nodes));
+    buffer.patchOffset(positions[2], buffer.longPairs(buffers));
+
+    writeMessage(theOutput, buffer, body);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write remaining rows and end-of-stream marker
+ */
+// ----------------------------------------------------------------------
+
+void ArrowWriter::finish(std::string &theOutput)
+{
+  try
+  {
+    writeBatch(theOutput);
+
+    appendLE<std::uint32_t>(theOutput, continuationMarker);
+    appendLE<std::int32_t>(theOutput, 0);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Arrow type of result column
+ *
+ *        Coordinate pairs are written as strings as in the text formats
+ */
+// ----------------------------------------------------------------------
+
+ArrowWriter::Type ArrowWriter::type(SmartMet::Engine::Avi::ColumnType theType)
+{
+  switch (theType)
+  {
+    case SmartMet::Engine::Avi::ColumnType::Integer:
+      return Type::Int64;
+    case SmartMet::Engine::Avi::ColumnType::Double:
+      return Type::Float64;
+    case SmartMet::Engine::Avi::ColumnType::DateTime:
+      return Type::Timestamp;
+    default:
+      return Type::Utf8;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append result value; missing and non-convertible values are nulls
+ */
+// ----------------------------------------------------------------------
+
+void ArrowWriter::appendValue(std::size_t theColumn,
+                              SmartMet::Engine::Avi::ColumnType theType,
+                              const SmartMet::TimeSeries::Value &theValue)
+{
+  switch (type(theType))
+  {
+    case Type::Int64:
+    {
+      auto value = numericValue(theValue);
+
+      if (value && !std::isnan(*value))
+        appendInt(theColumn, static_cast<std::int64_t>(*value));
+      else
+        appendNull(theColumn);
+
+      break;
+    }
+    case Type::Float64:
+    {
+      auto value = numericValue(theValue);
+
+      if (value && !std::isnan(*value))
+        appendDouble(theColumn, *value);
+      else
+        appendNull(theColumn);
+
+      break;
+    }
+    case Type::Timestamp:
+    {
+      auto value = timeValue(theValue);
+
+      if (value)
+        appendInt(theColumn, (*value - Fmi::epoch_time()).total_seconds());
+      else
+        appendNull(theColumn);
+
+      break;
+    }
+    case Type::Utf8:
+    {
+      const auto *lonlat = std::get_if<SmartMet::TimeSeries::LonLat>(&theValue);
+
+      if (const auto *s = std::get_if<std::string>(&theValue))
+        appendString(theColumn, *s);
+      else if (lonlat && (theType == SmartMet::Engine::Avi::ColumnType::TS_LatLon))
+        appendString(theColumn, Fmi::to_string(lonlat->lat) + ", " + Fmi::to_string(lonlat->lon));
+      else if (lonlat)
+        appendString(theColumn, Fmi::to_string(lonlat->lon) + ", " + Fmi::to_string(lonlat->lat));
+      else
+        appendNull(theColumn);
+
+      break;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append rows of a station; rows of a station are in the same batch
+ */
+// ----------------------------------------------------------------------
+
+void ArrowWriter::appendStation(std::size_t theStation)
+{
+  // Missing values of a column are written as nulls
+
+  std::size_t rows = 0;
+
+  for (std::size_t column = 0; (column < itsTypes.size()); column++)
+    rows = std::max(rows, itsValues[column * itsStations + theStation]->size());
+
+  for (std::size_t column = 0; (column < itsTypes.size()); column++)
+  {
+    const auto &values = *itsValues[column * itsStations + theStation];
+
+    for (const auto &value : values)
+      appendValue(column, itsTypes[column], value);
+
+    for (std::size_t row = values.size(); (row < rows); row++)
+      appendNull(column);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write record batches of result columns
+ */
+// ----------------------------------------------------------------------
+
+bool ArrowWriter::write(std::string &theOutput, std::size_t theMinBytes)
+{
+  try
+  {
+    if (itsFinished)
+      return false;
+
+    auto start = theOutput.size();
+
+    while (itsStation < itsStations)
+    {
+      appendStation(itsStation++);
+
+      if ((rows() >= batchRows) || (bytes() >= theMinBytes))
+      {
+        writeBatch(theOutput);
+
+        if (theOutput.size() - start >= theMinBytes)
+          return true;
+      }
+    }
+
+    finish(theOutput);
+    itsFinished = true;
+
+    return false;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,131 @@
+// ======================================================================
+/*!
+ * \brief Apache Arrow IPC stream writer
+ *
+ * Writes the schema message, record batches of the appended column
+ * values and the end-of-stream marker of the Arrow IPC streaming format.
+ * Only the flat column types needed for query results are supported;
+ * the flatbuffer metadata is encoded directly without the Arrow library.
+ *
+ * When constructed from query result columns, the rows are appended and
+ * written in record batches by write(), so that the batches can be sent
+ * while the rest of the result is still being written.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "ResultWriter.h"
+#include <engines/avi/Engine.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class ArrowWriter : public ResultWriter
+{
+ public:
+  enum class Type
+  {
+    Int64,
+    Float64,
+    Utf8,
+    Timestamp  // seconds since epoch, UTC
+  };
+
+  struct Field
+  {
+    std::string itsName;
+    Type itsType;
+  };
+
+  // Values of column c for station s are at index c * theStations + s
+
+  using ColumnValues = std::pmr::vector<const SmartMet::Engine::Avi::ValueVector *>;
+
+  // Max number of rows in a record batch written from result columns
+
+  static constexpr std::size_t batchRows = 65536;
+
+  explicit ArrowWriter(std::vector<Field> theFields);
+  ArrowWriter(const SmartMet::Engine::Avi::Columns &theColumns,
+              ColumnValues theValues,
+              std::size_t theStations);
+  ArrowWriter() = delete;
+  ArrowWriter(const ArrowWriter &other) = delete;
+  ArrowWriter &operator=(const ArrowWriter &other) = delete;
+
+  // Values are appended column by column; all columns must have the same
+  // number of values when the batch is written
+
+  void appendNull(std::size_t theColumn);
+  void appendInt(std::size_t theColumn, std::int64_t theValue);
+  void appendDouble(std::size_t theColumn, double theValue);
+  void appendString(std::size_t theColumn, std::string_view theValue);
+
+  // Number of rows and bytes of values in the current batch
+
+  std::size_t rows() const;
+  std::size_t bytes() const;
+
+  // Append the schema (before the first batch) and the current batch to the output
+
+  void writeBatch(std::string &theOutput);
+
+  // Append the remaining rows, the schema if not yet written and end-of-stream marker
+
+  void finish(std::string &theOutput);
+
+  // Append rows of the result columns and write them in record batches; the stream is
+  // finished when all rows have been written. A batch is written when it has batchRows
+  // rows or theMinBytes bytes of values
+
+  bool write(std::string &theOutput, std::size_t theMinBytes) override;
+
+  static Type type(SmartMet::Engine::Avi::ColumnType theType);
+
+ private:
+  struct Column
+  {
+    std::vector<std::uint8_t> itsValidity;
+    std::size_t itsLength = 0;
+    std::size_t itsNullCount = 0;
+    std::string itsData;                  // fixed width values or string bytes
+    std::vector<std::int32_t> itsOffsets;  // string offsets
+  };
+
+  Column &column(std::size_t theColumn, bool isValid);
+
+  void writeSchema(std::string &theOutput) const;
+  void appendValue(std::size_t theColumn,
+                   SmartMet::Engine::Avi::ColumnType theType,
+                   const SmartMet::TimeSeries::Value &theValue);
+  void appendStation(std::size_t theStation);
+
+  const std::vector<Field> itsFields;
+  std::vector<Column> itsColumns;
+  bool itsSchemaWritten = false;
+
+  // Result columns written by write()
+
+  std::vector<SmartMet::Engine::Avi::ColumnType> itsTypes;
+  const ColumnValues itsValues;
+  const std::size_t itsStations = 0;
+  std::size_t itsStation = 0;
+  bool itsFinished = false;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,329 @@
+// ======================================================================
+
+#include "Compression.h"
+#include <boost/algorithm/string.hpp>
+#include <brotli/encode.h>
+#include <macgyver/Exception.h>
+#include <zlib.h>
+#include <zstd.h>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace Compression
+{
+namespace
+{
+// Compression levels are chosen for compressing every response on the fly
+
+const int gzipLevel = 6;
+const int brotliQuality = 5;
+const int zstdLevel = 3;
+
+std::string gzip(std::string_view theData)
+{
+  z_stream stream{};
+
+  // Window bits 15 + 16 selects the gzip wrapper
+
+  if (deflateInit2(&stream, gzipLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw Fmi::Exception(BCP, "Failed to initialize gzip compression");
+
+  std::string out(deflateBound(&stream, theData.size()), '\0');
+
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(theData.data()));
+  stream.avail_in = theData.size();
+  stream.next_out = reinterpret_cast<Bytef *>(out.data());
+  stream.avail_out = out.size();
+
+  auto status = deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  if (status != Z_STREAM_END)
+    throw Fmi::Exception(BCP, "gzip compression failed");
+
+  return out;
+}
+
+std::string brotli(std::string_view theData)
+{
+  std::size_t size = BrotliEncoderMaxCompressedSize(theData.size());
+  std::string out(size, '\0');
+
+  if (BrotliEncoderCompress(brotliQuality,
+                            BROTLI_DEFAULT_WINDOW,
+                            BROTLI_MODE_TEXT,
+                            theData.size(),
+                            reinterpret_cast<const std::uint8_t *>(theData.data()),
+                            &size,
+                            reinterpret_cast<std::uint8_t *>(out.data())) == BROTLI_FALSE)
+    throw Fmi::Exception(BCP, "brotli compression failed");
+
+  out.resize(size);
+  return out;
+}
+
+// Compression context of the thread, reused since small responses are typical
+
+ZSTD_CCtx *compressionContext()
+{
+  thread_local std::unique_ptr<ZSTD_CCtx, std::size_t (*)(ZSTD_CCtx *)> context(ZSTD_createCCtx(),
+                                                                               ZSTD_freeCCtx);
+  if (!context)
+    throw Fmi::Exception(BCP, "Failed to create zstd compression context");
+
+  return context.get();
+}
+
+std::string zstd(std::string_view theData)
+{
+  std::string out(ZSTD_compressBound(theData.size()), '\0');
+
+  auto size = ZSTD_compressCCtx(
+      compressionContext(), out.data(), out.size(), theData.data(), theData.size(), zstdLevel);
+
+  if (ZSTD_isError(size))
+    throw Fmi::Exception(BCP, "zstd compression failed").addParameter("Error",
+                                                                      ZSTD_getErrorName(size));
+
+  out.resize(size);
+  return out;
+}
+
+// Encoding of Accept-Encoding token; Identity if not supported
+
+Encoding encoding(std::string_view theToken)
+{
+  if ((theToken == "gzip") || (theToken == "x-gzip"))
+    return Encoding::Gzip;
+  if (theToken == "br")
+    return Encoding::Brotli;
+  if (theToken == "zstd")
+    return Encoding::Zstd;
+  if (theToken == "zstd-dict")
+    return Encoding::ZstdDictionary;
+  return Encoding::Identity;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Load dictionary
+ */
+// ----------------------------------------------------------------------
+
+Dictionary::Dictionary(const std::string &theFilename)
+{
+  try
+  {
+    std::ifstream in(theFilename, std::ios::binary);
+
+    if (!in)
+      throw Fmi::Exception(BCP, "Failed to open zstd dictionary").addParameter("File", theFilename);
+
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (data.empty())
+      throw Fmi::Exception(BCP, "Empty zstd dictionary").addParameter("File", theFilename);
+
+    itsDictionary = ZSTD_createCDict(data.data(), data.size(), zstdLevel);
+
+    if (!itsDictionary)
+      throw Fmi::Exception(BCP, "Failed to load zstd dictionary").addParameter("File", theFilename);
+
+    itsId = ZSTD_getDictID_fromDict(data.data(), data.size());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+Dictionary::~Dictionary()
+{
+  ZSTD_freeCDict(itsDictionary);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compress with the dictionary
+ */
+// ----------------------------------------------------------------------
+
+std::string Dictionary::compress(std::string_view theData) const
+{
+  try
+  {
+    std::string out(ZSTD_compressBound(theData.size()), '\0');
+
+    auto size = ZSTD_compress_usingCDict(compressionContext(),
+                                         out.data(),
+                                         out.size(),
+                                         theData.data(),
+                                         theData.size(),
+                                         itsDictionary);
+
+    if (ZSTD_isError(size))
+      throw Fmi::Exception(BCP, "zstd dictionary compression failed")
+          .addParameter("Error", ZSTD_getErrorName(size));
+
+    out.resize(size);
+    return out;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Content-Encoding header value
+ */
+// ----------------------------------------------------------------------
+
+std::string_view name(Encoding theEncoding)
+{
+  switch (theEncoding)
+  {
+    case Encoding::Gzip:
+      return "gzip";
+    case Encoding::Brotli:
+      return "br";
+    case Encoding::Zstd:
+      return "zstd";
+    case Encoding::ZstdDictionary:
+      return "zstd-dict";
+    case Encoding::Identity:
+      break;
+  }
+
+  return "identity";
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Select the encoding with highest quality value accepted by the client
+ *
+ *        Encodings not listed get the quality value of '*', if given. The
+ *        dictionary encoding is used only if listed explicitly, since a client
+ *        accepting any encoding does not have the dictionary
+ */
+// ----------------------------------------------------------------------
+
+Encoding negotiate(std::string_view theAcceptEncoding, const Encodings &theEnabled)
+{
+  try
+  {
+    std::array<double, encodingCount> quality{};
+    std::array<bool, encodingCount> listed{};
+    double wildcard = 0;
+
+    std::vector<std::string> items;
+    boost::algorithm::split(items, theAcceptEncoding, boost::algorithm::is_any_of(","));
+
+    for (auto &item : items)
+    {
+      double q = 1;
+      auto pos = item.find(';');
+
+      if (pos != std::string::npos)
+      {
+        auto parameter = boost::algorithm::trim_copy(item.substr(pos + 1));
+
+        if (boost::algorithm::istarts_with(parameter, "q="))
+          q = std::strtod(parameter.c_str() + 2, nullptr);
+
+        item.erase(pos);
+      }
+
+      boost::algorithm::trim(item);
+      boost::algorithm::to_lower(item);
+
+      if (item == "*")
+        wildcard = q;
+      else
+      {
+        auto i = index(encoding(item));
+        quality[i] = q;
+        listed[i] = true;
+      }
+    }
+
+    auto best = Encoding::Identity;
+    double bestQuality = 0;
+
+    for (auto candidate :
+         {Encoding::ZstdDictionary, Encoding::Zstd, Encoding::Brotli, Encoding::Gzip})
+    {
+      auto i = index(candidate);
+      auto q = (listed[i] ? quality[i] : (candidate == Encoding::ZstdDictionary ? 0 : wildcard));
+
+      if (theEnabled[i] && (q > bestQuality))
+      {
+        best = candidate;
+        bestQuality = q;
+      }
+    }
+
+    return best;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compress data with given encoding
+ */
+// ----------------------------------------------------------------------
+
+std::string compress(std::string_view theData,
+                     Encoding theEncoding,
+                     const Dictionary *theDictionary)
+{
+  try
+  {
+    switch (theEncoding)
+    {
+      case Encoding::ZstdDictionary:
+        if (!theDictionary)
+          throw Fmi::Exception(BCP, "zstd dictionary is not available");
+        return theDictionary->compress(theData);
+      case Encoding::Gzip:
+        return gzip(theData);
+      case Encoding::Brotli:
+        return brotli(theData);
+      case Encoding::Zstd:
+        return zstd(theData);
+      case Encoding::Identity:
+        break;
+    }
+
+    return std::string(theData);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Compression
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
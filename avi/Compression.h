@@ -0,0 +1,84 @@
+// ======================================================================
+/*!
+ * \brief Content-encoding negotiation and compression of responses
+ */
+// ======================================================================
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+struct ZSTD_CDict_s;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace Compression
+{
+enum class Encoding
+{
+  Identity,
+  Gzip,
+  Brotli,
+  Zstd,
+  ZstdDictionary  // zstd with the TAC message dictionary
+};
+
+constexpr std::size_t encodingCount = 5;
+
+using Encodings = std::array<bool, encodingCount>;
+
+constexpr std::size_t index(Encoding theEncoding)
+{
+  return static_cast<std::size_t>(theEncoding);
+}
+
+// Content-Encoding header value
+
+std::string_view name(Encoding theEncoding);
+
+// Trained zstd dictionary; compression with it is thread safe
+
+class Dictionary
+{
+ public:
+  explicit Dictionary(const std::string &theFilename);
+  ~Dictionary();
+  Dictionary() = delete;
+  Dictionary(const Dictionary &other) = delete;
+  Dictionary &operator=(const Dictionary &other) = delete;
+
+  // Dictionary id; 0 for raw content dictionaries
+
+  unsigned int id() const { return itsId; }
+
+  std::string compress(std::string_view theData) const;
+
+ private:
+  ZSTD_CDict_s *itsDictionary = nullptr;
+  unsigned int itsId = 0;
+};
+
+// Best enabled encoding accepted in the Accept-Encoding header. The dictionary is preferred
+// over zstd, zstd over brotli and brotli over gzip if the client weights them equally
+
+Encoding negotiate(std::string_view theAcceptEncoding, const Encodings &theEnabled);
+
+// The dictionary is required for Encoding::ZstdDictionary
+
+std::string compress(std::string_view theData,
+                     Encoding theEncoding,
+                     const Dictionary *theDictionary = nullptr);
+
+}  // namespace Compression
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -65,6 +65,29 @@ Config::Config(const string &theConfigFileName) : ConfigBase(theConfigFileName)
     if (maxMessageTimeRangeDays < 0)
       maxMessageTimeRangeDays = maxMessageTimeRangeDaysDefault;
 
+    // Max approximate size of result values in bytes; if missing or 0, unlimited
+
+    long long maxResultBytes = 0;
+
+    if (theConfig.exists("message.maxresultbytes"))
+      theConfig.lookupValue("message.maxresultbytes", maxResultBytes);
+
+    if (maxResultBytes < 0)
+      throw Fmi::Exception(BCP, "message.maxresultbytes can't be negative");
+
+    // Max number and total length in bytes of message text filter ('contains' and 'match')
+    // patterns. The filter allocates a 1 KiB transition table for each pattern byte
+
+    if (theConfig.exists("message.maxfilterpatterns"))
+      theConfig.lookupValue("message.maxfilterpatterns", itsMaxFilterPatterns);
+
+    if (theConfig.exists("message.maxfilterbytes"))
+      theConfig.lookupValue("message.maxfilterbytes", itsMaxFilterBytes);
+
+    if ((itsMaxFilterPatterns == 0) || (itsMaxFilterBytes == 0))
+      throw Fmi::Exception(BCP,
+                           "message.maxfilterpatterns and message.maxfilterbytes must be positive");
+
     // Allow multiple location options ?
 
     bool allowMultipleLocationOptions = false;
@@ -74,6 +97,212 @@ Config::Config(const string &theConfigFileName) : ConfigBase(theConfigFileName)
     else
       allowMultipleLocationOptions = false;
 
+    // In-memory station index for resolving bbox, coordinate and wkt locations; refresh
+    // interval in seconds and max number of cached station lists (resolved locations)
+
+    if (theConfig.exists("stationindex.enabled"))
+      theConfig.lookupValue("stationindex.enabled", itsStationIndexEnabled);
+
+    if (theConfig.exists("stationindex.refreshinterval"))
+      theConfig.lookupValue("stationindex.refreshinterval", itsStationIndexRefreshInterval);
+
+    if (theConfig.exists("stationindex.cachesize"))
+      theConfig.lookupValue("stationindex.cachesize", itsStationIndexCacheSize);
+
+    if (itsStationIndexRefreshInterval == 0)
+      throw Fmi::Exception(BCP, "stationindex.refreshinterval must be positive");
+
+    // Negative cache for unknown locations (cleared when stations are refreshed) and for
+    // queries returning no rows (time to live in seconds; cleared when new messages arrive)
+
+    if (theConfig.exists("negativecache.enabled"))
+      theConfig.lookupValue("negativecache.enabled", itsNegativeCacheEnabled);
+
+    if (theConfig.exists("negativecache.maxsize"))
+      theConfig.lookupValue("negativecache.maxsize", itsNegativeCacheSize);
+
+    if (theConfig.exists("negativecache.emptyresultttl"))
+      theConfig.lookupValue("negativecache.emptyresultttl", itsEmptyResultTTL);
+
+    // New message detection; poll interval in seconds and message time lookback in minutes
+
+    if (theConfig.exists("messagemonitor.enabled"))
+      theConfig.lookupValue("messagemonitor.enabled", itsMessageMonitorEnabled);
+
+    if (theConfig.exists("messagemonitor.pollinterval"))
+      theConfig.lookupValue("messagemonitor.pollinterval", itsMessageMonitorPollInterval);
+
+    if (theConfig.exists("messagemonitor.lookback"))
+      theConfig.lookupValue("messagemonitor.lookback", itsMessageMonitorLookback);
+
+    if ((itsMessageMonitorPollInterval == 0) || (itsMessageMonitorLookback == 0))
+      throw Fmi::Exception(BCP,
+                           "messagemonitor.pollinterval and messagemonitor.lookback must be "
+                           "positive");
+
+    // Pre-rendered path style latest message responses; maximum age in seconds (renditions
+    // are dropped earlier when message monitor detects a new message for the station)
+
+    if (theConfig.exists("latest.enabled"))
+      theConfig.lookupValue("latest.enabled", itsLatestCacheEnabled);
+
+    if (theConfig.exists("latest.maxsize"))
+      theConfig.lookupValue("latest.maxsize", itsLatestCacheSize);
+
+    if (theConfig.exists("latest.maxage"))
+      theConfig.lookupValue("latest.maxage", itsLatestCacheMaxAge);
+
+    if (theConfig.exists("latest.param"))
+      theConfig.lookupValue("latest.param", itsLatestParameters);
+
+    if (itsLatestParameters.empty())
+      throw Fmi::Exception(BCP, "latest.param must not be empty");
+
+    // Incremental (since=<cursor>) queries; message time lookback in minutes. Message time
+    // range is used to restrict the query, messages are then filtered by creation time
+
+    if (theConfig.exists("cursor.lookback"))
+      theConfig.lookupValue("cursor.lookback", itsCursorLookback);
+
+    // Engine call deadlines in seconds for latest message (observation time), time range,
+    // incremental and rejected message queries; 0 disables the deadline. Engine calls
+    // exceeding the deadline are left running, new queries are rejected while 'maxoverdue'
+    // such calls are running
+
+    if (theConfig.exists("deadline.enabled"))
+      theConfig.lookupValue("deadline.enabled", itsDeadlinesEnabled);
+
+    if (theConfig.exists("deadline.latest"))
+      theConfig.lookupValue("deadline.latest", itsLatestDeadline);
+
+    if (theConfig.exists("deadline.range"))
+      theConfig.lookupValue("deadline.range", itsRangeDeadline);
+
+    if (theConfig.exists("deadline.incremental"))
+      theConfig.lookupValue("deadline.incremental", itsIncrementalDeadline);
+
+    if (theConfig.exists("deadline.rejected"))
+      theConfig.lookupValue("deadline.rejected", itsRejectedDeadline);
+
+    if (theConfig.exists("deadline.maxoverdue"))
+      theConfig.lookupValue("deadline.maxoverdue", itsMaxOverdueQueries);
+
+    if (itsMaxOverdueQueries == 0)
+      throw Fmi::Exception(BCP, "deadline.maxoverdue must be positive");
+
+    // Engine calls with a deadline are run by a fixed number of threads; max number of
+    // calls waiting for a thread
+
+    if (theConfig.exists("deadline.threads"))
+      theConfig.lookupValue("deadline.threads", itsDeadlineThreads);
+
+    if (theConfig.exists("deadline.maxqueued"))
+      theConfig.lookupValue("deadline.maxqueued", itsDeadlineMaxQueued);
+
+    if (itsDeadlineThreads == 0)
+      throw Fmi::Exception(BCP, "deadline.threads must be positive");
+
+    // Query scheduling; number of threads executing the queries and max number of
+    // queries waiting for a thread
+
+    if (theConfig.exists("scheduler.enabled"))
+      theConfig.lookupValue("scheduler.enabled", itsSchedulerEnabled);
+
+    if (theConfig.exists("scheduler.threads"))
+      theConfig.lookupValue("scheduler.threads", itsSchedulerThreads);
+
+    if (theConfig.exists("scheduler.maxqueued"))
+      theConfig.lookupValue("scheduler.maxqueued", itsSchedulerMaxQueued);
+
+    // Bulk (time range and rejected message) queries are run by at most 'bulkthreads'
+    // threads and have their own queue
+
+    if (theConfig.exists("scheduler.bulkthreads"))
+      theConfig.lookupValue("scheduler.bulkthreads", itsSchedulerBulkThreads);
+
+    if (theConfig.exists("scheduler.bulkmaxqueued"))
+      theConfig.lookupValue("scheduler.bulkmaxqueued", itsSchedulerBulkMaxQueued);
+
+    if (itsSchedulerThreads == 0)
+      throw Fmi::Exception(BCP, "scheduler.threads must be positive");
+
+    if ((itsSchedulerBulkThreads == 0) || (itsSchedulerBulkThreads > itsSchedulerThreads))
+      throw Fmi::Exception(BCP, "scheduler.bulkthreads must be between 1 and scheduler.threads");
+
+    // Cache of parsed queries by apikey group and query string
+
+    if (theConfig.exists("querycache.enabled"))
+      theConfig.lookupValue("querycache.enabled", itsQueryCacheEnabled);
+
+    if (theConfig.exists("querycache.maxsize"))
+      theConfig.lookupValue("querycache.maxsize", itsQueryCacheSize);
+
+    if (itsQueryCacheSize == 0)
+      throw Fmi::Exception(BCP, "querycache.maxsize must be positive");
+
+    // Server-Sent Events subscriptions for new messages (requires message monitor); buffer size
+    // is the number of buffered events, keepalive interval in seconds
+
+    if (theConfig.exists("subscription.enabled"))
+      theConfig.lookupValue("subscription.enabled", itsSubscriptionsEnabled);
+
+    if (theConfig.exists("subscription.buffersize"))
+      theConfig.lookupValue("subscription.buffersize", itsSubscriptionBufferSize);
+
+    if (theConfig.exists("subscription.keepalive"))
+      theConfig.lookupValue("subscription.keepalive", itsSubscriptionKeepAlive);
+
+    if (theConfig.exists("subscription.maxsubscribers"))
+      theConfig.lookupValue("subscription.maxsubscribers", itsMaxSubscribers);
+
+    if (itsSubscriptionsEnabled && !itsMessageMonitorEnabled)
+      throw Fmi::Exception(BCP, "subscription requires messagemonitor to be enabled");
+
+    if ((itsSubscriptionBufferSize == 0) || (itsSubscriptionKeepAlive == 0))
+      throw Fmi::Exception(BCP,
+                           "subscription.buffersize and subscription.keepalive must be positive");
+
+    if (itsMaxSubscribers == 0)
+      throw Fmi::Exception(BCP, "subscription.maxsubscribers must be positive");
+
+    // Batch queries; max number of queries in a request and number of queries executed
+    // concurrently
+
+    if (theConfig.exists("batch.enabled"))
+      theConfig.lookupValue("batch.enabled", itsBatchQueriesEnabled);
+
+    if (theConfig.exists("batch.maxqueries"))
+      theConfig.lookupValue("batch.maxqueries", itsMaxBatchQueries);
+
+    if (theConfig.exists("batch.concurrency"))
+      theConfig.lookupValue("batch.concurrency", itsBatchConcurrency);
+
+    if (itsBatchConcurrency == 0)
+      throw Fmi::Exception(BCP, "batch.concurrency must be positive");
+
+    // Compression of responses; smaller responses and disabled encodings are sent uncompressed
+
+    if (theConfig.exists("compression.enabled"))
+      theConfig.lookupValue("compression.enabled", itsCompressionEnabled);
+
+    if (theConfig.exists("compression.minsize"))
+      theConfig.lookupValue("compression.minsize", itsCompressionMinSize);
+
+    for (auto encoding : {Compression::Encoding::Gzip,
+                          Compression::Encoding::Brotli,
+                          Compression::Encoding::Zstd})
+    {
+      std::string option = "compression." + std::string(Compression::name(encoding));
+
+      if (theConfig.exists(option))
+        theConfig.lookupValue(option, itsCompressionEncodings[Compression::index(encoding)]);
+    }
+
+    // Dictionary for zstd-dict encoding, trained with 'make dictionary'
+
+    if (theConfig.exists("compression.dictionary"))
+      theConfig.lookupValue("compression.dictionary", itsCompressionDictionary);
+
     // Query limitations for apikey groups (groups are implemented as token values for
     // service 'avi' in authentication database). Apikey's group membership is checked
     // in alphabetical group name (token value) order until first (if any) membership
@@ -84,8 +313,11 @@ Config::Config(const string &theConfigFileName) : ConfigBase(theConfigFileName)
     // Group limitations are disabled (the default limitations are used) if
     // apikey.disabled is set to true
 
-    QueryLimits defaultLimits(
-        maxMessageStations, maxMessages, maxMessageTimeRangeDays, allowMultipleLocationOptions);
+    QueryLimits defaultLimits(maxMessageStations,
+                              maxMessages,
+                              maxMessageTimeRangeDays,
+                              allowMultipleLocationOptions,
+                              static_cast<unsigned long long>(maxResultBytes));
     const char *optDisabled = "apikey.disabled";
     const char *optGroups = "apikey.groups";
     bool disabled = false;
@@ -146,6 +378,29 @@ Config::Config(const string &theConfigFileName) : ConfigBase(theConfigFileName)
                 groupLimits.setMaxMessageTimeRangeDays(
                     (value >= 0) ? value : maxMessageTimeRangeDaysDefault);
             }
+            else if (paramName == "deadline")
+            {
+              int value = group[j];
+
+              if (value < 0)
+                throw Fmi::Exception(BCP, "Value can't be negative");
+
+              groupLimits.setDeadline(static_cast<unsigned int>(value));
+            }
+            else if (paramName == "maxresultbytes")
+            {
+              long long value = group[j];
+
+              if (value < 0)
+                throw Fmi::Exception(BCP, "Value can't be negative");
+
+              groupLimits.setMaxResultBytes(static_cast<unsigned long long>(value));
+            }
+            else if (paramName == "bulk")
+            {
+              bool value = group[j];
+              groupLimits.setBulkQueries(value);
+            }
             else if (paramName == "multiplelocationoptions")
             {
               bool allowMultipleLocationOptions = false;
@@ -189,6 +444,18 @@ Config::Config(const string &theConfigFileName) : ConfigBase(theConfigFileName)
 
 const QueryLimits &Config::getQueryLimits(
     const SmartMet::Engine::Authentication::Engine *authEngine, const std::string &apiKey) const
+{
+  return getGroupQueryLimits(getQueryLimitsGroup(authEngine, apiKey));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the name of the query limits group of the apikey
+ */
+// ----------------------------------------------------------------------
+
+const std::string &Config::getQueryLimitsGroup(
+    const SmartMet::Engine::Authentication::Engine *authEngine, const std::string &apiKey) const
 {
   // The default limits are stored as the last map entry
 
@@ -201,6 +468,13 @@ const QueryLimits &Config::getQueryLimits(
         break;
   }
 
+  return (it != itsQueryLimits.end()) ? it->first : itsQueryLimits.crbegin()->first;
+}
+
+const QueryLimits &Config::getGroupQueryLimits(const std::string &group) const
+{
+  auto it = itsQueryLimits.find(group);
+
   return (it != itsQueryLimits.end()) ? it->second : itsQueryLimits.crbegin()->second;
 }
 
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "Compression.h"
 #include <engines/authentication/Engine.h>
 #include <spine/ConfigBase.h>
 #include <spine/TableFormatterOptions.h>
@@ -26,11 +27,114 @@ class Config : public ConfigBase
   const TableFormatterOptions &tableFormatterOptions() const { return itsTableFormatterOptions; }
   const QueryLimits &getQueryLimits(const SmartMet::Engine::Authentication::Engine *authEngine,
                                     const std::string &apiKey) const;
+  const std::string &getQueryLimitsGroup(const SmartMet::Engine::Authentication::Engine *authEngine,
+                                         const std::string &apiKey) const;
+  const QueryLimits &getGroupQueryLimits(const std::string &group) const;
   bool useAuthentication() const { return itsUseAuthEngine; }
 
+  unsigned int maxFilterPatterns() const { return itsMaxFilterPatterns; }
+  unsigned int maxFilterBytes() const { return itsMaxFilterBytes; }
+
+  bool useStationIndex() const { return itsStationIndexEnabled; }
+  unsigned int stationIndexRefreshInterval() const { return itsStationIndexRefreshInterval; }
+  unsigned int stationIndexCacheSize() const { return itsStationIndexCacheSize; }
+
+  bool useNegativeCache() const { return itsNegativeCacheEnabled; }
+  unsigned int negativeCacheSize() const { return itsNegativeCacheSize; }
+  unsigned int emptyResultTTL() const { return itsEmptyResultTTL; }
+
+  bool useMessageMonitor() const { return itsMessageMonitorEnabled; }
+  unsigned int messageMonitorPollInterval() const { return itsMessageMonitorPollInterval; }
+  unsigned int messageMonitorLookback() const { return itsMessageMonitorLookback; }
+
+  bool useLatestCache() const { return itsLatestCacheEnabled; }
+  unsigned int latestCacheSize() const { return itsLatestCacheSize; }
+  unsigned int latestCacheMaxAge() const { return itsLatestCacheMaxAge; }
+  const std::string &latestParameters() const { return itsLatestParameters; }
+
+  unsigned int cursorLookback() const { return itsCursorLookback; }
+
+  // Engine call deadlines in seconds by query class
+
+  bool useDeadlines() const { return itsDeadlinesEnabled; }
+  unsigned int latestDeadline() const { return itsLatestDeadline; }
+  unsigned int rangeDeadline() const { return itsRangeDeadline; }
+  unsigned int incrementalDeadline() const { return itsIncrementalDeadline; }
+  unsigned int rejectedDeadline() const { return itsRejectedDeadline; }
+  unsigned int maxOverdueQueries() const { return itsMaxOverdueQueries; }
+  unsigned int deadlineThreads() const { return itsDeadlineThreads; }
+  unsigned int deadlineMaxQueued() const { return itsDeadlineMaxQueued; }
+
+  bool useScheduler() const { return itsSchedulerEnabled; }
+  unsigned int schedulerThreads() const { return itsSchedulerThreads; }
+  unsigned int schedulerMaxQueued() const { return itsSchedulerMaxQueued; }
+  unsigned int schedulerBulkThreads() const { return itsSchedulerBulkThreads; }
+  unsigned int schedulerBulkMaxQueued() const { return itsSchedulerBulkMaxQueued; }
+
+  bool useQueryCache() const { return itsQueryCacheEnabled; }
+  unsigned int queryCacheSize() const { return itsQueryCacheSize; }
+
+  bool useSubscriptions() const { return itsSubscriptionsEnabled; }
+  unsigned int subscriptionBufferSize() const { return itsSubscriptionBufferSize; }
+  unsigned int subscriptionKeepAlive() const { return itsSubscriptionKeepAlive; }
+  unsigned int maxSubscribers() const { return itsMaxSubscribers; }
+
+  bool useBatchQueries() const { return itsBatchQueriesEnabled; }
+  std::size_t maxBatchQueries() const { return itsMaxBatchQueries; }
+  unsigned int batchConcurrency() const { return itsBatchConcurrency; }
+
+  bool useCompression() const { return itsCompressionEnabled; }
+  unsigned int compressionMinSize() const { return itsCompressionMinSize; }
+  const Compression::Encodings &compressionEncodings() const { return itsCompressionEncodings; }
+  const std::string &compressionDictionary() const { return itsCompressionDictionary; }
+
  private:
   TableFormatterOptions itsTableFormatterOptions;
   bool itsUseAuthEngine;
+
+  unsigned int itsMaxFilterPatterns = 100;
+  unsigned int itsMaxFilterBytes = 2000;
+
+  bool itsStationIndexEnabled = false;
+  unsigned int itsStationIndexRefreshInterval = 3600;
+  unsigned int itsStationIndexCacheSize = 1000;
+  bool itsNegativeCacheEnabled = false;
+  unsigned int itsNegativeCacheSize = 10000;
+  unsigned int itsEmptyResultTTL = 60;
+  bool itsMessageMonitorEnabled = false;
+  unsigned int itsMessageMonitorPollInterval = 30;
+  unsigned int itsMessageMonitorLookback = 180;
+  bool itsLatestCacheEnabled = false;
+  unsigned int itsLatestCacheSize = 10000;
+  unsigned int itsLatestCacheMaxAge = 60;
+  std::string itsLatestParameters = "icao,messagetype,messagetime,message";
+  unsigned int itsCursorLookback = 180;
+  bool itsDeadlinesEnabled = false;
+  unsigned int itsLatestDeadline = 10;
+  unsigned int itsRangeDeadline = 60;
+  unsigned int itsIncrementalDeadline = 10;
+  unsigned int itsRejectedDeadline = 60;
+  unsigned int itsMaxOverdueQueries = 10;
+  unsigned int itsDeadlineThreads = 16;
+  unsigned int itsDeadlineMaxQueued = 100;
+  bool itsSchedulerEnabled = false;
+  unsigned int itsSchedulerThreads = 8;
+  unsigned int itsSchedulerMaxQueued = 100;
+  unsigned int itsSchedulerBulkThreads = 4;
+  unsigned int itsSchedulerBulkMaxQueued = 20;
+  bool itsQueryCacheEnabled = false;
+  unsigned int itsQueryCacheSize = 10000;
+  bool itsSubscriptionsEnabled = false;
+  unsigned int itsSubscriptionBufferSize = 1000;
+  unsigned int itsSubscriptionKeepAlive = 15;
+  unsigned int itsMaxSubscribers = 1000;
+  bool itsBatchQueriesEnabled = false;
+  unsigned int itsMaxBatchQueries = 20;
+  unsigned int itsBatchConcurrency = 4;
+  bool itsCompressionEnabled = false;
+  unsigned int itsCompressionMinSize = 1024;
+  Compression::Encodings itsCompressionEncodings{false, true, true, true, false};
+  std::string itsCompressionDictionary;
   std::map<std::string, QueryLimits> itsQueryLimits;
 };  // class Config
 
@@ -0,0 +1,199 @@
+// ======================================================================
+
+#include "Cursor.h"
+#include "Utils.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+// Cursor format is 'c<microseconds since epoch>.<message id>'
+
+const char cursorPrefix = 'c';
+const char cursorSeparator = '.';
+
+}  // anonymous namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+Cursor::Cursor(const Fmi::DateTime &theCreated, long theMessageId)
+    : itsCreated(theCreated), itsMessageId(theMessageId)
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse cursor or time value
+ */
+// ----------------------------------------------------------------------
+
+Cursor Cursor::parse(const std::string &theValue)
+{
+  try
+  {
+    if (theValue.empty() || (theValue[0] != cursorPrefix))
+      return Cursor(Fmi::TimeParser::parse(theValue), 0);
+
+    auto pos = theValue.find(cursorSeparator);
+
+    if (pos == std::string::npos)
+      throw Fmi::Exception(BCP, "Invalid cursor '" + theValue + "'");
+
+    try
+    {
+      std::size_t end1 = 0;
+      std::size_t end2 = 0;
+      auto micros = std::stoll(theValue.substr(1, pos - 1), &end1);
+      auto messageId = std::stol(theValue.substr(pos + 1), &end2);
+
+      if ((end1 != pos - 1) || (end2 != theValue.size() - pos - 1) || (micros < 0))
+        throw Fmi::Exception(BCP, "Invalid cursor");
+
+      return Cursor(Fmi::epoch_time() + Fmi::Microseconds(micros), messageId);
+    }
+    catch (...)
+    {
+      throw Fmi::Exception(BCP, "Invalid cursor '" + theValue + "'");
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cursor value returned to the client
+ */
+// ----------------------------------------------------------------------
+
+std::string Cursor::str() const
+{
+  return cursorPrefix + Fmi::to_string((itsCreated - Fmi::epoch_time()).total_microseconds()) +
+         cursorSeparator + Fmi::to_string(itsMessageId);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if message is after the cursor
+ */
+// ----------------------------------------------------------------------
+
+bool Cursor::isBefore(const Fmi::DateTime &theCreated, long theMessageId) const
+{
+  return ((itsCreated < theCreated) ||
+          ((itsCreated == theCreated) && (itsMessageId < theMessageId)));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove messages not after the cursor and sort the rest
+ *
+ *        Query result must contain 'messagecreated' and 'messageid' columns
+ */
+// ----------------------------------------------------------------------
+
+Cursor Cursor::filter(SmartMet::Engine::Avi::StationQueryData &theStationData,
+                      std::pmr::memory_resource *theArena) const
+{
+  try
+  {
+    Cursor last(*this);
+    SmartMet::Engine::Avi::StationIdList stationIds;
+
+    for (auto stationId : theStationData.itsStationIds)
+    {
+      auto &values = theStationData.itsValues[stationId];
+      const auto &createdValues = values["messagecreated"];
+      const auto &messageIdValues = values["messageid"];
+
+      const auto nRows = createdValues.size();
+
+      if (messageIdValues.size() != nRows)
+        throw Fmi::Exception(BCP, "Internal error: cursor columns size mismatch");
+
+      // Rows after the cursor, ordered by creation time and message id
+
+      std::pmr::vector<Fmi::DateTime> created(theArena);
+      std::pmr::vector<long> messageIds(theArena);
+      std::pmr::vector<std::size_t> rows(theArena);
+
+      created.reserve(nRows);
+      messageIds.reserve(nRows);
+
+      for (std::size_t row = 0; (row < nRows); row++)
+      {
+        auto t = timeValue(createdValues[row]);
+        auto id = numericValue(messageIdValues[row]);
+
+        created.push_back(t ? *t : Fmi::DateTime());
+        messageIds.push_back(id ? static_cast<long>(*id) : 0);
+
+        if (t && id && isBefore(*t, messageIds.back()))
+          rows.push_back(row);
+      }
+
+      if (rows.empty())
+      {
+        theStationData.itsValues.erase(stationId);
+        continue;
+      }
+
+      std::stable_sort(rows.begin(),
+                       rows.end(),
+                       [&](std::size_t r1, std::size_t r2)
+                       {
+                         if (created[r1] != created[r2])
+                           return (created[r1] < created[r2]);
+                         return (messageIds[r1] < messageIds[r2]);
+                       });
+
+      if (last.isBefore(created[rows.back()], messageIds[rows.back()]))
+        last = Cursor(created[rows.back()], messageIds[rows.back()]);
+
+      for (auto &column : values)
+      {
+        if (column.second.size() != nRows)
+          continue;
+
+        std::remove_reference_t<decltype(column.second)> columnValues;
+        columnValues.reserve(rows.size());
+
+        for (auto row : rows)
+          columnValues.push_back(std::move(column.second[row]));
+
+        column.second.swap(columnValues);
+      }
+
+      stationIds.push_back(stationId);
+    }
+
+    theStationData.itsStationIds.swap(stationIds);
+
+    return last;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
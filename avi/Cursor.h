@@ -0,0 +1,57 @@
+// ======================================================================
+/*!
+ * \brief Position in the stream of created messages
+ *
+ * Cursor is the creation time and message id of the last message
+ * returned; messages created later (or at the same time with larger
+ * message id) are returned by the next incremental request.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+#include <macgyver/DateTime.h>
+
+#include <memory_resource>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class Cursor
+{
+ public:
+  Cursor(const Fmi::DateTime &theCreated, long theMessageId);
+  Cursor() = delete;
+
+  // Parse cursor returned by earlier request, or a plain time (message id 0)
+
+  static Cursor parse(const std::string &theValue);
+  std::string str() const;
+
+  const Fmi::DateTime &created() const { return itsCreated; }
+  long messageId() const { return itsMessageId; }
+
+  bool isBefore(const Fmi::DateTime &theCreated, long theMessageId) const;
+
+  // Remove messages not after the cursor, sort stations' messages by creation time
+  // and message id; returns cursor of the last remaining message. Temporary row
+  // indices are allocated from 'theArena'
+
+  Cursor filter(SmartMet::Engine::Avi::StationQueryData &theStationData,
+                std::pmr::memory_resource *theArena = std::pmr::get_default_resource()) const;
+
+ private:
+  Fmi::DateTime itsCreated;
+  long itsMessageId;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,458 @@
+// ======================================================================
+
+#include "GeoJsonWriter.h"
+#include "Utils.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <cctype>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+bool isDigit(char c)
+{
+  return std::isdigit(static_cast<unsigned char>(c)) != 0;
+}
+
+bool isSpace(char c)
+{
+  return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+void skipSpaces(std::string_view theText, std::size_t &thePos)
+{
+  while ((thePos < theText.size()) && isSpace(theText[thePos]))
+    thePos++;
+}
+
+// Parse hemisphere letter and degrees with optional minutes, such as N6030 or E025
+
+bool parseAngle(std::string_view theText,
+                std::size_t &thePos,
+                char thePositive,
+                char theNegative,
+                std::size_t theDegreeDigits,
+                double &theAngle)
+{
+  if ((thePos >= theText.size()) ||
+      ((theText[thePos] != thePositive) && (theText[thePos] != theNegative)))
+    return false;
+
+  auto pos = thePos + 1;
+  auto start = pos;
+
+  while ((pos < theText.size()) && isDigit(theText[pos]))
+    pos++;
+
+  auto digits = pos - start;
+
+  if ((digits != theDegreeDigits) && (digits != theDegreeDigits + 2))
+    return false;
+
+  double angle = 0;
+
+  for (std::size_t i = 0; (i < theDegreeDigits); i++)
+    angle = 10 * angle + (theText[start + i] - '0');
+
+  if (digits > theDegreeDigits)
+    angle += (10 * (theText[start + theDegreeDigits] - '0') +
+              (theText[start + theDegreeDigits + 1] - '0')) /
+             60.0;
+
+  theAngle = (theText[thePos] == theNegative ? -angle : angle);
+  thePos = pos;
+  return true;
+}
+
+bool parsePoint(std::string_view theText, std::size_t &thePos, GeoJsonWriter::Point &thePoint)
+{
+  auto pos = thePos;
+
+  if (!parseAngle(theText, pos, 'N', 'S', 2, thePoint.itsLat))
+    return false;
+
+  skipSpaces(theText, pos);
+
+  if (!parseAngle(theText, pos, 'E', 'W', 3, thePoint.itsLon))
+    return false;
+
+  thePos = pos;
+  return true;
+}
+
+// Squared distance of point from segment
+
+double segmentDistance2(const GeoJsonWriter::Point &thePoint,
+                        const GeoJsonWriter::Point &theStart,
+                        const GeoJsonWriter::Point &theEnd)
+{
+  auto x = theStart.itsLon;
+  auto y = theStart.itsLat;
+  auto dx = theEnd.itsLon - x;
+  auto dy = theEnd.itsLat - y;
+
+  if ((dx != 0) || (dy != 0))
+  {
+    auto t = ((thePoint.itsLon - x) * dx + (thePoint.itsLat - y) * dy) / (dx * dx + dy * dy);
+
+    if (t > 1)
+    {
+      x = theEnd.itsLon;
+      y = theEnd.itsLat;
+    }
+    else if (t > 0)
+    {
+      x += dx * t;
+      y += dy * t;
+    }
+  }
+
+  dx = thePoint.itsLon - x;
+  dy = thePoint.itsLat - y;
+
+  return dx * dx + dy * dy;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+GeoJsonWriter::GeoJsonWriter(const SmartMet::Engine::Avi::Columns &theColumns,
+                             ColumnValues theValues,
+                             std::size_t theStations,
+                             int thePrecision,
+                             std::shared_ptr<Fmi::TimeFormatter> theTimeFormatter,
+                             std::optional<Fmi::TimeZonePtr> theTimeZone,
+                             double theSimplifyTolerance)
+    : itsValues(std::move(theValues)),
+      itsStations(theStations),
+      itsValueFormatter(thePrecision, std::move(theTimeFormatter), std::move(theTimeZone)),
+      itsSimplifyTolerance(theSimplifyTolerance)
+{
+  try
+  {
+    for (const auto &column : theColumns)
+    {
+      auto index = itsTypes.size();
+
+      if (column.itsName == "message")
+        itsMessageColumn = index;
+      else if (column.itsName == "longitude")
+        itsLongitudeColumn = index;
+      else if (column.itsName == "latitude")
+        itsLatitudeColumn = index;
+      else if ((column.itsName == "lonlat") || (column.itsName == "latlon"))
+        itsLonLatColumn = index;
+
+      std::string key = (itsKeys.empty() ? "{" : ",");
+      appendJsonString(key, column.itsName);
+      key += ':';
+
+      itsKeys.push_back(key);
+      itsTypes.push_back(column.itsType);
+    }
+
+    if (itsValues.size() != itsTypes.size() * itsStations)
+      throw Fmi::Exception(BCP, "Number of column values does not match the columns");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Area of TAC message
+ */
+// ----------------------------------------------------------------------
+
+GeoJsonWriter::Points GeoJsonWriter::area(std::string_view theMessage)
+{
+  try
+  {
+    for (std::size_t start = 0; (start < theMessage.size()); start++)
+    {
+      if ((start > 0) && !isSpace(theMessage[start - 1]))
+        continue;
+
+      Points points;
+      Point point{};
+      auto pos = start;
+
+      while (parsePoint(theMessage, pos, point))
+      {
+        points.push_back(point);
+
+        auto next = pos;
+        skipSpaces(theMessage, next);
+
+        if ((next >= theMessage.size()) || (theMessage[next] != '-'))
+          break;
+
+        next++;
+        skipSpaces(theMessage, next);
+        pos = next;
+      }
+
+      if (points.size() >= 3)
+      {
+        const auto &first = points.front();
+        const auto &last = points.back();
+
+        if ((first.itsLon != last.itsLon) || (first.itsLat != last.itsLat))
+          points.push_back(first);
+
+        return points;
+      }
+    }
+
+    return {};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Douglas-Peucker simplification
+ */
+// ----------------------------------------------------------------------
+
+GeoJsonWriter::Points GeoJsonWriter::simplify(const Points &thePoints, double theTolerance)
+{
+  try
+  {
+    if ((thePoints.size() <= 2) || (theTolerance <= 0))
+      return thePoints;
+
+    auto tolerance2 = theTolerance * theTolerance;
+
+    std::vector<bool> keep(thePoints.size(), false);
+    keep.front() = true;
+    keep.back() = true;
+
+    std::vector<std::pair<std::size_t, std::size_t>> segments{{0, thePoints.size() - 1}};
+
+    while (!segments.empty())
+    {
+      auto [first, last] = segments.back();
+      segments.pop_back();
+
+      double maxDistance2 = 0;
+      std::size_t farthest = first;
+
+      for (auto i = first + 1; (i < last); i++)
+      {
+        auto distance2 = segmentDistance2(thePoints[i], thePoints[first], thePoints[last]);
+
+        if (distance2 > maxDistance2)
+        {
+          maxDistance2 = distance2;
+          farthest = i;
+        }
+      }
+
+      if (maxDistance2 > tolerance2)
+      {
+        keep[farthest] = true;
+        segments.emplace_back(first, farthest);
+        segments.emplace_back(farthest, last);
+      }
+    }
+
+    Points result;
+
+    for (std::size_t i = 0; (i < thePoints.size()); i++)
+      if (keep[i])
+        result.push_back(thePoints[i]);
+
+    return result;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Value of station row; nullptr if missing
+ */
+// ----------------------------------------------------------------------
+
+const TimeSeries::Value *GeoJsonWriter::value(std::optional<std::size_t> theColumn,
+                                              std::size_t theStation,
+                                              std::size_t theRow) const
+{
+  if (!theColumn)
+    return nullptr;
+
+  const auto &values = *itsValues[*theColumn * itsStations + theStation];
+
+  return (theRow < values.size() ? &values[theRow] : nullptr);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append geometry of the message area or the station; null if none
+ */
+// ----------------------------------------------------------------------
+
+void GeoJsonWriter::appendGeometry(std::string &theOutput,
+                                   std::size_t theStation,
+                                   std::size_t theRow) const
+{
+  const auto coordinate = SmartMet::Engine::Avi::ColumnType::Double;
+
+  const auto *message = value(itsMessageColumn, theStation, theRow);
+  const auto *text = (message ? std::get_if<std::string>(message) : nullptr);
+
+  if (text)
+  {
+    auto points = area(*text);
+
+    if (!points.empty())
+    {
+      // Keep the original ring if simplification would degenerate it
+
+      auto simplified = simplify(points, itsSimplifyTolerance);
+      const auto &ring = (simplified.size() >= 4 ? simplified : points);
+
+      theOutput += "{\"type\":\"Polygon\",\"coordinates\":[[";
+
+      for (std::size_t i = 0; (i < ring.size()); i++)
+      {
+        theOutput += (i > 0 ? ",[" : "[");
+        itsValueFormatter.append(theOutput, coordinate, ring[i].itsLon);
+        theOutput += ',';
+        itsValueFormatter.append(theOutput, coordinate, ring[i].itsLat);
+        theOutput += ']';
+      }
+
+      theOutput += "]]}";
+      return;
+    }
+  }
+
+  const double *lon = nullptr;
+  const double *lat = nullptr;
+
+  if (const auto *lonlat = value(itsLonLatColumn, theStation, theRow))
+  {
+    if (const auto *point = std::get_if<TimeSeries::LonLat>(lonlat))
+    {
+      lon = &point->lon;
+      lat = &point->lat;
+    }
+  }
+
+  if (!lon)
+  {
+    const auto *longitude = value(itsLongitudeColumn, theStation, theRow);
+    const auto *latitude = value(itsLatitudeColumn, theStation, theRow);
+
+    if (longitude && latitude)
+    {
+      lon = std::get_if<double>(longitude);
+      lat = std::get_if<double>(latitude);
+    }
+  }
+
+  if (!lon || !lat)
+  {
+    theOutput += "null";
+    return;
+  }
+
+  theOutput += "{\"type\":\"Point\",\"coordinates\":[";
+  itsValueFormatter.append(theOutput, coordinate, *lon);
+  theOutput += ',';
+  itsValueFormatter.append(theOutput, coordinate, *lat);
+  theOutput += "]}";
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append features
+ */
+// ----------------------------------------------------------------------
+
+bool GeoJsonWriter::write(std::string &theOutput, std::size_t theMinBytes)
+{
+  try
+  {
+    auto start = theOutput.size();
+    std::size_t nColumns = itsTypes.size();
+
+    if (!itsStarted)
+    {
+      theOutput += "{\"type\":\"FeatureCollection\",\"features\":[";
+      itsStarted = true;
+    }
+
+    for (; (itsStation < itsStations); itsStation++, itsRow = 0)
+    {
+      // Missing values of a column are written as nulls
+
+      std::size_t rows = 0;
+
+      for (std::size_t column = 0; (column < nColumns); column++)
+        rows = std::max(rows, itsValues[column * itsStations + itsStation]->size());
+
+      for (; (itsRow < rows); itsRow++)
+      {
+        if (theOutput.size() - start >= theMinBytes)
+          return true;
+
+        theOutput += (itsFirstFeature ? "\n" : ",\n");
+        itsFirstFeature = false;
+
+        theOutput += "{\"type\":\"Feature\",\"geometry\":";
+        appendGeometry(theOutput, itsStation, itsRow);
+        theOutput += ",\"properties\":";
+
+        for (std::size_t column = 0; (column < nColumns); column++)
+        {
+          theOutput += itsKeys[column];
+
+          if (const auto *v = value(column, itsStation, itsRow))
+            itsValueFormatter.append(theOutput, itsTypes[column], *v);
+          else
+            theOutput += "null";
+        }
+
+        theOutput += (nColumns > 0 ? "}}" : "{}}");
+      }
+    }
+
+    if (!itsFinished)
+    {
+      theOutput += "\n]}\n";
+      itsFinished = true;
+    }
+
+    return false;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,102 @@
+// ======================================================================
+/*!
+ * \brief GeoJSON output of query results
+ *
+ * Writes a FeatureCollection with one Feature per message row. The
+ * geometry is the area given in the message (the first run of at least
+ * three coordinate pairs, such as 'WI N6000 E02500 - N6100 E02600 - ...'
+ * in SIGMETs, AIRMETs and VAAs) or else the station location. Areas can
+ * be simplified with the Douglas-Peucker algorithm.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "JsonValueFormatter.h"
+#include "ResultWriter.h"
+#include <engines/avi/Engine.h>
+
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class GeoJsonWriter : public ResultWriter
+{
+ public:
+  struct Point
+  {
+    double itsLon;
+    double itsLat;
+  };
+
+  using Points = std::vector<Point>;
+
+  // Values of column c for station s are at index c * theStations + s
+
+  using ColumnValues = std::pmr::vector<const SmartMet::Engine::Avi::ValueVector *>;
+
+  GeoJsonWriter(const SmartMet::Engine::Avi::Columns &theColumns,
+                ColumnValues theValues,
+                std::size_t theStations,
+                int thePrecision,
+                std::shared_ptr<Fmi::TimeFormatter> theTimeFormatter,
+                std::optional<Fmi::TimeZonePtr> theTimeZone,
+                double theSimplifyTolerance);
+  GeoJsonWriter() = delete;
+  GeoJsonWriter(const GeoJsonWriter &other) = delete;
+  GeoJsonWriter &operator=(const GeoJsonWriter &other) = delete;
+
+  bool write(std::string &theOutput, std::size_t theMinBytes) override;
+
+  // Closed ring of the first run of at least three coordinate pairs in TAC
+  // text; empty if there is none
+
+  static Points area(std::string_view theMessage);
+
+  // Douglas-Peucker simplification; the end points are kept
+
+  static Points simplify(const Points &thePoints, double theTolerance);
+
+ private:
+  void appendGeometry(std::string &theOutput, std::size_t theStation, std::size_t theRow) const;
+  const TimeSeries::Value *value(std::optional<std::size_t> theColumn,
+                                 std::size_t theStation,
+                                 std::size_t theRow) const;
+
+  std::vector<SmartMet::Engine::Avi::ColumnType> itsTypes;
+  std::vector<std::string> itsKeys;  // '"name":' with separators
+  const ColumnValues itsValues;
+  const std::size_t itsStations;
+  const JsonValueFormatter itsValueFormatter;
+  const double itsSimplifyTolerance;
+
+  // Columns used for the geometry
+
+  std::optional<std::size_t> itsMessageColumn;
+  std::optional<std::size_t> itsLongitudeColumn;
+  std::optional<std::size_t> itsLatitudeColumn;
+  std::optional<std::size_t> itsLonLatColumn;
+
+  // Next row to write
+
+  bool itsStarted = false;
+  bool itsFirstFeature = true;
+  bool itsFinished = false;
+  std::size_t itsStation = 0;
+  std::size_t itsRow = 0;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
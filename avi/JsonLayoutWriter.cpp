@@ -0,0 +1,210 @@
+// ======================================================================
+
+#include "JsonLayoutWriter.h"
+#include "Parameters.h"
+#include "Utils.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+JsonLayoutWriter::JsonLayoutWriter(const SmartMet::Engine::Avi::Columns &theColumns,
+                                   const ColumnValues &theValues,
+                                   std::size_t theStations,
+                                   const JsonValueFormatter &theValueFormatter)
+    : itsValues(theValues), itsStations(theStations), itsValueFormatter(theValueFormatter)
+{
+  try
+  {
+    for (const auto &column : theColumns)
+    {
+      std::string name;
+      appendJsonString(name, column.itsName);
+
+      auto id = Parameters::find(column.itsName);
+
+      itsNames.push_back(name);
+      itsTypes.push_back(column.itsType);
+      itsStationColumns.push_back(id && Parameters::isStationParameter(*id));
+    }
+
+    if (itsValues.size() != itsTypes.size() * itsStations)
+      throw Fmi::Exception(BCP, "Number of column values does not match the columns");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Number of rows of the station; missing values of a column are nulls
+ */
+// ----------------------------------------------------------------------
+
+std::size_t JsonLayoutWriter::rows(std::size_t theStation) const
+{
+  std::size_t rows = 0;
+
+  for (std::size_t column = 0; (column < itsTypes.size()); column++)
+    rows = std::max(rows, itsValues[column * itsStations + theStation]->size());
+
+  return rows;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append value of a station row
+ */
+// ----------------------------------------------------------------------
+
+void JsonLayoutWriter::appendValue(std::string &theOutput,
+                                   std::size_t theColumn,
+                                   std::size_t theStation,
+                                   std::size_t theRow) const
+{
+  const auto &values = *itsValues[theColumn * itsStations + theStation];
+
+  if (theRow < values.size())
+    itsValueFormatter.append(theOutput, itsTypes[theColumn], values[theRow]);
+  else
+    theOutput += "null";
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write one array per column
+ */
+// ----------------------------------------------------------------------
+
+void JsonLayoutWriter::writeColumns(std::string &theOutput) const
+{
+  try
+  {
+    std::vector<std::size_t> stationRows;
+
+    for (std::size_t station = 0; (station < itsStations); station++)
+      stationRows.push_back(rows(station));
+
+    theOutput += '{';
+
+    for (std::size_t column = 0; (column < itsTypes.size()); column++)
+    {
+      if (column > 0)
+        theOutput += ',';
+
+      theOutput += itsNames[column];
+      theOutput += ":[";
+
+      bool first = true;
+
+      for (std::size_t station = 0; (station < itsStations); station++)
+        for (std::size_t row = 0; (row < stationRows[station]); row++)
+        {
+          if (!first)
+            theOutput += ',';
+          first = false;
+
+          appendValue(theOutput, column, station, row);
+        }
+
+      theOutput += ']';
+    }
+
+    theOutput += '}';
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write station columns once per station and the other columns as messages
+ *
+ *        Stations without messages are not written
+ */
+// ----------------------------------------------------------------------
+
+void JsonLayoutWriter::writeStations(std::string &theOutput) const
+{
+  try
+  {
+    std::size_t nColumns = itsTypes.size();
+    bool firstStation = true;
+
+    theOutput += '[';
+
+    for (std::size_t station = 0; (station < itsStations); station++)
+    {
+      auto stationRows = rows(station);
+
+      if (stationRows == 0)
+        continue;
+
+      if (!firstStation)
+        theOutput += ',';
+      firstStation = false;
+
+      theOutput += '{';
+
+      for (std::size_t column = 0; (column < nColumns); column++)
+        if (itsStationColumns[column])
+        {
+          theOutput += itsNames[column];
+          theOutput += ':';
+          appendValue(theOutput, column, station, 0);
+          theOutput += ',';
+        }
+
+      theOutput += "\"messages\":[";
+
+      for (std::size_t row = 0; (row < stationRows); row++)
+      {
+        theOutput += (row > 0 ? ",{" : "{");
+
+        bool firstColumn = true;
+
+        for (std::size_t column = 0; (column < nColumns); column++)
+          if (!itsStationColumns[column])
+          {
+            if (!firstColumn)
+              theOutput += ',';
+            firstColumn = false;
+
+            theOutput += itsNames[column];
+            theOutput += ':';
+            appendValue(theOutput, column, station, row);
+          }
+
+        theOutput += '}';
+      }
+
+      theOutput += "]}";
+    }
+
+    theOutput += ']';
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
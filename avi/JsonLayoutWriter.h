@@ -0,0 +1,68 @@
+// ======================================================================
+/*!
+ * \brief Column-oriented and station-grouped JSON output of query results
+ *
+ * Row-oriented JSON repeats the station columns in every message row.
+ * The layouts here write each column as one array, or the station
+ * columns once per station followed by an array of its messages.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "JsonValueFormatter.h"
+#include <engines/avi/Engine.h>
+
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class JsonLayoutWriter
+{
+ public:
+  // Values of column c for station s are at index c * theStations + s
+
+  using ColumnValues = std::pmr::vector<const SmartMet::Engine::Avi::ValueVector *>;
+
+  JsonLayoutWriter(const SmartMet::Engine::Avi::Columns &theColumns,
+                   const ColumnValues &theValues,
+                   std::size_t theStations,
+                   const JsonValueFormatter &theValueFormatter);
+  JsonLayoutWriter() = delete;
+  JsonLayoutWriter(const JsonLayoutWriter &other) = delete;
+  JsonLayoutWriter &operator=(const JsonLayoutWriter &other) = delete;
+
+  // {"name":[value,...],...}
+
+  void writeColumns(std::string &theOutput) const;
+
+  // [{"name":value,...,"messages":[{"name":value,...},...]},...]
+
+  void writeStations(std::string &theOutput) const;
+
+ private:
+  std::size_t rows(std::size_t theStation) const;
+  void appendValue(std::string &theOutput,
+                   std::size_t theColumn,
+                   std::size_t theStation,
+                   std::size_t theRow) const;
+
+  std::vector<SmartMet::Engine::Avi::ColumnType> itsTypes;
+  std::vector<std::string> itsNames;  // quoted
+  std::vector<bool> itsStationColumns;
+  const ColumnValues &itsValues;
+  const std::size_t itsStations;
+  const JsonValueFormatter &itsValueFormatter;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
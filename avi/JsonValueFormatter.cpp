@@ -0,0 +1,78 @@
+// ======================================================================
+
+#include "JsonValueFormatter.h"
+#include "Utils.h"
+#include <macgyver/LocalDateTime.h>
+#include <macgyver/StringConversion.h>
+#include <cmath>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+JsonValueFormatter::JsonValueFormatter(int thePrecision,
+                                       std::shared_ptr<Fmi::TimeFormatter> theTimeFormatter,
+                                       std::optional<Fmi::TimeZonePtr> theTimeZone)
+    : itsPrecision(thePrecision),
+      itsTimeFormatter(std::move(theTimeFormatter)),
+      itsTimeZone(std::move(theTimeZone)),
+      itsValueFormatter(Fmi::ValueFormatterParam())
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append JSON value; missing values are nulls
+ */
+// ----------------------------------------------------------------------
+
+void JsonValueFormatter::append(std::string &theOutput,
+                                SmartMet::Engine::Avi::ColumnType theType,
+                                const TimeSeries::Value &theValue) const
+{
+  if (const auto *s = std::get_if<std::string>(&theValue))
+    appendJsonString(theOutput, *s);
+  else if (const auto *i = std::get_if<int>(&theValue))
+    theOutput += Fmi::to_string(*i);
+  else if (const auto *d = std::get_if<double>(&theValue))
+  {
+    if (std::isnan(*d))
+      theOutput += "null";
+    else
+      theOutput += itsValueFormatter.format(*d, itsPrecision);
+  }
+  else if (const auto *t = std::get_if<Fmi::LocalDateTime>(&theValue))
+  {
+    if (itsTimeZone)
+      appendJsonString(theOutput,
+                       itsTimeFormatter->format(Fmi::LocalDateTime(t->utc_time(), *itsTimeZone)));
+    else
+      appendJsonString(theOutput, itsTimeFormatter->format(t->utc_time()));
+  }
+  else if (const auto *lonlat = std::get_if<TimeSeries::LonLat>(&theValue))
+  {
+    bool latlon = (theType == SmartMet::Engine::Avi::ColumnType::TS_LatLon);
+
+    theOutput += '[';
+    theOutput += itsValueFormatter.format(latlon ? lonlat->lat : lonlat->lon, itsPrecision);
+    theOutput += ',';
+    theOutput += itsValueFormatter.format(latlon ? lonlat->lon : lonlat->lat, itsPrecision);
+    theOutput += ']';
+  }
+  else
+    theOutput += "null";
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
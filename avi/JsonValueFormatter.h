@@ -0,0 +1,49 @@
+// ======================================================================
+/*!
+ * \brief Formatting of query result values as JSON values
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+#include <macgyver/TimeFormatter.h>
+#include <macgyver/TimeZoneFactory.h>
+#include <macgyver/ValueFormatter.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class JsonValueFormatter
+{
+ public:
+  JsonValueFormatter(int thePrecision,
+                     std::shared_ptr<Fmi::TimeFormatter> theTimeFormatter,
+                     std::optional<Fmi::TimeZonePtr> theTimeZone);
+  JsonValueFormatter() = delete;
+
+  // Append the value; missing values are nulls
+
+  void append(std::string &theOutput,
+              SmartMet::Engine::Avi::ColumnType theType,
+              const TimeSeries::Value &theValue) const;
+
+ private:
+  const int itsPrecision;
+  const std::shared_ptr<Fmi::TimeFormatter> itsTimeFormatter;
+  const std::optional<Fmi::TimeZonePtr> itsTimeZone;
+  const Fmi::ValueFormatter itsValueFormatter;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
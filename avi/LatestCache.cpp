@@ -0,0 +1,378 @@
+// ======================================================================
+
+#include "LatestCache.h"
+#include "Utils.h"
+#include <macgyver/Exception.h>
+#include <cctype>
+#include <cstring>
+#include <exception>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build key; icao and type are case insensitive
+ */
+// ----------------------------------------------------------------------
+
+LatestCache::Key::Key(std::string_view theIcao,
+                      std::string_view theType,
+                      std::string_view theFormat)
+{
+  auto length = theIcao.size() + theType.size() + theFormat.size() + 2;
+
+  if (theIcao.empty() || theType.empty() || theFormat.empty() || (length > itsData.size()))
+    return;
+
+  auto *p = itsData.data();
+
+  for (auto c : theIcao)
+    *p++ = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  *p++ = '/';
+
+  for (auto c : theType)
+    *p++ = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  *p++ = '/';
+
+  std::memcpy(p, theFormat.data(), theFormat.size());
+
+  itsLength = length;
+  itsIcaoLength = theIcao.size();
+  itsTypeLength = theType.size();
+}
+
+bool LatestCache::Key::operator==(const Key &other) const
+{
+  return ((itsLength == other.itsLength) &&
+          (std::memcmp(itsData.data(), other.itsData.data(), itsLength) == 0));
+}
+
+std::size_t LatestCache::Key::hash() const
+{
+  return hash64(std::string_view(itsData.data(), itsLength));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set entity tag; compressed variants have the encoding appended
+ *        to the tag
+ */
+// ----------------------------------------------------------------------
+
+void LatestCache::Rendition::setETag(const std::string &theETag)
+{
+  try
+  {
+    for (std::size_t i = 0; i < Compression::encodingCount; i++)
+    {
+      auto encoding = static_cast<Compression::Encoding>(i);
+      itsETags[i] = theETag;
+
+      if ((encoding != Compression::Encoding::Identity) && !theETag.empty())
+        itsETags[i].insert(theETag.size() - 1, "-" + std::string(Compression::name(encoding)));
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compressed content
+ *
+ *        Concurrent requests of the same encoding wait for the first
+ *        compression instead of compressing the content again
+ */
+// ----------------------------------------------------------------------
+
+const std::string &LatestCache::Rendition::content(
+    Compression::Encoding theEncoding, const Compression::Dictionary *theDictionary) const
+{
+  try
+  {
+    if (theEncoding == Compression::Encoding::Identity)
+      return itsContent;
+
+    std::lock_guard<std::mutex> lock(itsEncodedMutex);
+
+    auto &encoded = itsEncodedContent[Compression::index(theEncoding)];
+
+    if (!encoded)
+      encoded = std::make_unique<const std::string>(
+          Compression::compress(itsContent, theEncoding, theDictionary));
+
+    return *encoded;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+LatestCache::LatestCache(std::size_t theMaxSize, unsigned int theMaxAge)
+    : itsMaxSize(theMaxSize),
+      itsMaxAge(theMaxAge),
+      itsStartTime(Fmi::SecondClock::universal_time())
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find unexpired rendition
+ */
+// ----------------------------------------------------------------------
+
+LatestCache::RenditionPtr LatestCache::find(const Key &theKey) const
+{
+  std::shared_lock<std::shared_mutex> lock(itsMutex);
+
+  auto it = itsRenditions.find(theKey);
+
+  if ((it == itsRenditions.end()) ||
+      (it->second->itsExpires <= std::chrono::steady_clock::now()))
+  {
+    itsMisses++;
+    return nullptr;
+  }
+
+  itsHits++;
+  return it->second;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store rendition
+ */
+// ----------------------------------------------------------------------
+
+void LatestCache::insert(const Key &theKey, RenditionPtr theRendition)
+{
+  try
+  {
+    std::unique_lock<std::shared_mutex> lock(itsMutex);
+
+    if ((itsRenditions.size() >= itsMaxSize) &&
+        (itsRenditions.find(theKey) == itsRenditions.end()))
+    {
+      auto now = std::chrono::steady_clock::now();
+
+      for (auto it = itsRenditions.begin(); (it != itsRenditions.end());)
+        if (it->second->itsExpires <= now)
+          it = itsRenditions.erase(it);
+        else
+          ++it;
+
+      if (itsRenditions.size() >= itsMaxSize)
+        itsRenditions.clear();
+    }
+
+    itsRenditions[theKey] = std::move(theRendition);
+    itsInserts++;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find rendition, rendering it if necessary
+ *
+ *        The first request for a missing rendition renders it, concurrent
+ *        requests for the same key wait for the result
+ */
+// ----------------------------------------------------------------------
+
+LatestCache::RenditionPtr LatestCache::findOrRender(
+    const Key &theKey, const std::function<RenditionPtr()> &theRenderer)
+{
+  try
+  {
+    auto rendition = find(theKey);
+
+    if (rendition)
+      return rendition;
+
+    // Wait for the rendition if it is being rendered by another request
+
+    std::promise<RenditionPtr> promise;
+    std::shared_future<RenditionPtr> pending;
+
+    {
+      std::lock_guard<std::mutex> lock(itsPendingMutex);
+
+      auto it = itsPending.find(theKey);
+
+      // The rendition may have been stored after the first lookup
+
+      if (it != itsPending.end())
+        pending = it->second;
+      else if (!(rendition = find(theKey)))
+        itsPending.emplace(theKey, promise.get_future().share());
+    }
+
+    if (pending.valid())
+      return pending.get();
+
+    if (rendition)
+      return rendition;
+
+    std::exception_ptr error;
+
+    try
+    {
+      rendition = theRenderer();
+      insert(theKey, rendition);
+      promise.set_value(rendition);
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+      promise.set_exception(error);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(itsPendingMutex);
+      itsPending.erase(theKey);
+    }
+
+    if (error)
+      std::rethrow_exception(error);
+
+    return rendition;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test If-None-Match header against an entity tag
+ *
+ *        The header is '*' or a comma separated list of entity tags, which
+ *        are compared weakly (RFC 9110 13.1.2); the weakness indicator 'W/'
+ *        is ignored. Entity tags may contain commas, thus the list is
+ *        scanned by the quoted tags
+ */
+// ----------------------------------------------------------------------
+
+bool LatestCache::matches(std::string_view theIfNoneMatch, std::string_view theETag)
+{
+  auto opaqueTag = [](std::string_view tag)
+  {
+    if ((tag.size() >= 2) && (tag[0] == 'W') && (tag[1] == '/'))
+      tag.remove_prefix(2);
+    return tag;
+  };
+
+  auto etag = opaqueTag(theETag);
+  std::size_t pos = 0;
+
+  while (pos < theIfNoneMatch.size())
+  {
+    auto c = theIfNoneMatch[pos];
+
+    if ((c == ' ') || (c == '\t') || (c == ','))
+    {
+      pos++;
+      continue;
+    }
+
+    if (c == '*')
+      return true;
+
+    if (theIfNoneMatch.compare(pos, 2, "W/") == 0)
+      pos += 2;
+
+    if ((pos >= theIfNoneMatch.size()) || (theIfNoneMatch[pos] != '"'))
+    {
+      // Invalid member; skip to the next one
+
+      pos = theIfNoneMatch.find(',', pos);
+
+      if (pos == std::string_view::npos)
+        return false;
+      continue;
+    }
+
+    auto end = theIfNoneMatch.find('"', pos + 1);
+
+    if (end == std::string_view::npos)
+      return false;
+
+    if (theIfNoneMatch.substr(pos, end - pos + 1) == etag)
+      return true;
+
+    pos = end + 1;
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Drop all renditions of given station
+ */
+// ----------------------------------------------------------------------
+
+void LatestCache::invalidate(std::string_view theIcao)
+{
+  try
+  {
+    Key icaoKey(theIcao, "-", "-");
+
+    std::unique_lock<std::shared_mutex> lock(itsMutex);
+
+    for (auto it = itsRenditions.begin(); (it != itsRenditions.end());)
+      if (it->first.icao() == icaoKey.icao())
+        it = itsRenditions.erase(it);
+      else
+        ++it;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cache statistics
+ */
+// ----------------------------------------------------------------------
+
+Fmi::Cache::CacheStats LatestCache::getCacheStats() const
+{
+  std::shared_lock<std::shared_mutex> lock(itsMutex);
+
+  Fmi::Cache::CacheStats stats;
+  stats.starttime = itsStartTime;
+  stats.maxsize = itsMaxSize;
+  stats.size = itsRenditions.size();
+  stats.inserts = itsInserts;
+  stats.hits = itsHits;
+  stats.misses = itsMisses;
+
+  return stats;
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
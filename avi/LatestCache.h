@@ -0,0 +1,150 @@
+// ======================================================================
+/*!
+ * \brief Pre-rendered latest message responses by station, type and format
+ *
+ * Responses of the path style latest message requests are rendered once
+ * and served as such until a new message arrives for the station or the
+ * rendition expires. Lookups use fixed size keys and do not allocate,
+ * and the header values are rendered with the content. The server
+ * response still copies the headers and the content it is given.
+ * Concurrent requests for a missing rendition wait for the first request
+ * to render it instead of rendering it again.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "Compression.h"
+#include <macgyver/Cache.h>
+#include <macgyver/DateTime.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class LatestCache
+{
+ public:
+  class Rendition
+  {
+   public:
+    std::string itsContent;
+    std::string itsMimeType;
+    std::string itsLastModified;
+    std::string itsExpiresHeader;  // itsExpires as Expires header value
+    std::chrono::steady_clock::time_point itsExpires;
+
+    // Entity tags of the content and of its compressed variants
+
+    void setETag(const std::string &theETag);
+    const std::string &etag(Compression::Encoding theEncoding) const
+    {
+      return itsETags[Compression::index(theEncoding)];
+    }
+
+    // Content compressed with given encoding; compressed once on first use
+
+    const std::string &content(Compression::Encoding theEncoding,
+                               const Compression::Dictionary *theDictionary) const;
+
+   private:
+    std::array<std::string, Compression::encodingCount> itsETags;
+
+    mutable std::mutex itsEncodedMutex;
+    mutable std::array<std::unique_ptr<const std::string>, Compression::encodingCount>
+        itsEncodedContent;
+  };
+
+  using RenditionPtr = std::shared_ptr<const Rendition>;
+
+  // Key of 'ICAO/TYPE/format'; invalid if too long
+
+  class Key
+  {
+   public:
+    Key(std::string_view theIcao, std::string_view theType, std::string_view theFormat);
+
+    bool valid() const { return itsLength > 0; }
+    bool operator==(const Key &other) const;
+    std::string_view icao() const { return {itsData.data(), itsIcaoLength}; }
+    std::string_view type() const { return {itsData.data() + itsIcaoLength + 1, itsTypeLength}; }
+    std::string_view format() const
+    {
+      auto offset = itsIcaoLength + itsTypeLength + 2;
+      return {itsData.data() + offset, itsLength - offset};
+    }
+    std::size_t hash() const;
+
+   private:
+    std::array<char, 32> itsData{};
+    std::size_t itsLength = 0;
+    std::size_t itsIcaoLength = 0;
+    std::size_t itsTypeLength = 0;
+  };
+
+  LatestCache(std::size_t theMaxSize, unsigned int theMaxAge);
+  LatestCache() = delete;
+  LatestCache(const LatestCache &other) = delete;
+  LatestCache &operator=(const LatestCache &other) = delete;
+
+  RenditionPtr find(const Key &theKey) const;
+  void insert(const Key &theKey, RenditionPtr theRendition);
+
+  // Find the rendition or render and store it; renderer errors are thrown to all
+  // requests waiting for the rendition and nothing is stored
+
+  RenditionPtr findOrRender(const Key &theKey, const std::function<RenditionPtr()> &theRenderer);
+
+  // If-None-Match (RFC 9110) header matches given entity tag; weak comparison
+
+  static bool matches(std::string_view theIfNoneMatch, std::string_view theETag);
+
+  // Drop all renditions of given station (new message arrived)
+
+  void invalidate(std::string_view theIcao);
+
+  std::chrono::seconds maxAge() const { return itsMaxAge; }
+  Fmi::Cache::CacheStats getCacheStats() const;
+
+ private:
+  struct KeyHash
+  {
+    std::size_t operator()(const Key &theKey) const { return theKey.hash(); }
+  };
+
+  const std::size_t itsMaxSize;
+  const std::chrono::seconds itsMaxAge;
+  const Fmi::DateTime itsStartTime;
+
+  mutable std::shared_mutex itsMutex;
+  std::unordered_map<Key, RenditionPtr, KeyHash> itsRenditions;
+
+  // Renditions being rendered
+
+  std::mutex itsPendingMutex;
+  std::unordered_map<Key, std::shared_future<RenditionPtr>, KeyHash> itsPending;
+
+  std::atomic<std::size_t> itsInserts{0};
+  mutable std::atomic<std::size_t> itsHits{0};
+  mutable std::atomic<std::size_t> itsMisses{0};
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,297 @@
+// ======================================================================
+
+#include "MessageFilter.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <cctype>
+#include <queue>
+#include <type_traits>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+const std::size_t alphabetSize = 256;
+const std::uint32_t noState = static_cast<std::uint32_t>(-1);
+
+bool isDelimiter(unsigned char theChar)
+{
+  return ((theChar == '=') || std::isspace(theChar));
+}
+
+// Keep matching rows of each column having a value for all rows
+
+template <typename Values>
+void keepRows(Values &theValues, std::size_t theRows, const std::vector<bool> &theSelected)
+{
+  for (auto &column : theValues)
+  {
+    if (column.second.size() != theRows)
+      continue;
+
+    std::remove_reference_t<decltype(column.second)> columnValues;
+
+    for (std::size_t row = 0; (row < theRows); row++)
+      if (theSelected[row])
+        columnValues.push_back(std::move(column.second[row]));
+
+    column.second.swap(columnValues);
+  }
+}
+
+}  // anonymous namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the automaton
+ *
+ *        Patterns are stored in upper case to a trie; failure links are
+ *        then resolved breadth first into direct transitions, so that
+ *        searching takes one table lookup per byte. Lower case letters
+ *        share the transitions of upper case letters
+ */
+// ----------------------------------------------------------------------
+
+MessageFilter::Automaton::Automaton(const std::vector<std::string> &thePatterns)
+    : itsTransitions(alphabetSize, noState), itsOutputs(1)
+{
+  try
+  {
+    for (const auto &pattern : thePatterns)
+    {
+      if (pattern.empty())
+        throw Fmi::Exception(BCP, "Empty message filter pattern");
+
+      std::uint32_t state = 0;
+
+      for (unsigned char c : pattern)
+      {
+        auto &next = itsTransitions[state * alphabetSize + std::toupper(c)];
+
+        if (next == noState)
+        {
+          next = static_cast<std::uint32_t>(itsOutputs.size());
+          itsOutputs.emplace_back();
+          itsTransitions.resize(itsTransitions.size() + alphabetSize, noState);
+        }
+
+        state = itsTransitions[state * alphabetSize + std::toupper(c)];
+      }
+
+      itsOutputs[state].push_back(static_cast<std::uint32_t>(pattern.size()));
+    }
+
+    // Missing transitions of the root return to the root
+
+    std::vector<std::uint32_t> failure(itsOutputs.size(), 0);
+    std::queue<std::uint32_t> states;
+
+    for (std::size_t c = 0; (c < alphabetSize); c++)
+    {
+      auto &next = itsTransitions[c];
+
+      if (next == noState)
+        next = 0;
+      else
+        states.push(next);
+    }
+
+    // Other states continue from the transition of their failure state, which has
+    // already been resolved since it is closer to the root
+
+    while (!states.empty())
+    {
+      auto state = states.front();
+      states.pop();
+
+      const auto &outputs = itsOutputs[failure[state]];
+      itsOutputs[state].insert(itsOutputs[state].end(), outputs.begin(), outputs.end());
+
+      for (std::size_t c = 0; (c < alphabetSize); c++)
+      {
+        auto &next = itsTransitions[state * alphabetSize + c];
+        auto fallback = itsTransitions[failure[state] * alphabetSize + c];
+
+        if (next == noState)
+          next = fallback;
+        else
+        {
+          failure[next] = fallback;
+          states.push(next);
+        }
+      }
+    }
+
+    for (std::size_t state = 0; (state < itsOutputs.size()); state++)
+      for (std::size_t c = 'a'; (c <= 'z'); c++)
+        itsTransitions[state * alphabetSize + c] =
+            itsTransitions[state * alphabetSize + std::toupper(static_cast<int>(c))];
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if text contains any of the patterns
+ */
+// ----------------------------------------------------------------------
+
+bool MessageFilter::Automaton::search(std::string_view theText, bool isToken) const
+{
+  std::uint32_t state = 0;
+  const auto size = theText.size();
+
+  for (std::size_t pos = 0; (pos < size); pos++)
+  {
+    state = itsTransitions[state * alphabetSize + static_cast<unsigned char>(theText[pos])];
+
+    const auto &outputs = itsOutputs[state];
+
+    if (outputs.empty())
+      continue;
+
+    if (!isToken)
+      return true;
+
+    if ((pos + 1 < size) && !isDelimiter(theText[pos + 1]))
+      continue;
+
+    for (auto length : outputs)
+    {
+      auto start = pos + 1 - length;
+
+      if ((start == 0) || isDelimiter(theText[start - 1]))
+        return true;
+    }
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+MessageFilter::MessageFilter(const std::vector<std::string> &theSubstrings,
+                             const std::vector<std::string> &theTokens)
+{
+  try
+  {
+    if (!theSubstrings.empty())
+      itsSubstrings.emplace(theSubstrings);
+
+    if (!theTokens.empty())
+      itsTokens.emplace(theTokens);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if message matches the filter
+ */
+// ----------------------------------------------------------------------
+
+bool MessageFilter::matches(std::string_view theMessage) const
+{
+  return ((!itsSubstrings || itsSubstrings->search(theMessage, false)) &&
+          (!itsTokens || itsTokens->search(theMessage, true)));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Select rows with matching message
+ */
+// ----------------------------------------------------------------------
+
+std::vector<bool> MessageFilter::selectRows(
+    const SmartMet::Engine::Avi::ValueVector &theMessages) const
+{
+  try
+  {
+    std::vector<bool> selected(theMessages.size(), false);
+
+    for (std::size_t row = 0; (row < theMessages.size()); row++)
+      if (const auto *message = std::get_if<std::string>(&theMessages[row]))
+        selected[row] = matches(*message);
+
+    return selected;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove stations' rows with non matching message
+ */
+// ----------------------------------------------------------------------
+
+void MessageFilter::apply(SmartMet::Engine::Avi::StationQueryData &theStationData) const
+{
+  try
+  {
+    SmartMet::Engine::Avi::StationIdList stationIds;
+
+    for (auto stationId : theStationData.itsStationIds)
+    {
+      auto &values = theStationData.itsValues[stationId];
+      const auto &messages = values["message"];
+      auto selected = selectRows(messages);
+
+      if (std::find(selected.begin(), selected.end(), true) == selected.end())
+      {
+        theStationData.itsValues.erase(stationId);
+        continue;
+      }
+
+      keepRows(values, messages.size(), selected);
+      stationIds.push_back(stationId);
+    }
+
+    theStationData.itsStationIds.swap(stationIds);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove rows with non matching message
+ */
+// ----------------------------------------------------------------------
+
+void MessageFilter::apply(SmartMet::Engine::Avi::QueryData &theQueryData) const
+{
+  try
+  {
+    const auto &messages = theQueryData.itsValues["message"];
+    keepRows(theQueryData.itsValues, messages.size(), selectRows(messages));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
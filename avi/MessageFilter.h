@@ -0,0 +1,74 @@
+// ======================================================================
+/*!
+ * \brief Filtering of messages by their text
+ *
+ * Messages are selected if they contain any of the given substrings
+ * ('contains') and/or any of the given whole tokens ('match'), such as
+ * weather phenomena TS, CB or FZRA. All patterns of an option are
+ * matched in a single pass over the message with an Aho-Corasick
+ * automaton. Matching is case insensitive.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class MessageFilter
+{
+ public:
+  // Empty pattern lists match all messages
+
+  MessageFilter(const std::vector<std::string> &theSubstrings,
+                const std::vector<std::string> &theTokens);
+  MessageFilter() = delete;
+
+  bool matches(std::string_view theMessage) const;
+
+  // Remove rows whose 'message' column does not match; stations without
+  // remaining rows are removed
+
+  void apply(SmartMet::Engine::Avi::StationQueryData &theStationData) const;
+  void apply(SmartMet::Engine::Avi::QueryData &theQueryData) const;
+
+ private:
+  // Automaton with transitions resolved for all bytes; state 0 is the root
+
+  class Automaton
+  {
+   public:
+    explicit Automaton(const std::vector<std::string> &thePatterns);
+
+    // Match anywhere, or only tokens delimited by white space or '='
+
+    bool search(std::string_view theText, bool isToken) const;
+
+   private:
+    std::vector<std::uint32_t> itsTransitions;             // 256 per state
+    std::vector<std::vector<std::uint32_t>> itsOutputs;  // lengths of patterns ending at state
+  };
+
+  std::vector<bool> selectRows(const SmartMet::Engine::Avi::ValueVector &theMessages) const;
+
+  std::optional<Automaton> itsSubstrings;
+  std::optional<Automaton> itsTokens;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
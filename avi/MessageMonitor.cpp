@@ -0,0 +1,247 @@
+// ======================================================================
+
+#include "MessageMonitor.h"
+#include "Utils.h"
+#include <macgyver/DateTime.h>
+#include <macgyver/Exception.h>
+#include <macgyver/TimeFormatter.h>
+#include <set>
+#include <unordered_map>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+MessageMonitor::MessageMonitor(std::shared_ptr<SmartMet::Engine::Avi::Engine> theEngine,
+                               unsigned int theLookbackMinutes)
+    : itsEngine(std::move(theEngine)), itsLookbackMinutes(theLookbackMinutes)
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add listener for new messages
+ */
+// ----------------------------------------------------------------------
+
+void MessageMonitor::addListener(Listener theListener)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  itsListeners.push_back(std::move(theListener));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Query messages of all stations within the lookback period
+ *
+ *        Created messages time range restriction is based on message time,
+ *        thus late arriving messages are caught with long enough lookback
+ */
+// ----------------------------------------------------------------------
+
+MessageMonitor::Messages MessageMonitor::query() const
+{
+  try
+  {
+    SmartMet::Engine::Avi::QueryOptions options;
+    auto now = Fmi::SecondClock::universal_time();
+
+    options.itsLocationOptions.itsBBoxes.emplace_back(-180, 180, -90, 90);
+    options.itsLocationOptions.itsMaxDistance = 0;
+    options.itsParameters = {"stationid", "icao", "messagetype", "messageid"};
+    options.itsTimeOptions.itsStartTime = timestampOption(now - Fmi::Minutes(itsLookbackMinutes));
+    options.itsTimeOptions.itsEndTime = timestampOption(now + Fmi::Hours(1));
+    options.itsTimeOptions.itsQueryValidRangeMessages = false;
+    options.itsTimeOptions.itsTimeFormat = "iso";
+    options.itsMessageFormat = "TAC";
+    options.itsFilterMETARs = false;
+    options.itsMaxMessageStations = 0;
+    options.itsMaxMessageRows = 0;
+
+    auto stationData = itsEngine->queryStationsAndMessages(options);
+
+    Messages messages;
+
+    for (auto stationId : stationData.itsStationIds)
+    {
+      auto &values = stationData.itsValues[stationId];
+      const auto &icaos = values["icao"];
+      const auto &messageTypes = values["messagetype"];
+      const auto &messageIds = values["messageid"];
+
+      for (size_t row = 0; (row < messageIds.size()); row++)
+      {
+        auto messageId = numericValue(messageIds[row]);
+
+        if (!messageId || (row >= icaos.size()) || (row >= messageTypes.size()))
+          continue;
+
+        messages.push_back({stationId,
+                            stringValue(icaos[row]).value_or(""),
+                            stringValue(messageTypes[row]).value_or(""),
+                            static_cast<long>(*messageId),
+                            "",
+                            ""});
+      }
+    }
+
+    return messages;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Query message time and message of given (new) messages
+ */
+// ----------------------------------------------------------------------
+
+void MessageMonitor::queryContents(Messages &theMessages) const
+{
+  try
+  {
+    SmartMet::Engine::Avi::QueryOptions options;
+    auto now = Fmi::SecondClock::universal_time();
+
+    std::set<SmartMet::Engine::Avi::StationIdType> stationIds;
+    std::unordered_map<long, Message *> messagesById;
+
+    for (auto &message : theMessages)
+    {
+      stationIds.insert(message.itsStationId);
+      messagesById[message.itsMessageId] = &message;
+    }
+
+    options.itsLocationOptions.itsStationIds.assign(stationIds.begin(), stationIds.end());
+    options.itsParameters = {"messageid", "messagetime", "message"};
+    options.itsTimeOptions.itsStartTime = timestampOption(now - Fmi::Minutes(itsLookbackMinutes));
+    options.itsTimeOptions.itsEndTime = timestampOption(now + Fmi::Hours(1));
+    options.itsTimeOptions.itsQueryValidRangeMessages = false;
+    options.itsTimeOptions.itsTimeFormat = "iso";
+    options.itsMessageFormat = "TAC";
+    options.itsFilterMETARs = false;
+    options.itsMaxMessageStations = 0;
+    options.itsMaxMessageRows = 0;
+
+    auto stationData = itsEngine->queryStationsAndMessages(options);
+
+    std::shared_ptr<Fmi::TimeFormatter> timeFormatter(Fmi::TimeFormatter::create("xml"));
+
+    for (auto stationId : stationData.itsStationIds)
+    {
+      auto &values = stationData.itsValues[stationId];
+      const auto &messageIds = values["messageid"];
+      const auto &messageTimes = values["messagetime"];
+      const auto &messageTexts = values["message"];
+
+      for (size_t row = 0; (row < messageIds.size()); row++)
+      {
+        auto messageId = numericValue(messageIds[row]);
+
+        if (!messageId || (row >= messageTimes.size()) || (row >= messageTexts.size()))
+          continue;
+
+        auto it = messagesById.find(static_cast<long>(*messageId));
+
+        if (it == messagesById.end())
+          continue;
+
+        auto messageTime = timeValue(messageTimes[row]);
+
+        if (messageTime)
+          it->second->itsMessageTime = timeFormatter->format(*messageTime);
+
+        it->second->itsMessage = stringValue(messageTexts[row]).value_or("");
+      }
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Query recent messages and notify listeners about new ones
+ */
+// ----------------------------------------------------------------------
+
+void MessageMonitor::poll()
+{
+  try
+  {
+    update(query());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Notify listeners about messages not seen in the previous update.
+ *
+ *        The first update only initializes the set of known messages
+ */
+// ----------------------------------------------------------------------
+
+void MessageMonitor::update(Messages theMessages)
+{
+  try
+  {
+    std::unordered_set<long> seenMessageIds;
+    Messages newMessages;
+
+    for (auto &message : theMessages)
+    {
+      seenMessageIds.insert(message.itsMessageId);
+
+      if (itsSeenMessageIds.find(message.itsMessageId) == itsSeenMessageIds.end())
+        newMessages.push_back(std::move(message));
+    }
+
+    itsSeenMessageIds.swap(seenMessageIds);
+
+    if (itsFirstPoll)
+    {
+      itsFirstPoll = false;
+      return;
+    }
+
+    if (newMessages.empty())
+      return;
+
+    if (itsFetchMessageContents)
+      queryContents(newMessages);
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    for (const auto &listener : itsListeners)
+      listener(newMessages);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
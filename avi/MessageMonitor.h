@@ -0,0 +1,86 @@
+// ======================================================================
+/*!
+ * \brief Detects new messages by polling the engine
+ *
+ * One shared query for recently created messages of all stations
+ * replaces per-client change detection. Listeners are called with
+ * the messages not seen in the previous poll.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class MessageMonitor
+{
+ public:
+  struct Message
+  {
+    SmartMet::Engine::Avi::StationIdType itsStationId;
+    std::string itsIcao;
+    std::string itsMessageType;
+    long itsMessageId;
+
+    // Set only if message contents are fetched
+
+    std::string itsMessageTime;
+    std::string itsMessage;
+  };
+
+  using Messages = std::vector<Message>;
+  using Listener = std::function<void(const Messages &)>;
+
+  MessageMonitor(std::shared_ptr<SmartMet::Engine::Avi::Engine> theEngine,
+                 unsigned int theLookbackMinutes);
+  MessageMonitor() = delete;
+  MessageMonitor(const MessageMonitor &other) = delete;
+  MessageMonitor &operator=(const MessageMonitor &other) = delete;
+
+  void addListener(Listener theListener);
+
+  // Fetch message time and message of new messages before notifying listeners
+
+  void fetchMessageContents() { itsFetchMessageContents = true; }
+
+  // Query recent messages and notify listeners about new ones
+
+  void poll();
+
+  // Notify listeners about the messages not seen in the previous update; called
+  // by poll() and by a stand-in message source
+
+  void update(Messages theMessages);
+
+ private:
+  Messages query() const;
+  void queryContents(Messages &theMessages) const;
+
+  std::shared_ptr<SmartMet::Engine::Avi::Engine> itsEngine;
+  const unsigned int itsLookbackMinutes;
+
+  std::mutex itsMutex;
+  std::vector<Listener> itsListeners;
+  std::unordered_set<long> itsSeenMessageIds;
+  bool itsFirstPoll = true;
+  bool itsFetchMessageContents = false;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,105 @@
+// ======================================================================
+
+#include "NdjsonWriter.h"
+#include "Utils.h"
+#include <macgyver/Exception.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+NdjsonWriter::NdjsonWriter(const SmartMet::Engine::Avi::Columns &theColumns,
+                           ColumnValues theValues,
+                           std::size_t theStations,
+                           int thePrecision,
+                           std::shared_ptr<Fmi::TimeFormatter> theTimeFormatter,
+                           std::optional<Fmi::TimeZonePtr> theTimeZone)
+    : itsValues(std::move(theValues)),
+      itsStations(theStations),
+      itsValueFormatter(thePrecision, std::move(theTimeFormatter), std::move(theTimeZone))
+{
+  try
+  {
+    for (const auto &column : theColumns)
+    {
+      std::string key = (itsKeys.empty() ? "{" : ",");
+      appendJsonString(key, column.itsName);
+      key += ':';
+
+      itsKeys.push_back(key);
+      itsTypes.push_back(column.itsType);
+    }
+
+    if (itsValues.size() != itsTypes.size() * itsStations)
+      throw Fmi::Exception(BCP, "Number of column values does not match the columns");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append rows
+ */
+// ----------------------------------------------------------------------
+
+bool NdjsonWriter::write(std::string &theOutput, std::size_t theMinBytes)
+{
+  try
+  {
+    auto start = theOutput.size();
+    std::size_t nColumns = itsTypes.size();
+
+    for (; (itsStation < itsStations); itsStation++, itsRow = 0)
+    {
+      // Missing values of a column are written as nulls
+
+      std::size_t rows = 0;
+
+      for (std::size_t column = 0; (column < nColumns); column++)
+        rows = std::max(rows, itsValues[column * itsStations + itsStation]->size());
+
+      for (; (itsRow < rows); itsRow++)
+      {
+        if (theOutput.size() - start >= theMinBytes)
+          return true;
+
+        for (std::size_t column = 0; (column < nColumns); column++)
+        {
+          const auto &values = *itsValues[column * itsStations + itsStation];
+
+          theOutput += itsKeys[column];
+
+          if (itsRow < values.size())
+            itsValueFormatter.append(theOutput, itsTypes[column], values[itsRow]);
+          else
+            theOutput += "null";
+        }
+
+        theOutput += (nColumns > 0 ? "}\n" : "{}\n");
+      }
+    }
+
+    return false;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
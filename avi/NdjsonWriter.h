@@ -0,0 +1,65 @@
+// ======================================================================
+/*!
+ * \brief Newline delimited JSON output of query results
+ *
+ * Writes one JSON object per message row directly from the result
+ * columns. Rows are written in chunks, so that the output can be sent
+ * while the rest of the rows are still being formatted.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "JsonValueFormatter.h"
+#include "ResultWriter.h"
+#include <engines/avi/Engine.h>
+
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class NdjsonWriter : public ResultWriter
+{
+ public:
+  // Values of column c for station s are at index c * theStations + s
+
+  using ColumnValues = std::pmr::vector<const SmartMet::Engine::Avi::ValueVector *>;
+
+  NdjsonWriter(const SmartMet::Engine::Avi::Columns &theColumns,
+               ColumnValues theValues,
+               std::size_t theStations,
+               int thePrecision,
+               std::shared_ptr<Fmi::TimeFormatter> theTimeFormatter,
+               std::optional<Fmi::TimeZonePtr> theTimeZone);
+  NdjsonWriter() = delete;
+  NdjsonWriter(const NdjsonWriter &other) = delete;
+  NdjsonWriter &operator=(const NdjsonWriter &other) = delete;
+
+  bool write(std::string &theOutput, std::size_t theMinBytes) override;
+
+ private:
+  std::vector<SmartMet::Engine::Avi::ColumnType> itsTypes;
+  std::vector<std::string> itsKeys;  // '"name":' with separators
+  const ColumnValues itsValues;
+  const std::size_t itsStations;
+  const JsonValueFormatter itsValueFormatter;
+
+  // Next row to write
+
+  std::size_t itsStation = 0;
+  std::size_t itsRow = 0;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,170 @@
+// ======================================================================
+
+#include "NegativeCache.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+NegativeCache::NegativeCache(size_t theMaxSize, unsigned int theEmptyResultTTL)
+    : itsUnknownLocations(theMaxSize),
+      itsEmptyResults(theMaxSize),
+      itsEmptyResultTTL(theEmptyResultTTL)
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Location identifier keys; icao codes are case insensitive
+ */
+// ----------------------------------------------------------------------
+
+string NegativeCache::icaoKey(const string &theIcao)
+{
+  return "icao:" + Fmi::ascii_toupper_copy(theIcao);
+}
+
+string NegativeCache::placeKey(const string &thePlace)
+{
+  return "place:" + thePlace;
+}
+
+string NegativeCache::stationIdKey(SmartMet::Engine::Avi::StationIdType theStationId)
+{
+  return "stationid:" + Fmi::to_string(theStationId);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remember unknown location identifier
+ */
+// ----------------------------------------------------------------------
+
+void NegativeCache::addUnknownLocation(const string &theKey)
+{
+  try
+  {
+    itsUnknownLocations.insert(theKey, true);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the first unknown location identifier of the options if any
+ */
+// ----------------------------------------------------------------------
+
+std::optional<string> NegativeCache::findUnknownLocation(
+    const SmartMet::Engine::Avi::LocationOptions &theOptions) const
+{
+  try
+  {
+    if (itsUnknownLocations.size() == 0)
+      return std::nullopt;
+
+    for (const auto &icao : theOptions.itsIcaos)
+      if (itsUnknownLocations.find(icaoKey(icao)))
+        return "icao '" + icao + "'";
+
+    for (const auto &place : theOptions.itsPlaces)
+      if (itsUnknownLocations.find(placeKey(place)))
+        return "place '" + place + "'";
+
+    for (auto stationId : theOptions.itsStationIds)
+      if (itsUnknownLocations.find(stationIdKey(stationId)))
+        return "stationid " + Fmi::to_string(stationId);
+
+    return std::nullopt;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void NegativeCache::clearUnknownLocations()
+{
+  itsUnknownLocations.clear();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remember query returning no rows
+ */
+// ----------------------------------------------------------------------
+
+void NegativeCache::addEmptyResult(const string &theFingerprint)
+{
+  try
+  {
+    itsEmptyResults.insert(theFingerprint, Clock::now() + itsEmptyResultTTL);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if query is known to return no rows
+ *
+ *        Expired entries are left to be dropped as least recently used
+ */
+// ----------------------------------------------------------------------
+
+bool NegativeCache::isEmptyResult(const string &theFingerprint) const
+{
+  try
+  {
+    auto expires = itsEmptyResults.find(theFingerprint);
+    return (expires && (*expires > Clock::now()));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void NegativeCache::clearEmptyResults()
+{
+  itsEmptyResults.clear();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cache statistics
+ */
+// ----------------------------------------------------------------------
+
+Fmi::Cache::CacheStats NegativeCache::getUnknownLocationStats() const
+{
+  return itsUnknownLocations.statistics();
+}
+
+Fmi::Cache::CacheStats NegativeCache::getEmptyResultStats() const
+{
+  return itsEmptyResults.statistics();
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,70 @@
+// ======================================================================
+/*!
+ * \brief Cache of unknown location identifiers and empty query results
+ *
+ * Unknown icao codes, place names and station id's are remembered until
+ * the stations are refreshed. Fingerprints of queries returning no rows
+ * are remembered for a short time or until new messages arrive. The
+ * least recently used entries are dropped when a cache is full.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+#include <macgyver/Cache.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class NegativeCache
+{
+ public:
+  NegativeCache(std::size_t theMaxSize, unsigned int theEmptyResultTTL);
+  NegativeCache() = delete;
+  NegativeCache(const NegativeCache &other) = delete;
+  NegativeCache &operator=(const NegativeCache &other) = delete;
+
+  // Location identifier keys
+
+  static std::string icaoKey(const std::string &theIcao);
+  static std::string placeKey(const std::string &thePlace);
+  static std::string stationIdKey(SmartMet::Engine::Avi::StationIdType theStationId);
+
+  // Unknown locations; returns the first unknown identifier of the options if any
+
+  void addUnknownLocation(const std::string &theKey);
+  std::optional<std::string> findUnknownLocation(
+      const SmartMet::Engine::Avi::LocationOptions &theOptions) const;
+  void clearUnknownLocations();
+
+  // Empty results
+
+  void addEmptyResult(const std::string &theFingerprint);
+  bool isEmptyResult(const std::string &theFingerprint) const;
+  void clearEmptyResults();
+
+  Fmi::Cache::CacheStats getUnknownLocationStats() const;
+  Fmi::Cache::CacheStats getEmptyResultStats() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  mutable Fmi::Cache::Cache<std::string, bool> itsUnknownLocations;
+  mutable Fmi::Cache::Cache<std::string, Clock::time_point> itsEmptyResults;
+
+  const std::chrono::seconds itsEmptyResultTTL;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
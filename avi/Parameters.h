@@ -0,0 +1,193 @@
+// ======================================================================
+/*!
+ * \brief Interned identifiers of the avi parameters
+ *
+ * Parameter names are mapped to ids with a perfect hash table generated
+ * at compile time, so that a lookup costs one hash and one comparison.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace Parameters
+{
+enum class Id : std::uint8_t
+{
+  StationId,
+  Icao,
+  Name,
+  Latitude,
+  Longitude,
+  LonLat,
+  LatLon,
+  Distance,
+  Bearing,
+  Elevation,
+  StationValidFrom,
+  StationValidTo,
+  StationModified,
+  Iso2,
+  MessageType,
+  MessageTypeDescription,
+  MessageTypeModified,
+  Route,
+  RouteDescription,
+  RouteModified,
+  MessageId,
+  Message,
+  MessageTime,
+  MessageValidFrom,
+  MessageValidTo,
+  MessageCreated,
+  MessageFileModified,
+  MessirHeading,
+  MessageVersion,
+  MessageRejectedReason,
+  MessageRejectedIcao
+};
+
+// Names in Id order
+
+constexpr std::array<std::string_view, 31> names{"stationid",
+                                                  "icao",
+                                                  "name",
+                                                  "latitude",
+                                                  "longitude",
+                                                  "lonlat",
+                                                  "latlon",
+                                                  "distance",
+                                                  "bearing",
+                                                  "elevation",
+                                                  "stationvalidfrom",
+                                                  "stationvalidto",
+                                                  "stationmodified",
+                                                  "iso2",
+                                                  "messagetype",
+                                                  "messagetypedescription",
+                                                  "messagetypemodified",
+                                                  "route",
+                                                  "routedescription",
+                                                  "routemodified",
+                                                  "messageid",
+                                                  "message",
+                                                  "messagetime",
+                                                  "messagevalidfrom",
+                                                  "messagevalidto",
+                                                  "messagecreated",
+                                                  "messagefilemodified",
+                                                  "messirheading",
+                                                  "messageversion",
+                                                  "messagerejectedreason",
+                                                  "messagerejectedicao"};
+
+constexpr std::size_t count = names.size();
+
+static_assert(count == static_cast<std::size_t>(Id::MessageRejectedIcao) + 1,
+              "Parameter names and ids do not match");
+
+namespace Detail
+{
+constexpr std::size_t tableSize = 128;
+
+constexpr std::uint32_t hash(std::string_view theName, std::uint32_t theSeed)
+{
+  std::uint32_t h = 2166136261U ^ theSeed;
+
+  for (char c : theName)
+  {
+    h ^= static_cast<unsigned char>(c);
+    h *= 16777619U;
+  }
+
+  return h;
+}
+
+// First seed mapping all names to different slots
+
+constexpr std::uint32_t findSeed()
+{
+  for (std::uint32_t seed = 0;; seed++)
+  {
+    std::array<bool, tableSize> used{};
+    bool collision = false;
+
+    for (auto name : names)
+    {
+      auto slot = hash(name, seed) % tableSize;
+      collision = used[slot];
+
+      if (collision)
+        break;
+
+      used[slot] = true;
+    }
+
+    if (!collision)
+      return seed;
+  }
+}
+
+constexpr std::uint32_t seed = findSeed();
+
+// Slot values are id + 1; zero marks an empty slot
+
+constexpr std::array<std::uint8_t, tableSize> makeTable()
+{
+  std::array<std::uint8_t, tableSize> table{};
+
+  for (std::size_t i = 0; (i < count); i++)
+    table[hash(names[i], seed) % tableSize] = static_cast<std::uint8_t>(i + 1);
+
+  return table;
+}
+
+constexpr std::array<std::uint8_t, tableSize> table = makeTable();
+}  // namespace Detail
+
+// Lookup by lower case name
+
+constexpr std::optional<Id> find(std::string_view theName)
+{
+  auto slot = Detail::table[Detail::hash(theName, Detail::seed) % Detail::tableSize];
+
+  if ((slot == 0) || (names[slot - 1] != theName))
+    return std::nullopt;
+
+  return static_cast<Id>(slot - 1);
+}
+
+constexpr std::size_t index(Id theId)
+{
+  return static_cast<std::size_t>(theId);
+}
+
+constexpr std::string_view name(Id theId)
+{
+  return names[index(theId)];
+}
+
+// Station parameters have the same value in all messages of the station
+
+constexpr bool isStationParameter(Id theId)
+{
+  return (index(theId) <= index(Id::Iso2));
+}
+
+}  // namespace Parameters
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
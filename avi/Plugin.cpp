@@ -5,20 +5,44 @@
 // ======================================================================
 
 #include "Plugin.h"
+#include "ArrowWriter.h"
+#include "GeoJsonWriter.h"
+#include "JsonLayoutWriter.h"
+#include "NdjsonWriter.h"
+#include "Parameters.h"
 #include "Query.h"
+#include "ResultBudget.h"
+#include "Tokenizer.h"
+#include "Utils.h"
+#include <boost/algorithm/string.hpp>
 #include <macgyver/Exception.h>
 #include <macgyver/LocalDateTime.h>
 #include <macgyver/StringConversion.h>
 #include <macgyver/TimeZoneFactory.h>
 #include <macgyver/ValueFormatter.h>
 #include <spine/Convenience.h>
+#include <spine/FmiApiKey.h>
 #include <spine/HostInfo.h>
 #include <spine/Reactor.h>
 #include <spine/SmartMet.h>
 #include <spine/Table.h>
 #include <spine/TableFormatterFactory.h>
 #include <timeseries/TableFeeder.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
 
 using namespace std;
 
@@ -30,18 +54,1987 @@ namespace Avi
 {
 namespace
 {
+// ----------------------------------------------------------------------
+/*!
+ * \brief Report current exception as request processing error
+ */
+// ----------------------------------------------------------------------
+
+void reportError(const SmartMet::Spine::HTTP::Request &theRequest,
+                 SmartMet::Spine::HTTP::Response &theResponse,
+                 bool isdebug)
+{
+  // Catching all exceptions
+
+  Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
+  exception.addParameter("URI", theRequest.getURI());
+  exception.addParameter("ClientIP", theRequest.getClientIP());
+  exception.addParameter("HostName", Spine::HostInfo::getHostName(theRequest.getClientIP()));
+  exception.printError();
+
+  if (isdebug)
+  {
+    // Delivering the exception information as HTTP content
+
+    std::string fullMessage = std::string("Error: ") + exception.getHtmlStackTrace();
+    theResponse.setContent(fullMessage);
+    theResponse.setStatus(HTTP::Status::ok);
+  }
+  else
+  {
+    theResponse.setStatus(HTTP::Status::bad_request);
+  }
+
+  // Adding the first exception information into the response header
+
+  std::string firstMessage = exception.what();
+  boost::algorithm::replace_all(firstMessage, "\n", " ");
+  firstMessage = firstMessage.substr(0, 300);
+  theResponse.setHeader("X-Avi-Error", firstMessage);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Set column headers using the order the columns were listed in the request
  */
 // ----------------------------------------------------------------------
 
-void setColumnHeaders(TableFormatter::Names &headers, const SmartMet::Engine::Avi::Columns &columns)
+void setColumnHeaders(TableFormatter::Names &headers, const SmartMet::Engine::Avi::Columns &columns)
+{
+  try
+  {
+    for (const auto &column : columns)
+      headers.push_back(column.itsName);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set column precision
+ */
+// ----------------------------------------------------------------------
+
+void setPrecisions(size_t nColumns, const Query &query, vector<int> &precisions)
+{
+  try
+  {
+    for (size_t n = 0; (n < nColumns); n++)
+      precisions.push_back(query.itsPrecision);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set column headers from requested parameters when the query is not executed
+ */
+// ----------------------------------------------------------------------
+
+const char *digestColumn = "messagedigest";
+
+void setColumnHeaders(TableFormatter::Names &headers, const Query &query)
+{
+  try
+  {
+    if (query.itsAggregation)
+    {
+      for (const auto &key : query.itsAggregation->keys())
+        headers.push_back(key.itsName);
+
+      headers.push_back("count");
+      return;
+    }
+
+    const auto &hidden = query.itsCursorColumns;
+    const auto &selection = query.itsSelectionColumns;
+
+    for (const auto &param : query.itsQueryOptions.itsParameters)
+      if ((std::find(hidden.begin(), hidden.end(), param) == hidden.end()) &&
+          (std::find(selection.begin(), selection.end(), param) == selection.end()))
+        headers.push_back((query.itsDigest && (param == "message")) ? digestColumn : param);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Replace message column with 64-bit hashes of the messages
+ */
+// ----------------------------------------------------------------------
+
+void digestMessages(SmartMet::Engine::Avi::StationQueryData &stationData)
+{
+  try
+  {
+    for (auto &column : stationData.itsColumns)
+      if (column.itsName == "message")
+      {
+        column.itsName = digestColumn;
+        column.itsType = SmartMet::Engine::Avi::ColumnType::String;
+      }
+
+    for (auto &values : stationData.itsValues)
+    {
+      auto pos = values.second.find("message");
+
+      if (pos == values.second.end())
+        continue;
+
+      auto messages = std::move(pos->second);
+      values.second.erase(pos);
+
+      for (auto &message : messages)
+        if (const auto *text = std::get_if<std::string>(&message))
+          message = hexString(hash64(*text));
+
+      values.second.emplace(digestColumn, std::move(messages));
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove columns added for incremental query filtering or row selection
+ */
+// ----------------------------------------------------------------------
+
+void removeColumns(SmartMet::Engine::Avi::StationQueryData &stationData,
+                   const std::list<std::string> &columns)
+{
+  try
+  {
+    for (const auto &name : columns)
+    {
+      stationData.itsColumns.remove_if([&name](const SmartMet::Engine::Avi::Column &column)
+                                       { return (column.itsName == name); });
+
+      for (auto &values : stationData.itsValues)
+        values.second.erase(name);
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void removeColumns(SmartMet::Engine::Avi::QueryData &queryData,
+                   const std::list<std::string> &columns)
+{
+  try
+  {
+    for (const auto &name : columns)
+    {
+      queryData.itsColumns.remove_if([&name](const SmartMet::Engine::Avi::Column &column)
+                                     { return (column.itsName == name); });
+      queryData.itsValues.erase(name);
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Resolve the values of each station in column order
+ *
+ *        The engine returns values keyed by column name. The names are mapped
+ *        to column positions by parameter id; the returned vector holds
+ *        the values of column c and station s at c * stationcount + s
+ */
+// ----------------------------------------------------------------------
+
+std::pmr::vector<const SmartMet::Engine::Avi::ValueVector *> columnValues(
+    const SmartMet::Engine::Avi::StationQueryData &stationData, RequestArena &arena)
+{
+  try
+  {
+    static const SmartMet::Engine::Avi::ValueVector noValues;
+
+    // Columns are validated query parameters; others are looked up by name
+
+    std::array<int, Parameters::count> columnIndex;
+    columnIndex.fill(-1);
+
+    std::pmr::vector<std::pair<std::size_t, const std::string *>> namedColumns(&arena);
+    std::size_t nColumns = 0;
+
+    for (const auto &column : stationData.itsColumns)
+    {
+      auto id = Parameters::find(column.itsName);
+
+      if (id)
+        columnIndex[Parameters::index(*id)] = static_cast<int>(nColumns);
+      else
+        namedColumns.emplace_back(nColumns, &column.itsName);
+
+      nColumns++;
+    }
+
+    std::size_t nStations = stationData.itsStationIds.size();
+    std::pmr::vector<const SmartMet::Engine::Avi::ValueVector *> values(
+        nColumns * nStations, &noValues, &arena);
+    std::size_t station = 0;
+
+    for (auto stationId : stationData.itsStationIds)
+    {
+      auto it = stationData.itsValues.find(stationId);
+
+      if (it != stationData.itsValues.end())
+      {
+        for (const auto &column : it->second)
+        {
+          auto id = Parameters::find(column.first);
+
+          if (id && (columnIndex[Parameters::index(*id)] >= 0))
+            values[columnIndex[Parameters::index(*id)] * nStations + station] = &column.second;
+        }
+
+        for (const auto &namedColumn : namedColumns)
+        {
+          auto column = it->second.find(*namedColumn.second);
+
+          if (column != it->second.end())
+            values[namedColumn.first * nStations + station] = &column->second;
+        }
+      }
+
+      station++;
+    }
+
+    return values;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Output mime type of format
+ */
+// ----------------------------------------------------------------------
+
+const char *arrowMimeType = "application/vnd.apache.arrow.stream";
+const char *ndjsonMimeType = "application/x-ndjson; charset=UTF-8";
+const char *geoJsonMimeType = "application/geo+json; charset=UTF-8";
+
+std::string outputMimeType(const std::string &theFormat)
+{
+  if (theFormat == "arrow")
+    return arrowMimeType;
+  if (theFormat == "ndjson")
+    return ndjsonMimeType;
+  if (theFormat == "geojson")
+    return geoJsonMimeType;
+
+  std::shared_ptr<TableFormatter> formatter(TableFormatterFactory::create(theFormat));
+  return formatter->mimetype() + "; charset=UTF-8";
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Time zone for time columns; none for utc
+ */
+// ----------------------------------------------------------------------
+
+std::optional<Fmi::TimeZonePtr> outputTimeZone(const Query &query)
+{
+  const auto &timeZone = query.itsQueryOptions.itsTimeOptions.itsTimeZone;
+
+  if (timeZone.empty() || (timeZone == "utc"))
+    return std::nullopt;
+
+  return Fmi::TimeZoneFactory::instance().time_zone_from_string(timeZone);
+}
+
+using ColumnValues = std::pmr::vector<const SmartMet::Engine::Avi::ValueVector *>;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Result columns and their values in column order
+ *
+ *        Rejected messages are returned as a single station. The size of
+ *        the values is checked before formatting
+ */
+// ----------------------------------------------------------------------
+
+struct ResultColumns
+{
+  const SmartMet::Engine::Avi::Columns *itsColumns;
+  ColumnValues itsValues;
+  std::size_t itsStations;
+};
+
+ResultColumns resultColumns(const Query &query,
+                            QueryResult &theResult,
+                            RequestArena &theArena,
+                            ResultBudget &theBudget)
+{
+  try
+  {
+    static const SmartMet::Engine::Avi::Columns noColumns;
+    ResultColumns result{&noColumns, ColumnValues(&theArena), 0};
+
+    if (theResult.itsNoRows)
+      return result;
+
+    if (query.itsQueryOptions.itsValidity == Engine::Avi::Validity::Accepted)
+    {
+      result.itsColumns = &theResult.itsStationData.itsColumns;
+      result.itsValues = columnValues(theResult.itsStationData, theArena);
+      result.itsStations = theResult.itsStationData.itsStationIds.size();
+    }
+    else
+    {
+      result.itsColumns = &theResult.itsRejectedData.itsColumns;
+      result.itsStations = 1;
+
+      for (const auto &column : *result.itsColumns)
+        result.itsValues.push_back(&theResult.itsRejectedData.itsValues[column.itsName]);
+    }
+
+    for (const auto *values : result.itsValues)
+      theBudget.add(*values);
+
+    return result;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Formatter for time columns
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<Fmi::TimeFormatter> outputTimeFormatter(const Query &query)
+{
+  return std::shared_ptr<Fmi::TimeFormatter>(
+      Fmi::TimeFormatter::create(query.itsQueryOptions.itsTimeOptions.itsTimeFormat));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Whether the format is written in chunks by a ResultWriter
+ */
+// ----------------------------------------------------------------------
+
+bool isChunkedFormat(const std::string &theFormat)
+{
+  return ((theFormat == "ndjson") || (theFormat == "geojson") || (theFormat == "arrow"));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Newline delimited JSON, GeoJSON or Arrow writer of query result
+ *
+ *        Column types of empty results are not known since the engine is not
+ *        queried; Arrow output then has string columns
+ */
+// ----------------------------------------------------------------------
+
+std::unique_ptr<ResultWriter> resultWriter(const Query &query,
+                                           QueryResult &theResult,
+                                           RequestArena &theArena,
+                                           ResultBudget &theBudget)
+{
+  try
+  {
+    auto result = resultColumns(query, theResult, theArena, theBudget);
+
+    if (query.itsFormat == "arrow")
+    {
+      if (!theResult.itsNoRows)
+        return std::make_unique<ArrowWriter>(
+            *result.itsColumns, std::move(result.itsValues), result.itsStations);
+
+      TableFormatter::Names headers;
+      setColumnHeaders(headers, query);
+
+      SmartMet::Engine::Avi::Columns columns;
+
+      for (const auto &header : headers)
+        columns.emplace_back(SmartMet::Engine::Avi::ColumnType::String, header);
+
+      return std::make_unique<ArrowWriter>(columns, std::move(result.itsValues), 0);
+    }
+
+    if (query.itsFormat == "geojson")
+      return std::make_unique<GeoJsonWriter>(*result.itsColumns,
+                                             std::move(result.itsValues),
+                                             result.itsStations,
+                                             query.itsPrecision,
+                                             outputTimeFormatter(query),
+                                             outputTimeZone(query),
+                                             query.itsSimplify);
+
+    return std::make_unique<NdjsonWriter>(*result.itsColumns,
+                                          std::move(result.itsValues),
+                                          result.itsStations,
+                                          query.itsPrecision,
+                                          outputTimeFormatter(query),
+                                          outputTimeZone(query));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Column-oriented or station-grouped JSON output of query result
+ *
+ *        Empty results have no columns; column layout is then an empty object
+ */
+// ----------------------------------------------------------------------
+
+std::string formatJsonLayout(const Query &query,
+                             QueryResult &theResult,
+                             RequestArena &theArena,
+                             ResultBudget &theBudget)
+{
+  try
+  {
+    auto result = resultColumns(query, theResult, theArena, theBudget);
+    JsonValueFormatter valueFormatter(
+        query.itsPrecision, outputTimeFormatter(query), outputTimeZone(query));
+    JsonLayoutWriter writer(
+        *result.itsColumns, result.itsValues, result.itsStations, valueFormatter);
+
+    std::string out;
+
+    if (query.itsLayout == "columns")
+      writer.writeColumns(out);
+    else
+      writer.writeStations(out);
+
+    return out;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Chunked format output streamed in chunks of rows
+ */
+// ----------------------------------------------------------------------
+
+const std::size_t streamChunkSize = 65536;
+
+class ResultStream : public SmartMet::Spine::HTTP::ContentStreamer
+{
+ public:
+  ResultStream(std::unique_ptr<QueryResult> theResult, const Query &query)
+      : itsResult(std::move(theResult)), itsBudget(query.itsMaxResultBytes)
+  {
+    itsWriter = resultWriter(query, *itsResult, itsArena, itsBudget);
+  }
+
+  std::string getChunk() override
+  {
+    try
+    {
+      std::string chunk;
+
+      if (!itsDone)
+        itsDone = !itsWriter->write(chunk, streamChunkSize);
+
+      if (chunk.empty())
+        setStatus(StreamerStatus::EXIT_OK);
+
+      return chunk;
+    }
+    catch (...)
+    {
+      Fmi::Exception exception(BCP, "Result stream failed!", nullptr);
+      exception.printError();
+      setStatus(StreamerStatus::EXIT_ERROR);
+      return "";
+    }
+  }
+
+ private:
+  std::unique_ptr<QueryResult> itsResult;
+  RequestArena itsArena;
+  ResultBudget itsBudget;
+  std::unique_ptr<ResultWriter> itsWriter;
+  bool itsDone = false;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Load all stations for the station index
+ */
+// ----------------------------------------------------------------------
+
+std::vector<StationIndex::Station> loadStations(SmartMet::Engine::Avi::Engine &aviEngine)
+{
+  try
+  {
+    SmartMet::Engine::Avi::QueryOptions options;
+
+    options.itsLocationOptions.itsBBoxes.emplace_back(-180, 180, -90, 90);
+    options.itsLocationOptions.itsMaxDistance = 0;
+    options.itsParameters = {"stationid", "icao", "longitude", "latitude"};
+    options.itsTimeOptions.itsObservationTime = "current_timestamp";
+    options.itsTimeOptions.itsTimeFormat = "iso";
+    options.itsMessageFormat = "TAC";
+    options.itsMaxMessageStations = 0;
+    options.itsMaxMessageRows = 0;
+
+    auto stationData = aviEngine.queryStationsAndMessages(options);
+
+    std::vector<StationIndex::Station> stations;
+    stations.reserve(stationData.itsStationIds.size());
+
+    for (auto stationId : stationData.itsStationIds)
+    {
+      auto &values = stationData.itsValues[stationId];
+      const auto &icaos = values["icao"];
+      const auto &lons = values["longitude"];
+      const auto &lats = values["latitude"];
+
+      if (icaos.empty() || lons.empty() || lats.empty())
+        continue;
+
+      const auto *icao = std::get_if<std::string>(&icaos.front());
+      auto lon = numericValue(lons.front());
+      auto lat = numericValue(lats.front());
+
+      if (icao && lon && lat)
+        stations.push_back({stationId, *icao, *lon, *lat});
+    }
+
+    return stations;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if the query can use station index for location options.
+ *
+ *        Distance and bearing from the requested location are calculated
+ *        by the engine, thus the locations must be passed to it as such.
+ */
+// ----------------------------------------------------------------------
+
+bool useStationIndex(const Query &query)
+{
+  if (!StationIndex::resolvable(query.itsQueryOptions))
+    return false;
+
+  for (const auto &param : query.itsQueryOptions.itsParameters)
+    if ((param == "distance") || (param == "bearing"))
+      return false;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Order stations as resolved by the station index (route order)
+ */
+// ----------------------------------------------------------------------
+
+void setStationOrder(SmartMet::Engine::Avi::StationQueryData &stationData,
+                     const SmartMet::Engine::Avi::StationIdList &stationIds)
+{
+  try
+  {
+    std::set<SmartMet::Engine::Avi::StationIdType> queried(stationData.itsStationIds.begin(),
+                                                           stationData.itsStationIds.end());
+    stationData.itsStationIds.clear();
+
+    for (auto stationId : stationIds)
+      if (queried.find(stationId) != queried.end())
+        stationData.itsStationIds.push_back(stationId);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if query is for latest messages at current time
+ */
+// ----------------------------------------------------------------------
+
+bool isCurrentTimeQuery(const Query &query)
+{
+  return (query.itsQueryOptions.itsTimeOptions.itsObservationTime == "current_timestamp");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Request fingerprint for caching empty results
+ */
+// ----------------------------------------------------------------------
+
+std::string requestFingerprint(const SmartMet::Spine::HTTP::Request &theRequest)
+{
+  try
+  {
+    std::string fingerprint;
+
+    for (const auto &param : theRequest.getParameterMap())
+      fingerprint.append(param.first).append("=").append(param.second).append("&");
+
+    return fingerprint;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if parsed query can be cached
+ *
+ *        Current time is resolved when parsing incremental queries and time
+ *        options given relative to current time ('now', '-1h' etc). Queries
+ *        for the latest messages use symbolic 'current_timestamp' and are cached.
+ *        Option names are compared case insensitively, as the parser finds
+ *        e.g. 'starttime' as well as 'startTime'
+ */
+// ----------------------------------------------------------------------
+
+bool isCacheableQuery(const SmartMet::Spine::HTTP::Request &theRequest)
+{
+  try
+  {
+    for (const auto &option : theRequest.getParameterMap())
+    {
+      const auto &name = option.first;
+      const auto &value = option.second;
+
+      if (boost::algorithm::iequals(name, "since"))
+        return false;
+
+      if (!boost::algorithm::iequals(name, Query::startTimeOption) &&
+          !boost::algorithm::iequals(name, Query::endTimeOption) &&
+          !boost::algorithm::iequals(name, "time"))
+        continue;
+
+      // Absolute times are iso, sql, timestamp or epoch times
+
+      if ((value.size() < 8) || !std::isdigit(static_cast<unsigned char>(value.front())))
+        return false;
+
+      for (auto c : value)
+        if (!std::isdigit(static_cast<unsigned char>(c)) && !std::strchr("TZ:-. ", c))
+          return false;
+    }
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse latest message resource '/avi/latest/{TYPE}/{ICAO}.{fmt}'
+ *
+ *        Returns an invalid key if the resource does not match; file
+ *        suffixes are mapped to table formatter names
+ */
+// ----------------------------------------------------------------------
+
+LatestCache::Key latestKey(std::string_view theResource)
+{
+  const std::string_view prefix = "/avi/latest/";
+  const std::string_view invalid;
+
+  static const std::array<std::pair<std::string_view, std::string_view>, 7> formats{
+      {{"txt", "ascii"},
+       {"ascii", "ascii"},
+       {"json", "json"},
+       {"xml", "xml"},
+       {"serial", "serial"},
+       {"html", "html"},
+       {"php", "php"}}};
+
+  if (theResource.substr(0, prefix.size()) != prefix)
+    return {invalid, invalid, invalid};
+
+  auto path = theResource.substr(prefix.size());
+  auto slash = path.find('/');
+  auto dot = path.rfind('.');
+
+  if ((slash == std::string_view::npos) || (dot == std::string_view::npos) || (dot < slash))
+    return {invalid, invalid, invalid};
+
+  auto type = path.substr(0, slash);
+  auto icao = path.substr(slash + 1, dot - slash - 1);
+  auto suffix = path.substr(dot + 1);
+
+  if (icao.find('/') != std::string_view::npos)
+    return {invalid, invalid, invalid};
+
+  for (const auto &format : formats)
+    if (format.first == suffix)
+      return {icao, type, format.second};
+
+  return {invalid, invalid, invalid};
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse batch request body; each nonempty line is a query string
+ */
+// ----------------------------------------------------------------------
+
+std::vector<SmartMet::Spine::HTTP::Request> batchRequests(const std::string &theBody)
+{
+  try
+  {
+    std::vector<SmartMet::Spine::HTTP::Request> requests;
+
+    Tokenizer::forEachToken(theBody,
+                            '\n',
+                            [&](std::string_view line, std::size_t /* lineNumber */)
+                            {
+                              if (line.empty())
+                                return;
+
+                              SmartMet::Spine::HTTP::Request request;
+
+                              Tokenizer::forEachFormParameter(
+                                  line,
+                                  [&](std::string name, std::string value)
+                                  { request.addParameter(name, value); });
+
+                              requests.push_back(std::move(request));
+                            });
+
+    return requests;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add options given in POST request body (form encoded or JSON object)
+ *
+ *        Options already in the request (e.g. parsed by the server from a
+ *        form encoded body) are not duplicated
+ */
+// ----------------------------------------------------------------------
+
+SmartMet::Spine::HTTP::Request requestWithBody(const SmartMet::Spine::HTTP::Request &theRequest)
+{
+  try
+  {
+    auto request = theRequest;
+
+    auto addParameter = [&](const std::string &name, const std::string &value)
+    {
+      auto values = theRequest.getParameterList(name);
+
+      if (std::find(values.begin(), values.end(), value) == values.end())
+        request.addParameter(name, value);
+    };
+
+    auto contentType = theRequest.getHeader("Content-Type");
+
+    if (contentType && (contentType->find("application/json") != std::string::npos))
+    {
+      std::vector<std::pair<std::string, std::string>> parameters;
+      Tokenizer::parseJsonObject(theRequest.getContent(), parameters);
+
+      for (const auto &parameter : parameters)
+        addParameter(parameter.first, parameter.second);
+    }
+    else
+      Tokenizer::forEachFormParameter(theRequest.getContent(),
+                                      [&](const std::string &name, const std::string &value)
+                                      { addParameter(name, value); });
+
+    return request;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Engine call did not complete within the query deadline
+ *
+ *        Passed through the request handler's exception traces to be
+ *        reported as '504 Gateway Timeout'
+ */
+// ----------------------------------------------------------------------
+
+class DeadlineExceeded : public std::runtime_error
+{
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Bulk query queue is full
+ *
+ *        Reported as '503 Service Unavailable'
+ */
+// ----------------------------------------------------------------------
+
+class QueueFull : public std::runtime_error
+{
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run engine call with a deadline
+ *
+ *        The call is run by a thread of the executor. If the deadline passes,
+ *        the request fails and the thread is left to complete the call and
+ *        to discard its result, since the engine provides no means to cancel
+ *        a running database statement; a call still queued when its deadline
+ *        passes is not run at all. Client disconnects are not observable
+ *        here and do not stop the call. 'theOverdueCalls' counts the calls
+ *        still queued or running past their deadline
+ */
+// ----------------------------------------------------------------------
+
+template <typename Call>
+auto callWithDeadline(Call &&theCall,
+                      unsigned int theDeadline,
+                      QueryExecutor &theExecutor,
+                      const std::shared_ptr<std::atomic<unsigned int>> &theOverdueCalls,
+                      unsigned int theMaxOverdueCalls) -> decltype(theCall())
+{
+  using Result = decltype(theCall());
+
+  if (*theOverdueCalls >= theMaxOverdueCalls)
+    throw DeadlineExceeded("Database busy, " + Fmi::to_string(theMaxOverdueCalls) +
+                           " queries exceeding their deadline are still running");
+
+  enum State
+  {
+    Running,
+    Completed,
+    Abandoned
+  };
+
+  struct Shared
+  {
+    std::promise<Result> itsResult;
+    std::atomic<int> itsState{Running};
+  };
+
+  auto shared = std::make_shared<Shared>();
+  auto result = shared->itsResult.get_future();
+  auto start = std::chrono::steady_clock::now();
+
+  // The executor destroys queued tasks at shutdown, which breaks the promise
+
+  auto task = [shared, theOverdueCalls, call = std::forward<Call>(theCall)]() mutable
+  {
+    if (shared->itsState != Abandoned)
+    {
+      try
+      {
+        shared->itsResult.set_value(call());
+      }
+      catch (...)
+      {
+        shared->itsResult.set_exception(std::current_exception());
+      }
+    }
+
+    if (shared->itsState.exchange(Completed) == Abandoned)
+      (*theOverdueCalls)--;
+  };
+
+  if (!theExecutor.submit(std::move(task)))
+    throw DeadlineExceeded("Database busy, too many queries waiting for a database connection");
+
+  if (result.wait_for(std::chrono::seconds(theDeadline)) == std::future_status::ready)
+    return result.get();
+
+  // Counted before abandoning so that the thread never decrements first
+
+  (*theOverdueCalls)++;
+
+  if (shared->itsState.exchange(Abandoned) == Completed)
+  {
+    (*theOverdueCalls)--;
+    return result.get();
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  throw DeadlineExceeded("Query deadline of " + Fmi::to_string(theDeadline) +
+                         " seconds exceeded, waited " + Fmi::to_string(elapsed.count()) +
+                         " ms for the database");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run a query task by the query executor and wait for its result
+ *
+ *        Tasks are run by priority; the calling thread waits, so errors are
+ *        thrown to the caller as if the task was run directly. Without an
+ *        executor, and for operational queries when their queue is full, the
+ *        task is run by the calling thread. Bulk queries are rejected when
+ *        their queue is full
+ */
+// ----------------------------------------------------------------------
+
+template <typename Task>
+auto runScheduled(QueryExecutor *theExecutor, bool theBulk, Task &&theTask) -> decltype(theTask())
+{
+  using Result = decltype(theTask());
+
+  if (!theExecutor)
+    return theTask();
+
+  // The executor destroys queued tasks at shutdown, which breaks the promise
+
+  auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(theTask));
+  auto result = task->get_future();
+
+  auto priority = (theBulk ? QueryExecutor::Priority::Bulk : QueryExecutor::Priority::Operational);
+
+  if (!theExecutor->submit([task]() { (*task)(); }, priority))
+  {
+    if (theBulk)
+      throw QueueFull("Too many bulk queries queued, try again later");
+
+    (*task)();
+  }
+
+  return result.get();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a failed query was rejected for an unknown location
+ *
+ *        Database errors, timeouts etc. must not cause the locations of the
+ *        query to be checked, the message of the error or of one of the
+ *        errors it wraps must refer to a missing location
+ */
+// ----------------------------------------------------------------------
+
+bool isLocationError(const std::exception_ptr &theError)
+{
+  auto isLocationMessage = [](std::string message)
+  {
+    boost::algorithm::to_lower(message);
+
+    bool missing = ((message.find("unknown") != std::string::npos) ||
+                    (message.find("not found") != std::string::npos) ||
+                    (message.find("no such") != std::string::npos));
+
+    return (missing && ((message.find("location") != std::string::npos) ||
+                        (message.find("icao") != std::string::npos) ||
+                        (message.find("place") != std::string::npos) ||
+                        (message.find("station") != std::string::npos)));
+  };
+
+  try
+  {
+    std::rethrow_exception(theError);
+  }
+  catch (const Fmi::Exception &exception)
+  {
+    for (auto *e = &exception; e; e = e->getPrevException())
+      if (isLocationMessage(e->what()))
+        return true;
+  }
+  catch (const std::exception &exception)
+  {
+    return isLocationMessage(exception.what());
+  }
+  catch (...)
+  {
+  }
+
+  return false;
+}
+
+}  // anonymous namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remember unknown locations of a query failed for an unknown location
+ *
+ *        The icaos, places and station ids are resolved with one station
+ *        query. Icaos and station ids missing from the result are remembered;
+ *        places are remembered only if no station was found at all, since
+ *        the stations found can not be attributed to places. The check is
+ *        bounded by the query deadline, errors are thrown
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::checkUnknownLocations(const Query &query,
+                                   std::chrono::steady_clock::time_point theDeadline)
+{
+  const size_t maxLocations = 20;
+  const auto &locationOptions = query.itsQueryOptions.itsLocationOptions;
+
+  if ((locationOptions.itsIcaos.size() + locationOptions.itsPlaces.size() +
+       locationOptions.itsStationIds.size()) > maxLocations)
+    return;
+
+  SmartMet::Engine::Avi::QueryOptions options;
+  options.itsParameters = {"stationid", "icao"};
+  options.itsLocationOptions.itsIcaos = locationOptions.itsIcaos;
+  options.itsLocationOptions.itsPlaces = locationOptions.itsPlaces;
+  options.itsLocationOptions.itsStationIds = locationOptions.itsStationIds;
+
+  SmartMet::Engine::Avi::StationQueryData stationData;
+
+  if (query.itsDeadline == 0)
+    stationData = itsAviEngine->queryStations(options);
+  else
+  {
+    auto remaining = std::chrono::duration_cast<std::chrono::seconds>(
+                         theDeadline - std::chrono::steady_clock::now())
+                         .count();
+
+    if (remaining <= 0)
+      throw DeadlineExceeded("Query deadline exceeded while checking locations");
+
+    stationData = callWithDeadline([aviEngine = itsAviEngine, options]() mutable
+                                   { return aviEngine->queryStations(options); },
+                                   static_cast<unsigned int>(remaining),
+                                   *itsDeadlineExecutor,
+                                   itsOverdueQueries,
+                                   itsConfig->maxOverdueQueries());
+  }
+
+  std::set<std::string> knownIcaos;
+  std::set<SmartMet::Engine::Avi::StationIdType> knownStationIds(
+      stationData.itsStationIds.begin(), stationData.itsStationIds.end());
+
+  for (auto stationId : stationData.itsStationIds)
+  {
+    const auto &icaos = stationData.itsValues[stationId]["icao"];
+
+    if (!icaos.empty())
+      knownIcaos.insert(Fmi::ascii_toupper_copy(stringValue(icaos.front()).value_or("")));
+  }
+
+  for (const auto &icao : locationOptions.itsIcaos)
+    if (knownIcaos.find(Fmi::ascii_toupper_copy(icao)) == knownIcaos.end())
+      itsNegativeCache->addUnknownLocation(NegativeCache::icaoKey(icao));
+
+  for (auto stationId : locationOptions.itsStationIds)
+    if (knownStationIds.find(stationId) == knownStationIds.end())
+      itsNegativeCache->addUnknownLocation(NegativeCache::stationIdKey(stationId));
+
+  if (stationData.itsStationIds.empty())
+    for (const auto &place : locationOptions.itsPlaces)
+      itsNegativeCache->addUnknownLocation(NegativeCache::placeKey(place));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Perform an avi query
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::query(const SmartMet::Spine::HTTP::Request &theRequest,
+                   SmartMet::Spine::HTTP::Response &theResponse)
+{
+  try
+  {
+    // Options can also be given in POST request body to avoid url length limits
+
+    std::optional<SmartMet::Spine::HTTP::Request> postRequest;
+
+    if ((theRequest.getMethod() == HTTP::RequestMethod::POST) && !theRequest.getContent().empty())
+      postRequest = requestWithBody(theRequest);
+
+    const auto &request = (postRequest ? *postRequest : theRequest);
+
+    // Parse query options
+
+    const auto &group = itsConfig->getQueryLimitsGroup(
+        itsAuthEngine.get(),
+        SmartMet::Spine::optional_string(SmartMet::Spine::FmiApiKey::getFmiApiKey(request), ""));
+
+    Query query = parseQuery(request, group);
+
+    // With query scheduling enabled, database queries and output formatting are run by the
+    // query executor by priority while this thread waits for them
+
+    auto *executor = itsQueryExecutor.get();
+
+    // Newline delimited JSON rows, GeoJSON features and Arrow record batches are formatted while
+    // the response is sent
+
+    if (isChunkedFormat(query.itsFormat) && !query.itsDigest)
+    {
+      auto result = std::make_unique<QueryResult>();
+      RequestArena arena;
+      runScheduled(executor, query.itsBulk, [&]() { fetch(query, request, *result, arena); });
+
+      theResponse.setContent(std::make_shared<ResultStream>(std::move(result), query));
+      theResponse.setHeader("Content-type", outputMimeType(query.itsFormat));
+
+      if (query.itsCursor)
+        theResponse.setHeader("X-Avi-Cursor", query.itsCursor->str());
+      theResponse.setHeader("Access-Control-Allow-Origin", "*");
+      return;
+    }
+
+    // Query and format the output
+
+    string mime;
+    RequestArena arena;
+    auto out = runScheduled(executor,
+                            query.itsBulk,
+                            [&]() { return execute(query, request, mime, arena); });
+
+    // Digest of the whole response for change detection
+
+    if (query.itsDigest)
+      theResponse.setHeader("X-Avi-Digest", hexString(hash64(out)));
+
+    auto encoding = responseEncoding(request, out.size());
+
+    if (encoding == Compression::Encoding::Identity)
+      theResponse.setContent(out);
+    else
+      theResponse.setContent(Compression::compress(out, encoding, itsDictionary.get()));
+
+    setEncodingHeaders(theResponse, encoding);
+
+    theResponse.setHeader("Content-type", mime);
+
+    if (query.itsCursor)
+      theResponse.setHeader("X-Avi-Cursor", query.itsCursor->str());
+    theResponse.setHeader("Access-Control-Allow-Origin", "*");
+  }
+  catch (const DeadlineExceeded &)
+  {
+    throw;
+  }
+  catch (const QueueFull &)
+  {
+    throw;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse query options using the limits of the apikey group
+ *
+ *        Parsed queries are cached by apikey group and query string; a copy
+ *        is returned since query execution modifies the options
+ */
+// ----------------------------------------------------------------------
+
+Query Plugin::parseQuery(const SmartMet::Spine::HTTP::Request &theRequest,
+                         const std::string &theGroup)
+{
+  try
+  {
+    const auto &queryLimits = itsConfig->getGroupQueryLimits(theGroup);
+
+    if (!itsQueryCache || !isCacheableQuery(theRequest))
+      return Query(theRequest, queryLimits, itsConfig);
+
+    auto key = theGroup + '\n' + requestFingerprint(theRequest);
+    auto cached = itsQueryCache->find(key);
+
+    if (cached)
+      return **cached;
+
+    auto query = std::make_shared<const Query>(theRequest, queryLimits, itsConfig);
+    itsQueryCache->insert(key, query);
+
+    return *query;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check the parsed query before querying
+ *
+ *        Errors detected without querying the database
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::validate(const Query &query) const
+{
+  try
+  {
+    if ((query.itsQueryOptions.itsValidity == Engine::Avi::Validity::Rejected) &&
+        !query.itsQueryOptions.itsTimeOptions.itsObservationTime.empty())
+      throw Fmi::Exception(BCP, "Time range must be used to query rejected messages");
+
+    // Unknown locations are answered without querying
+
+    if (itsNegativeCache && !query.itsCursor && isCurrentTimeQuery(query))
+    {
+      auto unknownLocation =
+          itsNegativeCache->findUnknownLocation(query.itsQueryOptions.itsLocationOptions);
+
+      if (unknownLocation)
+        throw Fmi::Exception(BCP, "Unknown location: " + *unknownLocation);
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Query the result of parsed query
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::fetch(Query &query,
+                   const SmartMet::Spine::HTTP::Request &theRequest,
+                   QueryResult &theResult,
+                   RequestArena &theArena)
+{
+  try
+  {
+    validate(query);
+
+    // Resolve bbox, coordinate and wkt locations to station ids using the station index
+
+    StationIndex::StationIdListPtr indexedStationIds;
+    bool isRoute = false;
+
+    if (useStationIndex(query))
+    {
+      auto stationIndex = getStationIndex();
+
+      if (stationIndex)
+        indexedStationIds = stationIndex->resolve(query.itsQueryOptions.itsLocationOptions);
+
+      if (indexedStationIds)
+      {
+        auto &locationOptions = query.itsQueryOptions.itsLocationOptions;
+
+        isRoute = StationIndex::isRoute(locationOptions);
+
+        locationOptions.itsBBoxes.clear();
+        locationOptions.itsLonLats.clear();
+        locationOptions.itsWKTs.itsWKTs.clear();
+        locationOptions.itsMaxDistance = 0;
+        locationOptions.itsStationIds = *indexedStationIds;
+      }
+    }
+
+    // Queries known to return no rows are answered without querying
+
+    std::string fingerprint;
+    bool noRows = (indexedStationIds && indexedStationIds->empty());
+
+    // Incremental query results change as messages arrive, they are not cached
+
+    if (itsNegativeCache && !query.itsCursor)
+    {
+      fingerprint = requestFingerprint(theRequest);
+      noRows = (noRows || itsNegativeCache->isEmptyResult(fingerprint));
+    }
+
+    // Query
+
+    auto &stationData = theResult.itsStationData;
+    auto &rejectedMessageData = theResult.itsRejectedData;
+
+    if (!noRows)
+    {
+      auto queryStart = std::chrono::steady_clock::now();
+
+      try
+      {
+        // With a deadline the engine call runs in a separate thread with its own copy
+        // of the options
+
+        auto queryEngine = [&](auto engineCall)
+        {
+          if (query.itsDeadline == 0)
+            return engineCall(*itsAviEngine, query.itsQueryOptions);
+
+          return callWithDeadline(
+              [aviEngine = itsAviEngine, options = query.itsQueryOptions, engineCall]() mutable
+              { return engineCall(*aviEngine, options); },
+              query.itsDeadline,
+              *itsDeadlineExecutor,
+              itsOverdueQueries,
+              itsConfig->maxOverdueQueries());
+        };
+
+        if (query.itsQueryOptions.itsValidity == Engine::Avi::Validity::Accepted)
+        {
+          stationData = queryEngine(
+              [](SmartMet::Engine::Avi::Engine &engine,
+                 SmartMet::Engine::Avi::QueryOptions &options)
+              { return engine.queryStationsAndMessages(options); });
+
+          if (isRoute)
+            setStationOrder(stationData, *indexedStationIds);
+
+          if (query.itsCursor)
+          {
+            query.itsCursor = query.itsCursor->filter(stationData, &theArena);
+            removeColumns(stationData, query.itsCursorColumns);
+          }
+
+          if (query.itsMessageFilter)
+            query.itsMessageFilter->apply(stationData);
+
+          if (query.itsRowSelection)
+            query.itsRowSelection->apply(stationData, &theArena);
+
+          removeColumns(stationData, query.itsSelectionColumns);
+
+          if (query.itsDigest)
+            digestMessages(stationData);
+
+          if (query.itsAggregation)
+            query.itsAggregation->apply(stationData, &theArena);
+        }
+        else
+        {
+          rejectedMessageData = queryEngine(
+              [](SmartMet::Engine::Avi::Engine &engine,
+                 SmartMet::Engine::Avi::QueryOptions &options)
+              { return engine.queryRejectedMessages(options); });
+
+          if (query.itsMessageFilter)
+          {
+            query.itsMessageFilter->apply(rejectedMessageData);
+            removeColumns(rejectedMessageData, query.itsSelectionColumns);
+          }
+
+          if (query.itsAggregation)
+            query.itsAggregation->apply(rejectedMessageData, &theArena);
+        }
+      }
+      catch (const DeadlineExceeded &)
+      {
+        throw;
+      }
+      catch (...)
+      {
+        // The original error is reported even if checking the locations fails
+
+        if (itsNegativeCache && isCurrentTimeQuery(query) &&
+            isLocationError(std::current_exception()))
+        {
+          try
+          {
+            checkUnknownLocations(query, queryStart + std::chrono::seconds(query.itsDeadline));
+          }
+          catch (...)
+          {
+          }
+        }
+
+        throw;
+      }
+
+      if (itsNegativeCache && !query.itsCursor &&
+          (((query.itsQueryOptions.itsValidity == Engine::Avi::Validity::Accepted)
+                ? rowCount(stationData)
+                : rowCount(rejectedMessageData)) == 0))
+        itsNegativeCache->addEmptyResult(fingerprint);
+    }
+
+    theResult.itsNoRows = noRows;
+  }
+  catch (const DeadlineExceeded &)
+  {
+    throw;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Execute parsed query and return formatted output
+ */
+// ----------------------------------------------------------------------
+
+std::string Plugin::execute(Query &query,
+                            const SmartMet::Spine::HTTP::Request &theRequest,
+                            std::string &theMimeType,
+                            RequestArena &theArena)
+{
+  try
+  {
+    QueryResult result;
+    fetch(query, theRequest, result, theArena);
+
+    auto &stationData = result.itsStationData;
+    auto &rejectedMessageData = result.itsRejectedData;
+    bool noRows = result.itsNoRows;
+
+    // Set column headers
+
+    TableFormatter::Names headers;
+
+    if (noRows)
+      setColumnHeaders(headers, query);
+    else
+      setColumnHeaders(headers,
+                       (query.itsQueryOptions.itsValidity == Engine::Avi::Validity::Accepted)
+                           ? stationData.itsColumns
+                           : rejectedMessageData.itsColumns);
+
+    ResultBudget budget(query.itsMaxResultBytes);
+
+    // Newline delimited JSON, GeoJSON and Arrow are written directly from the result columns
+
+    if (isChunkedFormat(query.itsFormat))
+    {
+      std::string out;
+      resultWriter(query, result, theArena, budget)
+          ->write(out, std::numeric_limits<std::size_t>::max());
+
+      ResultBudget::check(out.size(), query.itsMaxResultBytes);
+
+      theMimeType = outputMimeType(query.itsFormat);
+
+      return out;
+    }
+
+    // Column-oriented and station-grouped JSON do not repeat the column names in every row
+
+    if ((query.itsFormat == "json") && (query.itsLayout != "rows"))
+    {
+      auto out = formatJsonLayout(query, result, theArena, budget);
+
+      ResultBudget::check(out.size(), query.itsMaxResultBytes);
+
+      theMimeType = "application/json; charset=UTF-8";
+
+      return out;
+    }
+
+    // Set column precisions
+
+    vector<int> precisions;
+
+    setPrecisions(headers.size(), query, precisions);
+
+    // Get formatter and timezone for time columns
+
+    auto timeZonePtr = outputTimeZone(query);
+
+    auto timeFormatter = outputTimeFormatter(query);
+
+    // Fill table. Result size is checked while filling to fail before formatting
+
+    Table table;
+    Fmi::ValueFormatterParam opt;
+    Fmi::ValueFormatter valueFormatter(opt);
+    TimeSeries::TableFeeder tf(table, valueFormatter, precisions, timeFormatter, timeZonePtr);
+
+    int columnNumber = 0;
+
+    if (query.itsQueryOptions.itsValidity == Engine::Avi::Validity::Accepted)
+    {
+      auto values = columnValues(stationData, theArena);
+      auto cell = values.begin();
+      std::size_t nStations = stationData.itsStationIds.size();
+
+      for (const auto &column : stationData.itsColumns)
+      {
+        tf.setCurrentRow(0);
+        tf.setCurrentColumn(columnNumber);
+
+        if (column.itsType == SmartMet::Engine::Avi::ColumnType::TS_LatLon)
+          tf << TimeSeries::LonLatFormat::LATLON;
+        else if (column.itsType == SmartMet::Engine::Avi::ColumnType::TS_LonLat)
+          tf << TimeSeries::LonLatFormat::LONLAT;
+
+        for (std::size_t n = 0; (n < nStations); n++, cell++)
+        {
+          budget.add(**cell);
+          tf << **cell;
+        }
+
+        columnNumber++;
+      }
+    }
+    else
+    {
+      for (const auto &column : rejectedMessageData.itsColumns)
+      {
+        tf.setCurrentRow(0);
+        tf.setCurrentColumn(columnNumber);
+
+        if (column.itsType == SmartMet::Engine::Avi::ColumnType::TS_LatLon)
+          tf << TimeSeries::LonLatFormat::LATLON;
+        else if (column.itsType == SmartMet::Engine::Avi::ColumnType::TS_LonLat)
+          tf << TimeSeries::LonLatFormat::LONLAT;
+
+        const auto &values = rejectedMessageData.itsValues[column.itsName];
+
+        budget.add(values);
+        tf << values;
+
+        columnNumber++;
+      }
+    }
+
+    // Formatted output
+
+    std::shared_ptr<TableFormatter> formatter(TableFormatterFactory::create(query.itsFormat));
+    auto out = formatter->format(table, headers, theRequest, itsConfig->tableFormatterOptions());
+
+    ResultBudget::check(out.size(), query.itsMaxResultBytes);
+
+    theMimeType = formatter->mimetype() + "; charset=UTF-8";
+
+    return out;
+  }
+  catch (const DeadlineExceeded &)
+  {
+    throw;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Content encoding of response of given size
+ *
+ *        The dictionary is used also for responses smaller than the minimum
+ *        size, since it is intended for short messages. Clients not able to
+ *        send Accept-Encoding can request it with option compression=zstd-dict
+ */
+// ----------------------------------------------------------------------
+
+Compression::Encoding Plugin::responseEncoding(const SmartMet::Spine::HTTP::Request &theRequest,
+                                               std::size_t theSize) const
+{
+  try
+  {
+    if (!itsConfig->useCompression())
+      return Compression::Encoding::Identity;
+
+    auto option = theRequest.getParameter("compression");
+
+    if (itsDictionary && option &&
+        (*option == Compression::name(Compression::Encoding::ZstdDictionary)))
+      return Compression::Encoding::ZstdDictionary;
+
+    auto acceptEncoding = theRequest.getHeader("Accept-Encoding");
+
+    if (!acceptEncoding)
+      return Compression::Encoding::Identity;
+
+    auto encodings = itsConfig->compressionEncodings();
+    encodings[Compression::index(Compression::Encoding::ZstdDictionary)] = !!itsDictionary;
+
+    auto encoding = Compression::negotiate(*acceptEncoding, encodings);
+
+    if ((encoding != Compression::Encoding::ZstdDictionary) &&
+        (theSize < itsConfig->compressionMinSize()))
+      return Compression::Encoding::Identity;
+
+    return encoding;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set Content-Encoding and related headers
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::setEncodingHeaders(SmartMet::Spine::HTTP::Response &theResponse,
+                                Compression::Encoding theEncoding) const
+{
+  if (!itsConfig->useCompression())
+    return;
+
+  theResponse.setHeader("Vary", "Accept-Encoding");
+
+  if (theEncoding == Compression::Encoding::Identity)
+    return;
+
+  theResponse.setHeader("Content-Encoding", std::string(Compression::name(theEncoding)));
+
+  if (theEncoding == Compression::Encoding::ZstdDictionary)
+    theResponse.setHeader("X-Avi-Zstd-Dictionary", Fmi::to_string(itsDictionary->id()));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main content handler
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::requestHandler(Reactor & /* theReactor */,
+                            const SmartMet::Spine::HTTP::Request &theRequest,
+                            SmartMet::Spine::HTTP::Response &theResponse)
+{
+  try
+  {
+    bool isdebug =
+        (SmartMet::Spine::optional_string(theRequest.getParameter("format"), "") == "debug");
+
+    try
+    {
+      const int expires_seconds = 60;
+      Fmi::DateTime t_now = Fmi::SecondClock::universal_time();
+
+      query(theRequest, theResponse);
+      theResponse.setStatus(HTTP::Status::ok);
+
+      // Build cache expiration time info
+
+      Fmi::DateTime t_expires = t_now + Fmi::Seconds(expires_seconds);
+
+      // The headers themselves
+
+      std::shared_ptr<Fmi::TimeFormatter> tformat(Fmi::TimeFormatter::create("http"));
+
+      std::string cachecontrol = "public, max-age=" + Fmi::to_string(expires_seconds);
+      std::string expiration = tformat->format(t_expires);
+      std::string modification = tformat->format(t_now);
+
+      theResponse.setHeader("Cache-Control", cachecontrol);
+      theResponse.setHeader("Expires", expiration);
+      theResponse.setHeader("Last-Modified", modification);
+    }
+    catch (const DeadlineExceeded &)
+    {
+      reportError(theRequest, theResponse, isdebug);
+
+      if (!isdebug)
+        theResponse.setStatus(HTTP::Status::gateway_timeout);
+    }
+    catch (const QueueFull &)
+    {
+      reportError(theRequest, theResponse, isdebug);
+
+      if (!isdebug)
+        theResponse.setStatus(HTTP::Status::service_unavailable);
+    }
+    catch (...)
+    {
+      reportError(theRequest, theResponse, isdebug);
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Plugin constructor
+ */
+// ----------------------------------------------------------------------
+
+Plugin::Plugin(Reactor *theReactor, const char *theConfigFileName)
+    : itsModuleName("Avi"), itsConfigFileName(theConfigFileName), itsReactor(theReactor)
+{
+  try
+  {
+    if (theReactor->getRequiredAPIVersion() != SMARTMET_API_VERSION)
+    {
+      std::cerr << "*** AviPlugin and Server SmartMet API version mismatch ***\n";
+      return;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Render latest message response for given station, type and format
+ */
+// ----------------------------------------------------------------------
+
+LatestCache::RenditionPtr Plugin::renderLatest(const LatestCache::Key &theKey)
+{
+  try
+  {
+    // The response is produced as for corresponding query string request
+
+    SmartMet::Spine::HTTP::Request request;
+    request.setParameter("icao", std::string(theKey.icao()));
+    request.setParameter("messagetype", std::string(theKey.type()));
+    request.setParameter("param", itsConfig->latestParameters());
+    request.setParameter("format", std::string(theKey.format()));
+
+    Query query(request, itsAuthEngine.get(), itsConfig);
+
+    auto rendition = std::make_shared<LatestCache::Rendition>();
+
+    RequestArena arena;
+    rendition->itsContent = execute(query, request, rendition->itsMimeType, arena);
+    rendition->setETag("\"" + hexString(hash64(rendition->itsContent)) + "\"");
+
+    std::shared_ptr<Fmi::TimeFormatter> tformat(Fmi::TimeFormatter::create("http"));
+    auto now = Fmi::SecondClock::universal_time();
+    auto maxAge = itsLatestCache->maxAge().count();
+
+    rendition->itsLastModified = tformat->format(now);
+    rendition->itsExpiresHeader = tformat->format(now + Fmi::Seconds(maxAge));
+    rendition->itsExpires = std::chrono::steady_clock::now() + itsLatestCache->maxAge();
+
+    return rendition;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Path style latest message request handler
+ *
+ *        Serves pre-rendered responses; the rendition is created on first
+ *        request (concurrent requests wait for it) and dropped when a new
+ *        message arrives for the station
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::latestRequestHandler(Reactor & /* theReactor */,
+                                  const SmartMet::Spine::HTTP::Request &theRequest,
+                                  SmartMet::Spine::HTTP::Response &theResponse)
+{
+  try
+  {
+    try
+    {
+      auto key = latestKey(theRequest.getResource());
+
+      if (!itsLatestCache || !key.valid())
+      {
+        theResponse.setStatus(HTTP::Status::not_found);
+        return;
+      }
+
+      auto rendition = itsLatestCache->findOrRender(key, [&] { return renderLatest(key); });
+
+      // Compressed variants are cached with the rendition and have their own entity tags.
+      // The rendition's expiration time is sent instead of a max-age computed per request
+
+      auto encoding = responseEncoding(theRequest, rendition->itsContent.size());
+      const auto &etag = rendition->etag(encoding);
+
+      setEncodingHeaders(theResponse, encoding);
+
+      theResponse.setHeader("ETag", etag);
+      theResponse.setHeader("Last-Modified", rendition->itsLastModified);
+      theResponse.setHeader("Expires", rendition->itsExpiresHeader);
+      theResponse.setHeader("Cache-Control", "public");
+      theResponse.setHeader("Access-Control-Allow-Origin", "*");
+
+      auto ifNoneMatch = theRequest.getHeader("If-None-Match");
+
+      if (ifNoneMatch && LatestCache::matches(*ifNoneMatch, etag))
+      {
+        theResponse.setStatus(HTTP::Status::not_modified);
+        return;
+      }
+
+      theResponse.setContent(rendition->content(encoding, itsDictionary.get()));
+      theResponse.setHeader("Content-type", rendition->itsMimeType);
+      theResponse.setStatus(HTTP::Status::ok);
+    }
+    catch (...)
+    {
+      reportError(theRequest, theResponse, false);
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse subscription filter
+ *
+ *        Icao and station id locations are matched as such, bbox, coordinate
+ *        and wkt locations are resolved to station ids with the station index
+ */
+// ----------------------------------------------------------------------
+
+SubscriptionHub::Filter Plugin::subscriptionFilter(
+    const SmartMet::Spine::HTTP::Request &theRequest)
+{
+  try
+  {
+    // Location and message type options are parsed as for a query
+
+    auto request = theRequest;
+
+    if (!request.getParameter("param"))
+      request.setParameter("param", "icao");
+
+    Query query(request, itsAuthEngine.get(), itsConfig);
+
+    SubscriptionHub::Filter filter;
+    auto locationOptions = query.itsQueryOptions.itsLocationOptions;
+
+    if (!locationOptions.itsPlaces.empty() || !locationOptions.itsCountries.empty())
+      throw Fmi::Exception(BCP, "Place and country locations can not be used with subscriptions");
+
+    for (const auto &icao : locationOptions.itsIcaos)
+      filter.itsIcaos.insert(Fmi::ascii_toupper_copy(icao));
+
+    filter.itsStationIds.insert(locationOptions.itsStationIds.begin(),
+                                locationOptions.itsStationIds.end());
+
+    locationOptions.itsIcaos.clear();
+    locationOptions.itsStationIds.clear();
+
+    if (StationIndex::resolvable(locationOptions))
+    {
+      auto stationIndex = getStationIndex();
+      auto stationIds = (stationIndex ? stationIndex->resolve(locationOptions) : nullptr);
+
+      if (!stationIds)
+        throw Fmi::Exception(BCP, "Location can not be used with subscriptions");
+
+      // A location without stations must not match all messages
+
+      if (stationIds->empty())
+        filter.itsStationIds.insert(0);
+
+      filter.itsStationIds.insert(stationIds->begin(), stationIds->end());
+    }
+
+    filter.itsMessageTypes.insert(query.itsQueryOptions.itsMessageTypes.begin(),
+                                  query.itsQueryOptions.itsMessageTypes.end());
+    filter.itsMessageFilter = query.itsMessageFilter;
+
+    return filter;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Server-Sent Events subscription request handler
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::subscriptionRequestHandler(Reactor & /* theReactor */,
+                                        const SmartMet::Spine::HTTP::Request &theRequest,
+                                        SmartMet::Spine::HTTP::Response &theResponse)
 {
   try
   {
-    for (const auto &column : columns)
-      headers.push_back(column.itsName);
+    try
+    {
+      if (!itsSubscriptionHub)
+      {
+        theResponse.setStatus(HTTP::Status::not_found);
+        return;
+      }
+
+      auto filter = subscriptionFilter(theRequest);
+
+      // Reconnecting client continues from the last event received
+
+      std::optional<std::uint64_t> lastEventId;
+      auto header = theRequest.getHeader("Last-Event-ID");
+
+      if (header)
+        lastEventId = std::stoull(*header);
+
+      auto stream = itsSubscriptionHub->subscribe(std::move(filter), lastEventId);
+
+      if (!stream)
+      {
+        theResponse.setStatus(HTTP::Status::service_unavailable);
+        theResponse.setHeader("X-Avi-Error", "Too many subscribers");
+        return;
+      }
+
+      theResponse.setHeader("Content-type", "text/event-stream; charset=UTF-8");
+      theResponse.setHeader("Cache-Control", "no-cache");
+      theResponse.setHeader("X-Accel-Buffering", "no");
+      theResponse.setHeader("Access-Control-Allow-Origin", "*");
+      theResponse.setContent(stream);
+      theResponse.setStatus(HTTP::Status::ok);
+    }
+    catch (...)
+    {
+      reportError(theRequest, theResponse, false);
+    }
   }
   catch (...)
   {
@@ -51,16 +2044,122 @@ void setColumnHeaders(TableFormatter::Names &headers, const SmartMet::Engine::Av
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Set column precision
+ * \brief Batch query request handler
+ *
+ *        The queries are executed concurrently using query limits of the
+ *        request's apikey. Each result is returned as a part of a
+ *        multipart/mixed response in query order; failed queries have
+ *        their error message as content and 'X-Avi-Error' part header
  */
 // ----------------------------------------------------------------------
 
-void setPrecisions(size_t nColumns, const Query &query, vector<int> &precisions)
+void Plugin::batchRequestHandler(Reactor & /* theReactor */,
+                                 const SmartMet::Spine::HTTP::Request &theRequest,
+                                 SmartMet::Spine::HTTP::Response &theResponse)
 {
   try
   {
-    for (size_t n = 0; (n < nColumns); n++)
-      precisions.push_back(query.itsPrecision);
+    try
+    {
+      if (theRequest.getMethod() != HTTP::RequestMethod::POST)
+      {
+        theResponse.setStatus(HTTP::Status::method_not_allowed);
+        return;
+      }
+
+      auto requests = batchRequests(theRequest.getContent());
+
+      if (requests.empty())
+        throw Fmi::Exception(BCP, "Batch request contains no queries");
+
+      if (requests.size() > itsConfig->maxBatchQueries())
+        throw Fmi::Exception(BCP,
+                             "Too many queries in batch request, maximum is " +
+                                 Fmi::to_string(itsConfig->maxBatchQueries()));
+
+      // Query limits group is resolved once for all queries
+
+      const auto &group = itsConfig->getQueryLimitsGroup(
+          itsAuthEngine.get(),
+          SmartMet::Spine::optional_string(SmartMet::Spine::FmiApiKey::getFmiApiKey(theRequest),
+                                           ""));
+
+      struct Result
+      {
+        std::string itsContent;
+        std::string itsMimeType;
+        std::string itsError;
+      };
+
+      std::vector<Result> results(requests.size());
+      std::atomic<std::size_t> nextQuery{0};
+
+      auto worker = [&]()
+      {
+        for (std::size_t i = nextQuery++; (i < requests.size()); i = nextQuery++)
+        {
+          try
+          {
+            Query query = parseQuery(requests[i], group);
+            RequestArena arena;
+            results[i].itsContent = execute(query, requests[i], results[i].itsMimeType, arena);
+          }
+          catch (...)
+          {
+            Fmi::Exception exception(BCP, "Batch query failed!", nullptr);
+            exception.addParameter("URI", theRequest.getURI());
+            exception.addParameter("Query", Fmi::to_string(i));
+            exception.printError();
+
+            results[i].itsError = exception.what();
+            boost::algorithm::replace_all(results[i].itsError, "\n", " ");
+          }
+        }
+      };
+
+      auto nWorkers = std::min<std::size_t>(itsConfig->batchConcurrency(), requests.size());
+      std::vector<std::future<void>> workers;
+
+      for (std::size_t i = 1; (i < nWorkers); i++)
+        workers.push_back(std::async(std::launch::async, worker));
+
+      worker();
+
+      for (auto &w : workers)
+        w.get();
+
+      // Multipart response
+
+      std::string boundary = "avi-batch-" + hexString(hash64(theRequest.getContent()));
+      std::string out;
+
+      for (std::size_t i = 0; (i < results.size()); i++)
+      {
+        const auto &result = results[i];
+
+        out += "--" + boundary + "\r\n";
+        out += "X-Avi-Query: " + Fmi::to_string(i) + "\r\n";
+
+        if (result.itsError.empty())
+          out += "Content-Type: " + result.itsMimeType + "\r\n\r\n" + result.itsContent;
+        else
+          out += "Content-Type: text/plain; charset=UTF-8\r\nX-Avi-Error: " +
+                 result.itsError.substr(0, 300) + "\r\n\r\n" + result.itsError;
+
+        out += "\r\n";
+      }
+
+      out += "--" + boundary + "--\r\n";
+
+      theResponse.setContent(out);
+      theResponse.setHeader("Content-type", "multipart/mixed; boundary=" + boundary);
+      theResponse.setHeader("Access-Control-Allow-Origin", "*");
+      theResponse.setStatus(HTTP::Status::ok);
+    }
+    catch (...)
+    {
+      reportError(theRequest, theResponse, false);
+    }
   }
   catch (...)
   {
@@ -68,120 +2167,148 @@ void setPrecisions(size_t nColumns, const Query &query, vector<int> &precisions)
   }
 }
 
-}  // anonymous namespace
+// ----------------------------------------------------------------------
+/*!
+ * \brief Destructor
+ */
+// ----------------------------------------------------------------------
+
+Plugin::~Plugin()
+{
+  stopBackgroundTasks();
+}
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Perform an avi query
+ * \brief Plugin initialization
  */
 // ----------------------------------------------------------------------
 
-void Plugin::query(const SmartMet::Spine::HTTP::Request &theRequest,
-                   SmartMet::Spine::HTTP::Response &theResponse)
+void Plugin::init()
 {
+  using namespace boost::placeholders;
+
   try
   {
-    // Parse query options
+    /* AviEngine */
 
-    Query query(theRequest, itsAuthEngine.get(), itsConfig);
+    itsAviEngine = itsReactor->getEngine<SmartMet::Engine::Avi::Engine>("Avi", nullptr);
 
-    // Query
+    itsConfig.reset(new Config(itsConfigFileName));
 
-    SmartMet::Engine::Avi::StationQueryData stationData;
-    SmartMet::Engine::Avi::QueryData rejectedMessageData;
+    /* AuthenticationEngine */
 
-    if (query.itsQueryOptions.itsValidity == Engine::Avi::Validity::Accepted)
-      stationData = itsAviEngine->queryStationsAndMessages(query.itsQueryOptions);
-    else
+    if (itsConfig->useAuthentication())
     {
-      if (!query.itsQueryOptions.itsTimeOptions.itsObservationTime.empty())
-        throw Fmi::Exception(BCP, "Time range must be used to query rejected messages");
+      itsAuthEngine = itsReactor->getEngine<SmartMet::Engine::Authentication::Engine>(
+          "Authentication", nullptr);
 
-      rejectedMessageData = itsAviEngine->queryRejectedMessages(query.itsQueryOptions);
+      if (!itsAuthEngine->isEnabled())
+        throw Fmi::Exception(BCP, "Authentication engine is disabled");
     }
 
-    // Set column headers
+    if (!(itsReactor->addContentHandler(
+            this, "/avi", boost::bind(&Plugin::callRequestHandler, this, _1, _2, _3))))
+      throw Fmi::Exception(BCP, "Failed to register avidb content handler");
 
-    TableFormatter::Names headers;
+    /* Dictionary for small TAC responses */
 
-    setColumnHeaders(headers,
-                     (query.itsQueryOptions.itsValidity == Engine::Avi::Validity::Accepted)
-                         ? stationData.itsColumns
-                         : rejectedMessageData.itsColumns);
+    if (itsConfig->useCompression() && !itsConfig->compressionDictionary().empty())
+      itsDictionary =
+          std::make_unique<Compression::Dictionary>(itsConfig->compressionDictionary());
 
-    // Set column precisions
+    /* Batch queries */
 
-    vector<int> precisions;
+    if (itsConfig->useBatchQueries())
+    {
+      if (!(itsReactor->addContentHandler(
+              this, "/avi/batch", boost::bind(&Plugin::batchRequestHandler, this, _1, _2, _3))))
+        throw Fmi::Exception(BCP, "Failed to register avidb batch content handler");
+    }
 
-    setPrecisions(headers.size(), query, precisions);
+    /* Pre-rendered path style latest message responses */
 
-    // Get formatter and timezone for time columns
+    if (itsConfig->useLatestCache())
+    {
+      itsLatestCache = std::make_unique<LatestCache>(itsConfig->latestCacheSize(),
+                                                     itsConfig->latestCacheMaxAge());
+
+      if (!(itsReactor->addContentHandler(
+              this,
+              "/avi/latest",
+              boost::bind(&Plugin::latestRequestHandler, this, _1, _2, _3),
+              true)))
+        throw Fmi::Exception(BCP, "Failed to register avidb latest message content handler");
+    }
 
-    std::optional<Fmi::TimeZonePtr> timeZonePtr;
+    /* Parsed query cache */
 
-    if ((!query.itsQueryOptions.itsTimeOptions.itsTimeZone.empty()) &&
-        (query.itsQueryOptions.itsTimeOptions.itsTimeZone != "utc"))
-      timeZonePtr = Fmi::TimeZoneFactory::instance().time_zone_from_string(
-          query.itsQueryOptions.itsTimeOptions.itsTimeZone);
+    if (itsConfig->useQueryCache())
+      itsQueryCache = std::make_unique<QueryCache>(itsConfig->queryCacheSize());
 
-    std::shared_ptr<Fmi::TimeFormatter> timeFormatter(
-        Fmi::TimeFormatter::create(query.itsQueryOptions.itsTimeOptions.itsTimeFormat));
+    /* Executor running queries by priority */
 
-    // Fill table
+    if (itsConfig->useScheduler())
+      itsQueryExecutor = std::make_unique<QueryExecutor>(itsConfig->schedulerThreads(),
+                                                         itsConfig->schedulerMaxQueued(),
+                                                         itsConfig->schedulerBulkThreads(),
+                                                         itsConfig->schedulerBulkMaxQueued());
 
-    Table table;
-    Fmi::ValueFormatterParam opt;
-    Fmi::ValueFormatter valueFormatter(opt);
-    TimeSeries::TableFeeder tf(table, valueFormatter, precisions, timeFormatter, timeZonePtr);
+    /* Executor for engine calls with a deadline. Bulk tasks are not used */
 
-    int columnNumber = 0;
+    if (itsConfig->useDeadlines())
+      itsDeadlineExecutor = std::make_unique<QueryExecutor>(
+          itsConfig->deadlineThreads(), itsConfig->deadlineMaxQueued(), 1, 0);
 
-    if (query.itsQueryOptions.itsValidity == Engine::Avi::Validity::Accepted)
-    {
-      for (const auto &column : stationData.itsColumns)
-      {
-        tf.setCurrentRow(0);
-        tf.setCurrentColumn(columnNumber);
+    /* Negative cache for unknown locations and empty results */
 
-        if (column.itsType == SmartMet::Engine::Avi::ColumnType::TS_LatLon)
-          tf << TimeSeries::LonLatFormat::LATLON;
-        else if (column.itsType == SmartMet::Engine::Avi::ColumnType::TS_LonLat)
-          tf << TimeSeries::LonLatFormat::LONLAT;
+    if (itsConfig->useNegativeCache())
+      itsNegativeCache = std::make_unique<NegativeCache>(itsConfig->negativeCacheSize(),
+                                                         itsConfig->emptyResultTTL());
 
-        for (auto stationId : stationData.itsStationIds)
-          tf << stationData.itsValues[stationId][column.itsName];
+    /* New message detection */
 
-        columnNumber++;
-      }
-    }
-    else
+    if (itsConfig->useMessageMonitor())
     {
-      for (const auto &column : rejectedMessageData.itsColumns)
-      {
-        tf.setCurrentRow(0);
-        tf.setCurrentColumn(columnNumber);
+      itsMessageMonitor =
+          std::make_unique<MessageMonitor>(itsAviEngine, itsConfig->messageMonitorLookback());
 
-        if (column.itsType == SmartMet::Engine::Avi::ColumnType::TS_LatLon)
-          tf << TimeSeries::LonLatFormat::LATLON;
-        else if (column.itsType == SmartMet::Engine::Avi::ColumnType::TS_LonLat)
-          tf << TimeSeries::LonLatFormat::LONLAT;
+      if (itsNegativeCache)
+        itsMessageMonitor->addListener([this](const MessageMonitor::Messages & /* messages */)
+                                       { itsNegativeCache->clearEmptyResults(); });
 
-        tf << rejectedMessageData.itsValues[column.itsName];
+      if (itsLatestCache)
+        itsMessageMonitor->addListener(
+            [this](const MessageMonitor::Messages &messages)
+            {
+              for (const auto &message : messages)
+                itsLatestCache->invalidate(message.itsIcao);
+            });
 
-        columnNumber++;
+      /* Server-Sent Events subscriptions fed by the monitor */
+
+      if (itsConfig->useSubscriptions())
+      {
+        itsSubscriptionHub = std::make_shared<SubscriptionHub>(itsConfig->subscriptionBufferSize(),
+                                                               itsConfig->subscriptionKeepAlive(),
+                                                               itsConfig->maxSubscribers());
+
+        itsMessageMonitor->fetchMessageContents();
+        itsMessageMonitor->addListener([this](const MessageMonitor::Messages &messages)
+                                       { itsSubscriptionHub->publish(messages); });
+
+        if (!(itsReactor->addContentHandler(
+                this,
+                "/avi/subscribe",
+                boost::bind(&Plugin::subscriptionRequestHandler, this, _1, _2, _3))))
+          throw Fmi::Exception(BCP, "Failed to register avidb subscription content handler");
       }
     }
 
-    // Formatted output
-
-    std::shared_ptr<TableFormatter> formatter(TableFormatterFactory::create(query.itsFormat));
-    auto out = formatter->format(table, headers, theRequest, itsConfig->tableFormatterOptions());
-
-    theResponse.setContent(out);
+    /* Periodic tasks */
 
-    string mime = formatter->mimetype() + "; charset=UTF-8";
-    theResponse.setHeader("Content-type", mime);
-    theResponse.setHeader("Access-Control-Allow-Origin", "*");
+    if (itsConfig->useStationIndex() || itsNegativeCache || itsMessageMonitor)
+      itsBackgroundThread = std::thread(&Plugin::backgroundTasks, this);
   }
   catch (...)
   {
@@ -191,135 +2318,127 @@ void Plugin::query(const SmartMet::Spine::HTTP::Request &theRequest,
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Main content handler
+ * \brief Shutdown the plugin
  */
 // ----------------------------------------------------------------------
 
-void Plugin::requestHandler(Reactor & /* theReactor */,
-                            const SmartMet::Spine::HTTP::Request &theRequest,
-                            SmartMet::Spine::HTTP::Response &theResponse)
+void Plugin::shutdown()
 {
-  try
-  {
-    bool isdebug =
-        (SmartMet::Spine::optional_string(theRequest.getParameter("format"), "") == "debug");
+  std::cout << "  -- Shutdown requested (aviplugin)\n";
 
-    try
-    {
-      const int expires_seconds = 60;
-      Fmi::DateTime t_now = Fmi::SecondClock::universal_time();
+  if (itsSubscriptionHub)
+    itsSubscriptionHub->shutdown();
 
-      query(theRequest, theResponse);
-      theResponse.setStatus(HTTP::Status::ok);
+  if (itsQueryExecutor)
+    itsQueryExecutor->shutdown();
 
-      // Build cache expiration time info
+  // Waits for the engine calls still running past their deadline
 
-      Fmi::DateTime t_expires = t_now + Fmi::Seconds(expires_seconds);
+  if (itsDeadlineExecutor)
+    itsDeadlineExecutor->shutdown();
 
-      // The headers themselves
+  stopBackgroundTasks();
+}
 
-      std::shared_ptr<Fmi::TimeFormatter> tformat(Fmi::TimeFormatter::create("http"));
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run periodic tasks until shutdown
+ */
+// ----------------------------------------------------------------------
 
-      std::string cachecontrol = "public, max-age=" + Fmi::to_string(expires_seconds);
-      std::string expiration = tformat->format(t_expires);
-      std::string modification = tformat->format(t_now);
+void Plugin::backgroundTasks()
+{
+  using Clock = std::chrono::steady_clock;
 
-      theResponse.setHeader("Cache-Control", cachecontrol);
-      theResponse.setHeader("Expires", expiration);
-      theResponse.setHeader("Last-Modified", modification);
-    }
-    catch (...)
-    {
-      // Catching all exceptions
+  auto nextStationUpdate = Clock::now();
+  auto nextMessagePoll = Clock::now();
 
-      Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
-      exception.addParameter("URI", theRequest.getURI());
-      exception.addParameter("ClientIP", theRequest.getClientIP());
-      exception.addParameter("HostName", Spine::HostInfo::getHostName(theRequest.getClientIP()));
-      exception.printError();
+  std::unique_lock<std::mutex> lock(itsBackgroundMutex);
 
-      if (isdebug)
-      {
-        // Delivering the exception information as HTTP content
+  while (!itsShutdownRequested)
+  {
+    lock.unlock();
 
-        std::string fullMessage = std::string("Error: ") + exception.getHtmlStackTrace();
-        theResponse.setContent(fullMessage);
-        theResponse.setStatus(HTTP::Status::ok);
+    if (Clock::now() >= nextStationUpdate)
+    {
+      try
+      {
+        updateStations();
       }
-      else
+      catch (...)
       {
-        theResponse.setStatus(HTTP::Status::bad_request);
+        Fmi::Exception exception(BCP, "Failed to update avi stations", nullptr);
+        exception.printError();
       }
 
-      // Adding the first exception information into the response header
+      nextStationUpdate =
+          Clock::now() + std::chrono::seconds(itsConfig->stationIndexRefreshInterval());
+    }
+
+    if (itsMessageMonitor && (Clock::now() >= nextMessagePoll))
+    {
+      try
+      {
+        itsMessageMonitor->poll();
+      }
+      catch (...)
+      {
+        Fmi::Exception exception(BCP, "Failed to poll new avi messages", nullptr);
+        exception.printError();
+      }
 
-      std::string firstMessage = exception.what();
-      boost::algorithm::replace_all(firstMessage, "\n", " ");
-      firstMessage = firstMessage.substr(0, 300);
-      theResponse.setHeader("X-Avi-Error", firstMessage);
+      nextMessagePoll =
+          Clock::now() + std::chrono::seconds(itsConfig->messageMonitorPollInterval());
     }
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+
+    auto nextTask = (itsMessageMonitor ? std::min(nextStationUpdate, nextMessagePoll)
+                                       : nextStationUpdate);
+
+    lock.lock();
+    itsBackgroundCondition.wait_until(lock, nextTask, [this] { return itsShutdownRequested; });
   }
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Plugin constructor
+ * \brief Stop periodic tasks
  */
 // ----------------------------------------------------------------------
 
-Plugin::Plugin(Reactor *theReactor, const char *theConfigFileName)
-    : itsModuleName("Avi"), itsConfigFileName(theConfigFileName), itsReactor(theReactor)
+void Plugin::stopBackgroundTasks()
 {
-  try
-  {
-    if (theReactor->getRequiredAPIVersion() != SMARTMET_API_VERSION)
-    {
-      std::cerr << "*** AviPlugin and Server SmartMet API version mismatch ***\n";
-      return;
-    }
-  }
-  catch (...)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+    std::lock_guard<std::mutex> lock(itsBackgroundMutex);
+    itsShutdownRequested = true;
   }
+
+  itsBackgroundCondition.notify_all();
+
+  if (itsBackgroundThread.joinable())
+    itsBackgroundThread.join();
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Plugin initialization
+ * \brief Reload stations; replace the station index and forget unknown locations
  */
 // ----------------------------------------------------------------------
 
-void Plugin::init()
+void Plugin::updateStations()
 {
-  using namespace boost::placeholders;
-
   try
   {
-    /* AviEngine */
-
-    itsAviEngine = itsReactor->getEngine<SmartMet::Engine::Avi::Engine>("Avi", nullptr);
-
-    itsConfig.reset(new Config(itsConfigFileName));
-
-    /* AuthenticationEngine */
-
-    if (itsConfig->useAuthentication())
+    if (itsConfig->useStationIndex())
     {
-      itsAuthEngine = itsReactor->getEngine<SmartMet::Engine::Authentication::Engine>(
-          "Authentication", nullptr);
+      auto stationIndex =
+          std::make_shared<const StationIndex>(loadStations(*itsAviEngine),
+                                               itsConfig->stationIndexCacheSize());
 
-      if (!itsAuthEngine->isEnabled())
-        throw Fmi::Exception(BCP, "Authentication engine is disabled");
+      std::atomic_store(&itsStationIndex, stationIndex);
     }
 
-    if (!(itsReactor->addContentHandler(
-            this, "/avi", boost::bind(&Plugin::callRequestHandler, this, _1, _2, _3))))
-      throw Fmi::Exception(BCP, "Failed to register avidb content handler");
+    if (itsNegativeCache)
+      itsNegativeCache->clearUnknownLocations();
   }
   catch (...)
   {
@@ -329,13 +2448,47 @@ void Plugin::init()
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Shutdown the plugin
+ * \brief Get current station index, nullptr if not available
  */
 // ----------------------------------------------------------------------
 
-void Plugin::shutdown()
+std::shared_ptr<const StationIndex> Plugin::getStationIndex() const
 {
-  std::cout << "  -- Shutdown requested (aviplugin)\n";
+  return std::atomic_load(&itsStationIndex);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return cache statistics
+ */
+// ----------------------------------------------------------------------
+
+Fmi::Cache::CacheStatistics Plugin::getCacheStats() const
+{
+  Fmi::Cache::CacheStatistics ret;
+
+  auto stationIndex = getStationIndex();
+
+  if (stationIndex)
+    ret.insert(std::make_pair("Avi::station_index_cache", stationIndex->getCacheStats()));
+
+  if (itsNegativeCache)
+  {
+    ret.insert(std::make_pair("Avi::unknown_location_cache",
+                              itsNegativeCache->getUnknownLocationStats()));
+    ret.insert(
+        std::make_pair("Avi::empty_result_cache", itsNegativeCache->getEmptyResultStats()));
+  }
+
+  if (itsLatestCache)
+    ret.insert(std::make_pair("Avi::latest_cache", itsLatestCache->getCacheStats()));
+
+  if (itsQueryCache)
+    ret.insert(std::make_pair("Avi::query_cache", itsQueryCache->statistics()));
+
+  ret.insert(std::make_pair("Avi::request_arena", RequestArena::statistics()));
+
+  return ret;
 }
 
 // ----------------------------------------------------------------------
@@ -361,12 +2514,41 @@ int Plugin::getRequiredAPIVersion() const
 // ----------------------------------------------------------------------
 /*!
  * \brief Performance query implementation.
+ *
+ *        With query scheduling enabled, operational queries (latest
+ *        messages and incremental queries) are reported fast to be handled
+ *        by the server's fast thread pool. Time range and rejected message
+ *        queries, queries of bulk apikey groups and POST requests (options
+ *        in the body are not checked) are slow
  */
 // ----------------------------------------------------------------------
 
-bool Plugin::queryIsFast(const SmartMet::Spine::HTTP::Request & /* theRequest */) const
+bool Plugin::queryIsFast(const SmartMet::Spine::HTTP::Request &theRequest) const
 {
-  return false;
+  try
+  {
+    if (!itsQueryExecutor || (theRequest.getMethod() == HTTP::RequestMethod::POST))
+      return false;
+
+    if (Query::isTimeRangeRequest(theRequest))
+      return false;
+
+    auto validity = theRequest.getParameter("validity");
+
+    if (validity && (Fmi::ascii_tolower_copy(*validity) == "rejected"))
+      return false;
+
+    const auto &group = itsConfig->getQueryLimitsGroup(
+        itsAuthEngine.get(),
+        SmartMet::Spine::optional_string(SmartMet::Spine::FmiApiKey::getFmiApiKey(theRequest),
+                                         ""));
+
+    return !itsConfig->getGroupQueryLimits(group).getBulkQueries();
+  }
+  catch (...)
+  {
+    return false;
+  }
 }
 
 }  // namespace Avi
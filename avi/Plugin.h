@@ -7,9 +7,22 @@
 #pragma once
 
 #include "Config.h"
+#include "LatestCache.h"
+#include "MessageMonitor.h"
+#include "NegativeCache.h"
+#include "QueryExecutor.h"
+#include "RequestArena.h"
+#include "StationIndex.h"
+#include "SubscriptionHub.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <engines/authentication/Engine.h>
 #include <engines/avi/Engine.h>
+#include <macgyver/Cache.h>
 #include <spine/HTTP.h>
 #include <spine/Reactor.h>
 #include <spine/SmartMetPlugin.h>
@@ -21,6 +34,17 @@ namespace Plugin
 {
 namespace Avi
 {
+class Query;
+
+// Engine query result; rejected messages are queried with validity=rejected
+
+struct QueryResult
+{
+  SmartMet::Engine::Avi::StationQueryData itsStationData;
+  SmartMet::Engine::Avi::QueryData itsRejectedData;
+  bool itsNoRows = false;
+};
+
 class Plugin : public SmartMetPlugin
 {
  public:
@@ -28,10 +52,12 @@ class Plugin : public SmartMetPlugin
   Plugin(const Plugin &other) = delete;
   Plugin &operator=(const Plugin &other) = delete;
   Plugin(Reactor *theReactor, const char *theConfigFileName);
+  ~Plugin() override;
 
   const std::string &getPluginName() const override;
   int getRequiredAPIVersion() const override;
   bool queryIsFast(const SmartMet::Spine::HTTP::Request &theRequest) const override;
+  Fmi::Cache::CacheStatistics getCacheStats() const override;
 
  protected:
   void init() override;
@@ -43,6 +69,42 @@ class Plugin : public SmartMetPlugin
  private:
   void query(const SmartMet::Spine::HTTP::Request &theRequest,
              SmartMet::Spine::HTTP::Response &theResponse);
+  Query parseQuery(const SmartMet::Spine::HTTP::Request &theRequest, const std::string &theGroup);
+
+  void validate(const Query &query) const;
+  void fetch(Query &query,
+             const SmartMet::Spine::HTTP::Request &theRequest,
+             QueryResult &theResult,
+             RequestArena &theArena);
+  std::string execute(Query &query,
+                      const SmartMet::Spine::HTTP::Request &theRequest,
+                      std::string &theMimeType,
+                      RequestArena &theArena);
+  Compression::Encoding responseEncoding(const SmartMet::Spine::HTTP::Request &theRequest,
+                                         std::size_t theSize) const;
+  void setEncodingHeaders(SmartMet::Spine::HTTP::Response &theResponse,
+                          Compression::Encoding theEncoding) const;
+
+  void latestRequestHandler(SmartMet::Spine::Reactor &theReactor,
+                            const SmartMet::Spine::HTTP::Request &theRequest,
+                            SmartMet::Spine::HTTP::Response &theResponse);
+  LatestCache::RenditionPtr renderLatest(const LatestCache::Key &theKey);
+
+  void batchRequestHandler(SmartMet::Spine::Reactor &theReactor,
+                           const SmartMet::Spine::HTTP::Request &theRequest,
+                           SmartMet::Spine::HTTP::Response &theResponse);
+
+  void subscriptionRequestHandler(SmartMet::Spine::Reactor &theReactor,
+                                  const SmartMet::Spine::HTTP::Request &theRequest,
+                                  SmartMet::Spine::HTTP::Response &theResponse);
+  SubscriptionHub::Filter subscriptionFilter(const SmartMet::Spine::HTTP::Request &theRequest);
+
+  void backgroundTasks();
+  void stopBackgroundTasks();
+  void updateStations();
+  void checkUnknownLocations(const Query &query,
+                             std::chrono::steady_clock::time_point theDeadline);
+  std::shared_ptr<const StationIndex> getStationIndex() const;
 
   const std::string itsModuleName;
   const std::string itsConfigFileName;
@@ -51,6 +113,45 @@ class Plugin : public SmartMetPlugin
   SmartMet::Spine::Reactor *itsReactor = nullptr;
   std::shared_ptr<SmartMet::Engine::Avi::Engine> itsAviEngine;
   std::shared_ptr<SmartMet::Engine::Authentication::Engine> itsAuthEngine;
+
+  // Station index is replaced atomically when refreshed
+
+  std::shared_ptr<const StationIndex> itsStationIndex;
+
+  std::unique_ptr<NegativeCache> itsNegativeCache;
+  std::unique_ptr<MessageMonitor> itsMessageMonitor;
+  std::unique_ptr<LatestCache> itsLatestCache;
+
+  // Parsed queries by apikey group and query string
+
+  using QueryCache = Fmi::Cache::Cache<std::string, std::shared_ptr<const Query>>;
+  std::unique_ptr<QueryCache> itsQueryCache;
+
+  // Threads executing queries by priority
+
+  std::unique_ptr<QueryExecutor> itsQueryExecutor;
+
+  // Threads executing engine calls with a deadline
+
+  std::unique_ptr<QueryExecutor> itsDeadlineExecutor;
+
+  // Engine calls still queued or running after their deadline has passed
+
+  std::shared_ptr<std::atomic<unsigned int>> itsOverdueQueries =
+      std::make_shared<std::atomic<unsigned int>>(0);
+
+  // Dictionary for zstd-dict encoding, if configured
+
+  std::unique_ptr<Compression::Dictionary> itsDictionary;
+
+  std::shared_ptr<SubscriptionHub> itsSubscriptionHub;
+
+  // Thread running periodic tasks (station refresh, new message polling)
+
+  std::thread itsBackgroundThread;
+  std::mutex itsBackgroundMutex;
+  std::condition_variable itsBackgroundCondition;
+  bool itsShutdownRequested = false;
 };
 
 }  // namespace Avi
@@ -1,16 +1,20 @@
 // ======================================================================
 
 #include "Query.h"
-#include <boost/algorithm/string/trim.hpp>
+#include "Parameters.h"
+#include "Tokenizer.h"
 #include <macgyver/DateTime.h>
 #include <macgyver/DistanceParser.h>
 #include <macgyver/Exception.h>
 #include <macgyver/StringConversion.h>
 #include <spine/Convenience.h>
 #include <spine/FmiApiKey.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <tuple>
 
 using namespace std;
-using namespace boost::algorithm;
 
 namespace SmartMet
 {
@@ -18,117 +22,28 @@ namespace Plugin
 {
 namespace Avi
 {
-// ----------------------------------------------------------------------
-/*!
- * \brief Return list of pairs of values from comma separated string
- */
-// ----------------------------------------------------------------------
-
 namespace
 {
+// Inline buffer for the temporary value lists of a request. Requests with long
+// station lists continue in heap memory
 
-template <typename T>
-T toType(const string & /* s */)
-{
-  throw Fmi::Exception(BCP, "internal: unsupported conversion");
-}
+const std::size_t parseBufferSize = 4096;
 
-template <>
-SmartMet::Engine::Avi::StationIdType toType<SmartMet::Engine::Avi::StationIdType>(const string &s)
-{
-  return Fmi::stol(s);
-}
+// Identifying columns returned in digest mode; message is replaced by its digest
 
-template <>
-double toType<double>(const string &s)
-{
-  return Fmi::stod(s);
-}
+const std::array<const char *, 7> digestParameters{"stationid",
+                                                   "icao",
+                                                   "messagetype",
+                                                   "messageid",
+                                                   "messagetime",
+                                                   "messagecreated",
+                                                   "message"};
 
-template <>
-string toType<string>(const string &s)
-{
-  return s;
-}
-
-template <typename T>
-std::optional<list<pair<T, T>>> listOfPairs(const string &commaSeparatedStr,
-                                            const char *optionName,
-                                            size_t nPairs,
-                                            bool latlonPairs = true)
+string errMsgOptionIsEmpty(const char *optionName)
 {
   try
   {
-    string valueStr(trim_copy(commaSeparatedStr));
-
-    if (valueStr.empty())
-      return std::optional<list<pair<T, T>>>();
-
-    std::vector<std::string> flds;
-    boost::split(flds, valueStr, boost::is_any_of(","));
-    size_t nValues = 2 * nPairs;
-
-    // Given number of value pairs (e.g. 2 for bbox) required ?
-
-    if ((nValues > 0) && (flds.size() != nValues))
-      throw Fmi::Exception(BCP,
-                           Fmi::to_string(nValues) + string(" values required for option '") +
-                               optionName + "'; '" + commaSeparatedStr + "'");
-
-    if ((nValues == 0) && ((flds.size() % 2) != 0))
-      throw Fmi::Exception(BCP,
-                           string("Even number of values required for option '") + optionName +
-                               "'; '" + commaSeparatedStr + "'");
-
-    size_t n;
-
-    for (n = 0, nValues = flds.size(); (n < nValues); n++)
-    {
-      boost::trim(flds[n]);
-
-      if (flds[n].empty())
-        throw Fmi::Exception(BCP,
-                             string("Empty value for option '") + optionName + "' at position " +
-                                 Fmi::to_string(n + 1) + "; '" + commaSeparatedStr + "'");
-    }
-
-    list<pair<T, T>> valueList;
-
-    for (n = 0; (n < nValues);)
-    {
-      try
-      {
-        auto value1 = toType<T>(flds[n]);
-        n++;
-        auto value2 = toType<T>(flds[n]);
-        n++;
-
-        if (latlonPairs)
-        {
-          // Order lon,lat expected
-          //
-          if ((value1 < -180) || (value1 > 180))
-            throw Fmi::Exception(BCP,
-                                 string("Value in range [-180,180] expected for option '") +
-                                     optionName + "' at position " + Fmi::to_string(n - 1) + "; '" +
-                                     commaSeparatedStr + "'");
-          if ((value2 < -90) || (value2 > 90))
-            throw Fmi::Exception(BCP,
-                                 string("Value in range [-90,90] expected for option '") +
-                                     optionName + "' at position " + Fmi::to_string(n) + "; '" +
-                                     commaSeparatedStr + "'");
-        }
-
-        valueList.push_back(make_pair<T, T>((T)value1, (T)value2));
-      }
-      catch (...)
-      {
-        throw Fmi::Exception(BCP,
-                             string("Invalid value for option '") + optionName + "' at position " +
-                                 Fmi::to_string(n + 1) + "; '" + commaSeparatedStr + "'");
-      }
-    }
-    return std::optional<list<pair<T, T>>>(valueList);
+    return string("Option '") + optionName + "' is empty";
   }
   catch (...)
   {
@@ -138,141 +53,48 @@ std::optional<list<pair<T, T>>> listOfPairs(const string &commaSeparatedStr,
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Return list of values from comma separated string
+ * \brief Call 'theCallback(value)' for each value of the option
+ *
+ *        The values are not copied like with getParameterList()
  */
 // ----------------------------------------------------------------------
 
-template <typename T>
-bool validValue(const T &value, double minValue, double maxValue)
+template <typename Callback>
+bool forEachParameter(const SmartMet::Spine::HTTP::Request &theRequest,
+                      const char *theOptionName,
+                      Callback &&theCallback)
 {
-  return ((value >= minValue) && (value <= maxValue));
-}
-
-template <>
-bool validValue<string>(const string & /*value */, double /*minValue*/, double /*maxValue*/)
-{
-  return true;
-}
-
-template <typename T>
-std::optional<list<T>> listOfValues(const string &commaSeparatedStr,
-                                    const char *optionName,
-                                    size_t nValues = 0,
-                                    bool even = true,
-                                    bool swap = false,
-                                    bool latlonValues = true)
-{
-  try
-  {
-    string valueStr(trim_copy(commaSeparatedStr));
-
-    if (valueStr.empty())
-      return std::optional<list<T>>();
-
-    std::vector<std::string> flds;
-    boost::split(flds, valueStr, boost::is_any_of(","));
-
-    // Given or even number of values required ?
-
-    if (nValues > 0)
-    {
-      if (nValues != flds.size())
-        throw Fmi::Exception(BCP,
-                             Fmi::to_string(nValues) + string(" values required for option '") +
-                                 optionName + "'; '" + commaSeparatedStr + "'");
-    }
-    else
-    {
-      nValues = flds.size();
+  auto range = theRequest.getParameterMap().equal_range(theOptionName);
 
-      if (even && ((nValues % 2) != 0))
-        throw Fmi::Exception(BCP,
-                             string("Even number of values required for option '") + optionName +
-                                 "'; '" + commaSeparatedStr + "'");
-    }
-
-    size_t n = 0;
-    size_t np = 0;
-
-    for (n = 0; (n < nValues); n++)
-    {
-      boost::trim(flds[n]);
+  for (auto it = range.first; (it != range.second); ++it)
+    theCallback(std::string_view(it->second));
 
-      if (flds[n].empty())
-        throw Fmi::Exception(BCP,
-                             string("Empty value for option '") + optionName + "' at position " +
-                                 Fmi::to_string(n + 1) + "; '" + commaSeparatedStr + "'");
-    }
-
-    list<T> valueList;
-
-    for (n = 0, np = 0; (n < nValues); n++)
-    {
-      // Swap the elements (e.g. convert latlons to lonlats) if requested.
-      //
-      // If swapping, we need an even number of elements:
-      // - if n is odd, use np
-      // - if n is even, use n + 1
-      size_t nn = n;
-
-      if (swap)
-      {
-        const bool n_is_odd = (n % 2) != 0;
-        nn = n_is_odd ? np : (n + 1);
-      }
-
-      bool castOk = false;
-
-      try
-      {
-        castOk = false;
-        T value = toType<T>(flds[nn]);
-        castOk = true;
-
-        if (latlonValues)
-        {
-          // Order lon,lat expected
-          //
-          if ((n % 2) == 0)
-          {
-            if (!validValue<T>(value, -180, 180))
-              throw Fmi::Exception(BCP,
-                                   string("Value in range [-180,180] expected for option '") +
-                                       optionName + "' at position " + Fmi::to_string(nn + 1) +
-                                       "; '" + commaSeparatedStr + "'");
-          }
-          else
-          {
-            if (!validValue<T>(value, -90, 90))
-              throw Fmi::Exception(BCP,
-                                   string("Value in range [-90,90] expected for option '") +
-                                       optionName + "' at position " + Fmi::to_string(nn + 1) +
-                                       "; '" + commaSeparatedStr + "'");
-          }
-        }
-
-        valueList.push_back(value);
-      }
-      catch (...)
-      {
-        if (castOk)
-          throw Fmi::Exception::Trace(BCP,
-                                      string("Invalid value for option '") + optionName +
-                                          "' at position " + Fmi::to_string(nn + 1) + "; '" +
-                                          commaSeparatedStr + "'");
-      }
+  return (range.first != range.second);
+}
 
-      np = n;
-    }
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse comma separated values of the option into 'theValues'
+ */
+// ----------------------------------------------------------------------
 
-    return std::optional<list<T>>(valueList);
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
+bool parseValueLists(const SmartMet::Spine::HTTP::Request &theRequest,
+                     const char *theOptionName,
+                     Tokenizer::ValueList &theValues)
+{
+  return forEachParameter(theRequest,
+                          theOptionName,
+                          [&](std::string_view value)
+                          {
+                            if (Tokenizer::trim(value).empty())
+                              throw Fmi::Exception(BCP, errMsgOptionIsEmpty(theOptionName));
+
+                            Tokenizer::parseValueList(value, theOptionName, theValues);
+                          });
 }
 
+}  // namespace
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Parse 'message type' query option.
@@ -282,41 +104,17 @@ std::optional<list<T>> listOfValues(const string &commaSeparatedStr,
  */
 // ----------------------------------------------------------------------
 
-string errMsgOptionIsEmpty(const char *optionName)
+void Query::parseMessageTypeOption(const SmartMet::Spine::HTTP::Request &theRequest,
+                                   std::pmr::memory_resource *theArena)
 {
   try
   {
-    return string("Option '") + optionName + "' is empty";
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
-}  // namespace
-
-void Query::parseMessageTypeOption(const SmartMet::Spine::HTTP::Request &theRequest)
-{
-  try
-  {
-    const char *optionName = nullptr;
-
-    auto messagetypes = theRequest.getParameterList(optionName = "messagetype");
-    if (!messagetypes.empty())
-    {
-      for (const string &messagetype : messagetypes)
-      {
-        auto listOfMessageTypes =
-            listOfValues<string>(messagetype, optionName, 0, false, false, false);
+    Tokenizer::ValueList messageTypes(theArena);
 
-        if ((!listOfMessageTypes) || listOfMessageTypes->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+    parseValueLists(theRequest, "messagetype", messageTypes);
 
-        for (const string &m : *listOfMessageTypes)
-          itsQueryOptions.itsMessageTypes.push_back(Fmi::ascii_toupper_copy(m));
-      }
-    }
+    for (auto messageType : messageTypes)
+      Fmi::ascii_toupper(itsQueryOptions.itsMessageTypes.emplace_back(messageType));
   }
   catch (...)
   {
@@ -328,34 +126,30 @@ void Query::parseMessageTypeOption(const SmartMet::Spine::HTTP::Request &theRequ
 /*!
  * \brief Parse 'param' query option.
  *
- * 		  The parameters given are validated by aviengine when executing query.
+ * 		  The parameters given are validated against the known parameter names.
  */
 // ----------------------------------------------------------------------
 
-void Query::parseParamOption(const SmartMet::Spine::HTTP::Request &theRequest)
+void Query::parseParamOption(const SmartMet::Spine::HTTP::Request &theRequest,
+                             std::pmr::memory_resource *theArena)
 {
   try
   {
-    const char *optionName = nullptr;
+    Tokenizer::ValueList params(theArena);
 
-    auto params = theRequest.getParameterList(optionName = "param");
-    if (!params.empty())
-    {
-      for (const string &param : params)
-      {
-        auto listOfParams = listOfValues<string>(param, optionName, 0, false, false, false);
+    if (!parseValueLists(theRequest, "param", params))
+      throw Fmi::Exception(BCP, "Option 'param' must be provided");
 
-        if ((!listOfParams) || listOfParams->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+    // Unknown parameters are rejected before querying the engine
 
-        for (const string &p : *listOfParams)
-          itsQueryOptions.itsParameters.push_back(Fmi::ascii_tolower_copy(p));
-      }
+    for (auto param : params)
+    {
+      auto &name = itsQueryOptions.itsParameters.emplace_back(param);
+      Fmi::ascii_tolower(name);
 
-      return;
+      if (!Parameters::find(name))
+        throw Fmi::Exception(BCP, "Unknown parameter '" + name + "'");
     }
-
-    throw Fmi::Exception(BCP, "Option 'param' must be provided");
   }
   catch (...)
   {
@@ -401,70 +195,55 @@ void Query::checkIfMultipleLocationOptionsAllowed(bool allowMultipleLocationOpti
 }
 
 void Query::parseLocationOptions(const SmartMet::Spine::HTTP::Request &theRequest,
-                                 bool allowMultipleLocationOptions)
+                                 bool allowMultipleLocationOptions,
+                                 std::pmr::memory_resource *theArena)
 {
   try
   {
+    auto &locationOptions = itsQueryOptions.itsLocationOptions;
+
     // Named locations (station names)
     //
     // place=place1&place=place2&place=...
     // places=place1,place2,...
 
-    const char *optionName = nullptr;
+    forEachParameter(theRequest,
+                     "place",
+                     [&](std::string_view place)
+                     {
+                       if (place.empty())
+                         throw Fmi::Exception(BCP, errMsgOptionIsEmpty("place"));
 
-    auto places = theRequest.getParameterList(optionName = "place");
-    if (!places.empty())
-    {
-      for (const string &place : places)
-      {
-        if (place.empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+                       locationOptions.itsPlaces.emplace_back(place);
+                     });
 
-        itsQueryOptions.itsLocationOptions.itsPlaces.push_back(place);
-      }
-    }
+    Tokenizer::ValueList values(theArena);
 
-    places = theRequest.getParameterList(optionName = "places");
-    if (!places.empty())
-    {
+    if (parseValueLists(theRequest, "places", values))
       checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
 
-      for (const string &place : places)
-      {
-        auto listOfPlaces = listOfValues<string>(place, optionName, 0, false, false, false);
-
-        if ((!listOfPlaces) || listOfPlaces->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
-
-        for (const string &p : *listOfPlaces)
-          itsQueryOptions.itsLocationOptions.itsPlaces.push_back(p);
-      }
-    }
+    locationOptions.itsPlaces.insert(locationOptions.itsPlaces.end(), values.begin(), values.end());
 
     // Bounding boxes
     //
     // bbox=bllon,bllat,trlon,trlat&bbox=...
 
-    auto bboxes = theRequest.getParameterList(optionName = "bbox");
-    if (!bboxes.empty())
-    {
-      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
-
-      for (const string &bbox : bboxes)
-      {
-        auto listOfTwoLonLatPairs = listOfPairs<double>(bbox, optionName, 2);
+    Tokenizer::LonLatList lonLats(theArena);
 
-        if ((!listOfTwoLonLatPairs) || listOfTwoLonLatPairs->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+    if (forEachParameter(theRequest,
+                         "bbox",
+                         [&](std::string_view bbox)
+                         {
+                           if (Tokenizer::trim(bbox).empty())
+                             throw Fmi::Exception(BCP, errMsgOptionIsEmpty("bbox"));
 
-        auto west = listOfTwoLonLatPairs->front().first;
-        auto south = listOfTwoLonLatPairs->front().second;
-        auto east = listOfTwoLonLatPairs->back().first;
-        auto north = listOfTwoLonLatPairs->back().second;
+                           Tokenizer::parseCoordinateList(bbox, "bbox", false, 2, lonLats);
+                         }))
+      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
 
-        itsQueryOptions.itsLocationOptions.itsBBoxes.emplace_back(west, east, south, north);
-      }
-    }
+    for (std::size_t n = 0; (n < lonLats.size()); n += 2)
+      locationOptions.itsBBoxes.emplace_back(
+          lonLats[n].first, lonLats[n + 1].first, lonLats[n].second, lonLats[n + 1].second);
 
     // Latlon points
     //
@@ -473,206 +252,127 @@ void Query::parseLocationOptions(const SmartMet::Spine::HTTP::Request &theReques
     // lonlats=lon1,lat1,lon2,lat2,...&lonlats=...
     // latlons=lat1,lon1,lat2,lon2,...&latlons=...
 
-    auto lonlats = theRequest.getParameterList(optionName = "lonlat");
-    if (!lonlats.empty())
-    {
-      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
+    lonLats.clear();
 
-      for (const string &lonlat : lonlats)
-      {
-        auto listOfTwoValues = listOfValues<double>(lonlat, optionName, 2);
-
-        if ((!listOfTwoValues) || listOfTwoValues->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
-
-        itsQueryOptions.itsLocationOptions.itsLonLats.emplace_back(listOfTwoValues->front(),
-                                                                   listOfTwoValues->back());
-      }
-    }
-
-    auto latlons = theRequest.getParameterList(optionName = "latlon");
-    if (!latlons.empty())
+    for (const auto &option : {std::make_tuple("lonlat", false, 1),
+                               std::make_tuple("latlon", true, 1),
+                               std::make_tuple("lonlats", false, 0),
+                               std::make_tuple("latlons", true, 0)})
     {
-      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
-
-      for (const string &latlon : latlons)
-      {
-        auto listOfTwoValues = listOfValues<double>(latlon, optionName, 2, true, true);
-
-        if ((!listOfTwoValues) || listOfTwoValues->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
-
-        itsQueryOptions.itsLocationOptions.itsLonLats.emplace_back(listOfTwoValues->front(),
-                                                                   listOfTwoValues->back());
-      }
-    }
-
-    lonlats = theRequest.getParameterList(optionName = "lonlats");
-    if (!lonlats.empty())
-    {
-      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
-
-      for (const string &lonlat : lonlats)
-      {
-        auto listOfEvenNValues = listOfValues<double>(lonlat, optionName);
-
-        if ((!listOfEvenNValues) || listOfEvenNValues->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
-
-        for (auto it = listOfEvenNValues->begin(); (it != listOfEvenNValues->end());)
-        {
-          auto lon = *it;
-          it++;
-          auto lat = *it;
-          it++;
-
-          itsQueryOptions.itsLocationOptions.itsLonLats.emplace_back(lon, lat);
-        }
-      }
-    }
+      const char *optionName = std::get<0>(option);
+      bool latLonOrder = std::get<1>(option);
+      std::size_t requiredPairs = std::get<2>(option);
 
-    latlons = theRequest.getParameterList(optionName = "latlons");
-    if (!latlons.empty())
-    {
-      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
+      if (forEachParameter(theRequest,
+                           optionName,
+                           [&](std::string_view value)
+                           {
+                             if (Tokenizer::trim(value).empty())
+                               throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
 
-      for (const string &latlon : latlons)
-      {
-        auto listOfEvenNValues = listOfValues<double>(latlon, optionName, 0, true, true);
+                             Tokenizer::parseCoordinateList(
+                                 value, optionName, latLonOrder, requiredPairs, lonLats);
+                           }))
+        checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
 
-        if ((!listOfEvenNValues) || listOfEvenNValues->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+      // Locations are stored per option, so that the check above sees the earlier options
 
-        for (auto it = listOfEvenNValues->begin(); (it != listOfEvenNValues->end());)
-        {
-          auto lon = *it;
-          it++;
-          auto lat = *it;
-          it++;
+      for (const auto &lonLat : lonLats)
+        locationOptions.itsLonLats.emplace_back(lonLat.first, lonLat.second);
 
-          itsQueryOptions.itsLocationOptions.itsLonLats.emplace_back(lon, lat);
-        }
-      }
+      lonLats.clear();
     }
 
     // WKT's
 
-    auto wkts = theRequest.getParameterList(optionName = "wkt");
-    if (!wkts.empty())
-    {
-      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
+    values.clear();
 
-      for (const string &wkt : wkts)
-      {
-        if (boost::trim_copy(wkt).empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
-
-        itsQueryOptions.itsLocationOptions.itsWKTs.itsWKTs.push_back(wkt);
-      }
-    }
-
-    // Icao codes
+    if (forEachParameter(theRequest,
+                         "wkt",
+                         [&](std::string_view wkt)
+                         {
+                           if (Tokenizer::trim(wkt).empty())
+                             throw Fmi::Exception(BCP, errMsgOptionIsEmpty("wkt"));
 
-    auto icaos = theRequest.getParameterList(optionName = "icao");
-    if (!icaos.empty())
-    {
+                           values.push_back(wkt);
+                         }))
       checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
 
-      for (const string &icao : icaos)
-      {
-        if (icao.empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+    locationOptions.itsWKTs.itsWKTs.insert(
+        locationOptions.itsWKTs.itsWKTs.end(), values.begin(), values.end());
 
-        itsQueryOptions.itsLocationOptions.itsIcaos.push_back(icao);
-      }
-    }
+    // Icao codes; 'icao' values are passed to the engine as such
+    //
+    // icao=code1&icao=code2&...
+    // icaos=code1,code2,...
 
-    icaos = theRequest.getParameterList(optionName = "icaos");
-    if (!icaos.empty())
-    {
+    if (theRequest.getParameter("icao"))
       checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
 
-      for (const string &icao : icaos)
-      {
-        auto listOfIcaos = listOfValues<string>(icao, optionName, 0, false, false, false);
-
-        if ((!listOfIcaos) || listOfIcaos->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+    forEachParameter(theRequest,
+                     "icao",
+                     [&](std::string_view icao)
+                     {
+                       if (icao.empty())
+                         throw Fmi::Exception(BCP, errMsgOptionIsEmpty("icao"));
 
-        for (const string &p : *listOfIcaos)
-          itsQueryOptions.itsLocationOptions.itsIcaos.push_back(p);
-      }
-    }
+                       locationOptions.itsIcaos.emplace_back(icao);
+                     });
 
-    // Country codes
+    values.clear();
 
-    auto countries = theRequest.getParameterList(optionName = "country");
-    if (!countries.empty())
-    {
+    if (parseValueLists(theRequest, "icaos", values))
       checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
 
-      for (const string &country : countries)
-      {
-        if (country.empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+    locationOptions.itsIcaos.insert(locationOptions.itsIcaos.end(), values.begin(), values.end());
 
-        itsQueryOptions.itsLocationOptions.itsCountries.push_back(country);
-      }
-    }
+    // Country codes
 
-    countries = theRequest.getParameterList(optionName = "countries");
-    if (!countries.empty())
-    {
-      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
+    values.clear();
 
-      for (const string &country : countries)
-      {
-        auto listOfCountries = listOfValues<string>(country, optionName, 0, false, false, false);
+    if (forEachParameter(theRequest,
+                         "country",
+                         [&](std::string_view country)
+                         {
+                           if (country.empty())
+                             throw Fmi::Exception(BCP, errMsgOptionIsEmpty("country"));
 
-        if ((!listOfCountries) || listOfCountries->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+                           values.push_back(country);
+                         }))
+      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
 
-        for (const string &c : *listOfCountries)
-          itsQueryOptions.itsLocationOptions.itsCountries.push_back(c);
-      }
-    }
+    locationOptions.itsCountries.insert(
+        locationOptions.itsCountries.end(), values.begin(), values.end());
 
-    // Station id's
+    values.clear();
 
-    auto stationids = theRequest.getParameterList(optionName = "stationid");
-    if (!stationids.empty())
-    {
+    if (parseValueLists(theRequest, "countries", values))
       checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
 
-      for (const string &stationid : stationids)
-      {
-        auto listOfNValues = listOfValues<SmartMet::Engine::Avi::StationIdType>(
-            stationid, optionName, 0, false, false, false);
+    locationOptions.itsCountries.insert(
+        locationOptions.itsCountries.end(), values.begin(), values.end());
 
-        if ((!listOfNValues) || listOfNValues->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+    // Station id's
 
-        for (auto id : *listOfNValues)
-          itsQueryOptions.itsLocationOptions.itsStationIds.push_back(id);
-      }
-    }
+    Tokenizer::StationIdList stationIds(theArena);
 
-    stationids = theRequest.getParameterList(optionName = "stationids");
-    if (!stationids.empty())
+    for (auto *option : {"stationid", "stationids"})
     {
-      checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
+      if (forEachParameter(theRequest,
+                           option,
+                           [&](std::string_view stationid)
+                           {
+                             if (Tokenizer::trim(stationid).empty())
+                               throw Fmi::Exception(BCP, errMsgOptionIsEmpty(option));
 
-      for (const string &stationid : stationids)
-      {
-        auto listOfNValues = listOfValues<SmartMet::Engine::Avi::StationIdType>(
-            stationid, optionName, 0, false, false, false);
+                             Tokenizer::parseStationIdList(stationid, option, stationIds);
+                           }))
+        checkIfMultipleLocationOptionsAllowed(allowMultipleLocationOptions);
 
-        if ((!listOfNValues) || listOfNValues->empty())
-          throw Fmi::Exception(BCP, errMsgOptionIsEmpty(optionName));
+      locationOptions.itsStationIds.insert(
+          locationOptions.itsStationIds.end(), stationIds.begin(), stationIds.end());
 
-        for (auto id : *listOfNValues)
-          itsQueryOptions.itsLocationOptions.itsStationIds.push_back(id);
-      }
+      stationIds.clear();
     }
 
     // Max station distance (km) is taken into account with coordinate, bbox and wkt queries
@@ -709,6 +409,17 @@ void Query::parseLocationOptions(const SmartMet::Spine::HTTP::Request &theReques
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if time range option is given
+ */
+// ----------------------------------------------------------------------
+
+bool Query::isTimeRangeRequest(const SmartMet::Spine::HTTP::Request &theRequest)
+{
+  return (theRequest.getParameter(startTimeOption) || theRequest.getParameter(endTimeOption));
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Parse time related query options
@@ -728,8 +439,9 @@ void Query::parseTimeOptions(const SmartMet::Spine::HTTP::Request &theRequest,
     // messages created within the range, depending on option 'validrangemessages'
     // (default 1 (nonzero); valid messages)
 
-    string startTime = SmartMet::Spine::optional_string(theRequest.getParameter("startTime"), "");
-    string endTime = SmartMet::Spine::optional_string(theRequest.getParameter("endTime"), "");
+    string startTime =
+        SmartMet::Spine::optional_string(theRequest.getParameter(startTimeOption), "");
+    string endTime = SmartMet::Spine::optional_string(theRequest.getParameter(endTimeOption), "");
     string obsTime = SmartMet::Spine::optional_string(theRequest.getParameter("time"), "");
 
     itsQueryOptions.itsTimeOptions.itsQueryValidRangeMessages =
@@ -794,6 +506,283 @@ void Query::parseTimeOptions(const SmartMet::Spine::HTTP::Request &theRequest,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse incremental query option 'since'
+ *
+ *        Messages are queried by message time starting 'lookbackMinutes'
+ *        before the cursor to catch late arriving messages; the result is
+ *        then filtered by creation time and message id
+ */
+// ----------------------------------------------------------------------
+
+void Query::parseCursorOption(const SmartMet::Spine::HTTP::Request &theRequest,
+                              int maxTimeRangeInDays,
+                              unsigned int lookbackMinutes)
+{
+  try
+  {
+    auto since = theRequest.getParameter("since");
+
+    if (!since)
+      return;
+
+    if (isTimeRangeRequest(theRequest) || theRequest.getParameter("time"))
+      throw Fmi::Exception(
+          BCP, "Can't specify both 'since' and time range ('starttime' and 'endtime') or 'time'");
+
+    if (itsQueryOptions.itsValidity != Engine::Avi::Validity::Accepted)
+      throw Fmi::Exception(BCP, "'since' can only be used to query accepted messages");
+
+    itsCursor = Cursor::parse(*since);
+
+    auto now = Fmi::SecondClock::universal_time();
+    auto startTime = itsCursor->created() - Fmi::Minutes(lookbackMinutes);
+
+    if ((maxTimeRangeInDays > 0) && ((now - startTime).hours() > (maxTimeRangeInDays * 24)))
+      throw Fmi::Exception(BCP,
+                           "Cursor too old, maximum time range is " +
+                               Fmi::to_string(maxTimeRangeInDays) + " days");
+
+    itsQueryOptions.itsTimeOptions.itsObservationTime.clear();
+    itsQueryOptions.itsTimeOptions.itsStartTime =
+        string("timestamptz '") + Fmi::to_iso_string(startTime) + "Z'";
+    itsQueryOptions.itsTimeOptions.itsEndTime =
+        string("timestamptz '") + Fmi::to_iso_string(now + Fmi::Hours(1)) + "Z'";
+    itsQueryOptions.itsTimeOptions.itsQueryValidRangeMessages = false;
+
+    // Creation time and message id are needed for filtering
+
+    auto &params = itsQueryOptions.itsParameters;
+
+    for (const string column : {"messagecreated", "messageid"})
+      if (std::find(params.begin(), params.end(), column) == params.end())
+      {
+        params.push_back(column);
+        itsCursorColumns.push_back(column);
+      }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse aggregation options 'aggregate' and 'groupby'
+ *
+ *        Messages can be grouped by parameter values and by hour or day of
+ *        message time (creation time for rejected messages). Icao of rejected
+ *        messages is the rejected icao code
+ */
+// ----------------------------------------------------------------------
+
+void Query::parseAggregationOptions(const SmartMet::Spine::HTTP::Request &theRequest,
+                                    std::pmr::memory_resource *theArena)
+{
+  try
+  {
+    auto aggregate = theRequest.getParameter("aggregate");
+
+    if (!aggregate)
+    {
+      if (theRequest.getParameter("groupby"))
+        throw Fmi::Exception(BCP, "Option 'groupby' can only be used with 'aggregate'");
+
+      return;
+    }
+
+    if (Fmi::ascii_tolower_copy(*aggregate) != "count")
+      throw Fmi::Exception(BCP, "Unknown 'aggregate', use 'count'");
+
+    if (itsDigest)
+      throw Fmi::Exception(BCP, "Options 'digest' and 'aggregate' can't be used together");
+
+    bool rejected = (itsQueryOptions.itsValidity == Engine::Avi::Validity::Rejected);
+
+    Tokenizer::ValueList groupBy(theArena);
+    parseValueLists(theRequest, "groupby", groupBy);
+
+    std::vector<Aggregation::Key> keys;
+    auto &params = itsQueryOptions.itsParameters;
+
+    params.clear();
+
+    for (auto value : groupBy)
+    {
+      auto name = Fmi::ascii_tolower_copy(string(value));
+      Aggregation::Key key{name, name, 0};
+
+      if ((name == "hour") || (name == "day"))
+      {
+        key.itsColumn = (rejected ? "messagecreated" : "messagetime");
+        key.itsInterval = ((name == "hour") ? 3600 : 86400);
+      }
+      else if (!Parameters::find(name) || (name == "message"))
+        throw Fmi::Exception(BCP, "Unknown 'groupby' column '" + name + "'");
+      else if (rejected && (name == "icao"))
+        key.itsColumn = "messagerejectedicao";
+
+      if (std::find(params.begin(), params.end(), key.itsColumn) == params.end())
+        params.push_back(key.itsColumn);
+
+      keys.push_back(std::move(key));
+    }
+
+    // Total count needs some column to be queried
+
+    if (params.empty())
+      params.push_back("messageid");
+
+    itsAggregation.emplace(std::move(keys));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse message text filter options 'contains' and 'match'
+ *
+ *        Message is needed for the filtering. The number and total length of the
+ *        patterns are limited, since the filter's memory use grows with them
+ */
+// ----------------------------------------------------------------------
+
+void Query::parseMessageFilterOptions(const SmartMet::Spine::HTTP::Request &theRequest,
+                                      std::pmr::memory_resource *theArena,
+                                      unsigned int maxPatterns,
+                                      unsigned int maxPatternBytes)
+{
+  try
+  {
+    Tokenizer::ValueList substrings(theArena);
+    Tokenizer::ValueList tokens(theArena);
+
+    parseValueLists(theRequest, "contains", substrings);
+    parseValueLists(theRequest, "match", tokens);
+
+    if (substrings.empty() && tokens.empty())
+      return;
+
+    if (substrings.size() + tokens.size() > maxPatterns)
+      throw Fmi::Exception(BCP,
+                           "Too many 'contains' and 'match' patterns, max " +
+                               std::to_string(maxPatterns));
+
+    std::size_t patternBytes = 0;
+
+    for (const auto &pattern : substrings)
+      patternBytes += pattern.size();
+    for (const auto &pattern : tokens)
+      patternBytes += pattern.size();
+
+    if (patternBytes > maxPatternBytes)
+      throw Fmi::Exception(BCP,
+                           "Total length of 'contains' and 'match' patterns exceeds " +
+                               std::to_string(maxPatternBytes) + " bytes");
+
+    itsMessageFilter = std::make_shared<MessageFilter>(
+        std::vector<std::string>(substrings.begin(), substrings.end()),
+        std::vector<std::string>(tokens.begin(), tokens.end()));
+
+    auto &params = itsQueryOptions.itsParameters;
+
+    if (std::find(params.begin(), params.end(), "message") == params.end())
+    {
+      params.push_back("message");
+      itsSelectionColumns.push_back("message");
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse options 'latestperstation' and 'sample'
+ *
+ *        Message time is needed for the selection
+ */
+// ----------------------------------------------------------------------
+
+void Query::parseSelectionOptions(const SmartMet::Spine::HTTP::Request &theRequest)
+{
+  try
+  {
+    auto latestCount =
+        SmartMet::Spine::optional_unsigned_long(theRequest.getParameter("latestperstation"), 0);
+    auto sample = theRequest.getParameter("sample");
+
+    if ((latestCount == 0) && !sample)
+      return;
+
+    if (itsQueryOptions.itsValidity != Engine::Avi::Validity::Accepted)
+      throw Fmi::Exception(
+          BCP, "Options 'latestperstation' and 'sample' can only be used for accepted messages");
+
+    itsRowSelection = RowSelection(latestCount, sample ? RowSelection::parseInterval(*sample) : 0);
+
+    auto &params = itsQueryOptions.itsParameters;
+
+    if (std::find(params.begin(), params.end(), "messagetime") == params.end())
+    {
+      params.push_back("messagetime");
+      itsSelectionColumns.push_back("messagetime");
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set engine call deadline
+ *
+ *        Apikey group's deadline overrides the configured deadline of the
+ *        query class; option 'deadline' can only shorten the deadline
+ */
+// ----------------------------------------------------------------------
+
+void Query::parseDeadlineOption(const SmartMet::Spine::HTTP::Request &theRequest,
+                                const QueryLimits &queryLimits,
+                                const Config &config)
+{
+  try
+  {
+    if (!config.useDeadlines())
+      return;
+
+    if (queryLimits.getDeadline() > 0)
+      itsDeadline = queryLimits.getDeadline();
+    else if (itsQueryOptions.itsValidity == Engine::Avi::Validity::Rejected)
+      itsDeadline = config.rejectedDeadline();
+    else if (itsCursor)
+      itsDeadline = config.incrementalDeadline();
+    else if (!itsQueryOptions.itsTimeOptions.itsObservationTime.empty())
+      itsDeadline = config.latestDeadline();
+    else
+      itsDeadline = config.rangeDeadline();
+
+    auto deadline =
+        SmartMet::Spine::optional_unsigned_long(theRequest.getParameter("deadline"), 0);
+
+    if ((deadline > 0) && ((itsDeadline == 0) || (deadline < itsDeadline)))
+      itsDeadline = deadline;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Constructor parses query options
@@ -806,19 +795,71 @@ Query::Query(const SmartMet::Spine::HTTP::Request &theRequest,
 {
   try
   {
+    parse(theRequest,
+          config->getQueryLimits(authEngine,
+                                 SmartMet::Spine::optional_string(
+                                     SmartMet::Spine::FmiApiKey::getFmiApiKey(theRequest), "")),
+          config);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor parses query options using already resolved query limits
+ */
+// ----------------------------------------------------------------------
+
+Query::Query(const SmartMet::Spine::HTTP::Request &theRequest,
+             const QueryLimits &queryLimits,
+             const std::unique_ptr<Config> &config)
+{
+  try
+  {
+    parse(theRequest, queryLimits, config);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse query options
+ */
+// ----------------------------------------------------------------------
+
+void Query::parse(const SmartMet::Spine::HTTP::Request &theRequest,
+                  const QueryLimits &queryLimits,
+                  const std::unique_ptr<Config> &config)
+{
+  try
+  {
+    // Temporary value lists are allocated from a stack buffer
+
+    std::array<std::byte, parseBufferSize> buffer;
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+
     // Parse 'message type' query option
 
-    parseMessageTypeOption(theRequest);
+    parseMessageTypeOption(theRequest, &arena);
 
-    // Parse 'param' query option
+    // Parse 'param' query option; digest mode has fixed parameters and aggregation mode
+    // queries the grouping columns
 
-    parseParamOption(theRequest);
+    itsDigest =
+        (SmartMet::Spine::optional_unsigned_long(theRequest.getParameter("digest"), 0) > 0);
 
-    // Parse location related query options
+    if (itsDigest)
+      itsQueryOptions.itsParameters.assign(digestParameters.begin(), digestParameters.end());
+    else if (!theRequest.getParameter("aggregate"))
+      parseParamOption(theRequest, &arena);
 
-    auto queryLimits = config->getQueryLimits(
-        authEngine,
-        SmartMet::Spine::optional_string(SmartMet::Spine::FmiApiKey::getFmiApiKey(theRequest), ""));
+    // Parse location related query options
 
     // BRAINSTORM-3136; do not allow use of multiple location options
     //
@@ -826,7 +867,8 @@ Query::Query(const SmartMet::Spine::HTTP::Request &theRequest,
     // not with preselected station id list. If query would use bbox(es) and other location options,
     // the stations matching only the other location options would simply be ignored
 
-    parseLocationOptions(theRequest, false /* queryLimits.getAllowMultipleLocationOptions() */);
+    parseLocationOptions(
+        theRequest, false /* queryLimits.getAllowMultipleLocationOptions() */, &arena);
 
     // 'validity' controls whether accepted or rejected messages are returned
 
@@ -840,10 +882,39 @@ Query::Query(const SmartMet::Spine::HTTP::Request &theRequest,
     else
       throw Fmi::Exception(BCP, "Unknown 'validity', use 'accepted' or 'rejected'");
 
+    if (itsDigest && (itsQueryOptions.itsValidity == Engine::Avi::Validity::Rejected))
+      throw Fmi::Exception(BCP, "Option 'digest' is not available for rejected messages");
+
+    // Parse aggregation options
+
+    parseAggregationOptions(theRequest, &arena);
+
     // Parse time related query options
 
     parseTimeOptions(theRequest, queryLimits.getMaxMessageTimeRangeDays());
 
+    // Parse incremental query option
+
+    parseCursorOption(
+        theRequest, queryLimits.getMaxMessageTimeRangeDays(), config->cursorLookback());
+
+    // Parse message text filter, latest and sampled message selection options
+
+    parseMessageFilterOptions(
+        theRequest, &arena, config->maxFilterPatterns(), config->maxFilterBytes());
+    parseSelectionOptions(theRequest);
+
+    // Engine call deadline depends on the query class
+
+    parseDeadlineOption(theRequest, queryLimits, *config);
+
+    // Time range and rejected message queries and all queries of bulk apikey groups are
+    // bulk queries
+
+    itsBulk = (queryLimits.getBulkQueries() ||
+               (itsQueryOptions.itsValidity == Engine::Avi::Validity::Rejected) ||
+               (!itsCursor && itsQueryOptions.itsTimeOptions.itsObservationTime.empty()));
+
     // Message format
 
     itsQueryOptions.itsMessageFormat = Fmi::ascii_toupper_copy(
@@ -868,6 +939,30 @@ Query::Query(const SmartMet::Spine::HTTP::Request &theRequest,
         itsFormat.erase(pos, std::strlen("debug"));
     }
 
+    itsLayout = SmartMet::Spine::optional_string(theRequest.getParameter("layout"), "rows");
+
+    if ((itsLayout != "rows") && (itsLayout != "columns") && (itsLayout != "stations"))
+      throw Fmi::Exception(BCP, "Unknown 'layout', use 'rows', 'columns' or 'stations'");
+
+    if ((itsLayout != "rows") && (itsFormat != "json"))
+      throw Fmi::Exception(BCP, "Option 'layout' is available for json format only");
+
+    if ((itsLayout == "stations") &&
+        (itsQueryOptions.itsValidity == Engine::Avi::Validity::Rejected))
+      throw Fmi::Exception(BCP, "Rejected messages can not be grouped by station");
+
+    if (itsAggregation && ((itsLayout == "stations") || (itsFormat == "geojson")))
+      throw Fmi::Exception(
+          BCP, "Option 'aggregate' can't be used with 'layout=stations' or geojson format");
+
+    itsSimplify = SmartMet::Spine::optional_double(theRequest.getParameter("simplify"), 0);
+
+    if (itsSimplify < 0)
+      throw Fmi::Exception(BCP, "Option 'simplify' can't be negative");
+
+    if ((itsSimplify > 0) && (itsFormat != "geojson"))
+      throw Fmi::Exception(BCP, "Option 'simplify' is available for geojson format only");
+
     // Whether to skip duplicate messages
 
     itsQueryOptions.itsDistinctMessages =
@@ -892,6 +987,7 @@ Query::Query(const SmartMet::Spine::HTTP::Request &theRequest,
 
     itsQueryOptions.itsMaxMessageStations = queryLimits.getMaxMessageStations();
     itsQueryOptions.itsMaxMessageRows = queryLimits.getMaxMessageRows();
+    itsMaxResultBytes = queryLimits.getMaxResultBytes();
   }
   catch (...)
   {
@@ -2,7 +2,11 @@
 
 #pragma once
 
+#include "Aggregation.h"
 #include "Config.h"
+#include "Cursor.h"
+#include "MessageFilter.h"
+#include "RowSelection.h"
 
 #include <engines/authentication/Engine.h>
 #include <engines/avi/Engine.h>
@@ -10,6 +14,9 @@
 #include <spine/Parameter.h>
 
 #include <list>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
 
 namespace SmartMet
@@ -30,20 +37,92 @@ class Query
   Query(const SmartMet::Spine::HTTP::Request &request,
         const SmartMet::Engine::Authentication::Engine *authEngine,
         const std::unique_ptr<Config> &config);
+  Query(const SmartMet::Spine::HTTP::Request &request,
+        const QueryLimits &queryLimits,
+        const std::unique_ptr<Config> &config);
   Query() = delete;
 
+  // Names of the time range options as looked up by the parser. Request parameter lookup
+  // is case insensitive, so e.g. 'starttime' is found too; checks made before parsing use
+  // these names so that they find the same options as the parser
+
+  static constexpr const char *startTimeOption = "startTime";
+  static constexpr const char *endTimeOption = "endTime";
+
+  static bool isTimeRangeRequest(const SmartMet::Spine::HTTP::Request &theRequest);
+
   SmartMet::Engine::Avi::QueryOptions itsQueryOptions;
   std::string itsFormat;
   unsigned int itsPrecision;
 
+  // Layout of json output: rows, columns or stations
+
+  std::string itsLayout;
+
+  // Tolerance of geojson area simplification in degrees; 0 for none
+
+  double itsSimplify = 0;
+
+  // Digest mode returns identifying columns and a digest of the message instead of
+  // the message
+
+  bool itsDigest = false;
+
+  // Aggregation mode returns message counts grouped by the given columns instead of
+  // the messages
+
+  std::optional<Aggregation> itsAggregation;
+  std::size_t itsMaxResultBytes = 0;
+
+  // Engine call deadline in seconds; 0 if none
+
+  unsigned int itsDeadline = 0;
+
+  // Bulk queries are executed with lower priority than operational queries
+
+  bool itsBulk = false;
+
+  // Incremental query position; set to the position after the returned messages.
+  // Cursor columns not requested by the client are removed from the output
+
+  std::optional<Cursor> itsCursor;
+  std::list<std::string> itsCursorColumns;
+
+  // Filtering of messages by their text, and selection of latest and/or time sampled
+  // messages of each station. Columns needed for the selection but not requested
+  // by the client are removed from the output
+
+  std::shared_ptr<const MessageFilter> itsMessageFilter;
+  std::optional<RowSelection> itsRowSelection;
+  std::list<std::string> itsSelectionColumns;
+
  private:
+  void parse(const SmartMet::Spine::HTTP::Request &theRequest,
+             const QueryLimits &queryLimits,
+             const std::unique_ptr<Config> &config);
   void checkIfMultipleLocationOptionsAllowed(bool allowMultipleLocationOptions) const;
 
-  void parseMessageTypeOption(const SmartMet::Spine::HTTP::Request &theRequest);
-  void parseParamOption(const SmartMet::Spine::HTTP::Request &theRequest);
+  void parseMessageTypeOption(const SmartMet::Spine::HTTP::Request &theRequest,
+                              std::pmr::memory_resource *theArena);
+  void parseParamOption(const SmartMet::Spine::HTTP::Request &theRequest,
+                        std::pmr::memory_resource *theArena);
   void parseLocationOptions(const SmartMet::Spine::HTTP::Request &theRequest,
-                            bool allowMultipleLocationOptions);
+                            bool allowMultipleLocationOptions,
+                            std::pmr::memory_resource *theArena);
   void parseTimeOptions(const SmartMet::Spine::HTTP::Request &theRequest, int maxTimeRangeInDays);
+  void parseCursorOption(const SmartMet::Spine::HTTP::Request &theRequest,
+                         int maxTimeRangeInDays,
+                         unsigned int lookbackMinutes);
+  void parseAggregationOptions(const SmartMet::Spine::HTTP::Request &theRequest,
+                               std::pmr::memory_resource *theArena);
+  void parseMessageFilterOptions(const SmartMet::Spine::HTTP::Request &theRequest,
+                                 std::pmr::memory_resource *theArena,
+                                 unsigned int maxPatterns,
+                                 unsigned int maxPatternBytes);
+  void parseSelectionOptions(const SmartMet::Spine::HTTP::Request &theRequest);
+  void parseDeadlineOption(const SmartMet::Spine::HTTP::Request &theRequest,
+                           const QueryLimits &queryLimits,
+                           const Config &config);
 };
 
 }  // namespace Avi
@@ -0,0 +1,189 @@
+// ======================================================================
+
+#include "QueryExecutor.h"
+#include <macgyver/Exception.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor starts the threads
+ */
+// ----------------------------------------------------------------------
+
+QueryExecutor::QueryExecutor(unsigned int theThreads,
+                             std::size_t theMaxQueued,
+                             unsigned int theBulkThreads,
+                             std::size_t theBulkMaxQueued)
+    : itsMaxQueued(theMaxQueued), itsBulkThreads(theBulkThreads), itsBulkMaxQueued(theBulkMaxQueued)
+{
+  try
+  {
+    if (theThreads == 0)
+      throw Fmi::Exception(BCP, "Query executor must have at least one thread");
+
+    if ((theBulkThreads == 0) || (theBulkThreads > theThreads))
+      throw Fmi::Exception(BCP, "Query executor bulk threads must be between 1 and threads");
+
+    for (unsigned int i = 0; (i < theThreads); i++)
+      itsThreads.emplace_back([this] { run(); });
+  }
+  catch (...)
+  {
+    shutdown();
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Destructor
+ */
+// ----------------------------------------------------------------------
+
+QueryExecutor::~QueryExecutor()
+{
+  shutdown();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Queue a task
+ */
+// ----------------------------------------------------------------------
+
+bool QueryExecutor::submit(Task theTask, Priority thePriority)
+{
+  try
+  {
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+
+      bool bulk = (thePriority == Priority::Bulk);
+      auto &tasks = (bulk ? itsBulkTasks : itsTasks);
+
+      if (itsShutdown || (tasks.size() >= (bulk ? itsBulkMaxQueued : itsMaxQueued)))
+        return false;
+
+      tasks.push_back(std::move(theTask));
+    }
+
+    // Threads not allowed to take a bulk task may be waiting too
+
+    itsCondition.notify_all();
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stop the threads
+ *
+ *        Queued tasks are destroyed without running them; tasks must
+ *        report their own abandonment (e.g. by a broken promise)
+ */
+// ----------------------------------------------------------------------
+
+void QueryExecutor::shutdown()
+{
+  std::deque<Task> tasks;
+  std::deque<Task> bulkTasks;
+
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsShutdown = true;
+    tasks.swap(itsTasks);
+    bulkTasks.swap(itsBulkTasks);
+  }
+
+  itsCondition.notify_all();
+
+  for (auto &thread : itsThreads)
+    if (thread.joinable())
+      thread.join();
+}
+
+std::size_t QueryExecutor::queued(Priority thePriority) const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return (thePriority == Priority::Bulk ? itsBulkTasks.size() : itsTasks.size());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if a free thread can take a task; called with the mutex locked
+ */
+// ----------------------------------------------------------------------
+
+bool QueryExecutor::hasRunnableTask() const
+{
+  return (!itsTasks.empty() || (!itsBulkTasks.empty() && (itsRunningBulkTasks < itsBulkThreads)));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Thread main loop
+ */
+// ----------------------------------------------------------------------
+
+void QueryExecutor::run()
+{
+  while (true)
+  {
+    Task task;
+    bool bulk = false;
+
+    {
+      std::unique_lock<std::mutex> lock(itsMutex);
+      itsCondition.wait(lock, [this] { return (itsShutdown || hasRunnableTask()); });
+
+      if (itsShutdown)
+        return;
+
+      // Operational tasks have strict priority
+
+      bulk = itsTasks.empty();
+      auto &tasks = (bulk ? itsBulkTasks : itsTasks);
+
+      task = std::move(tasks.front());
+      tasks.pop_front();
+
+      if (bulk)
+        itsRunningBulkTasks++;
+    }
+
+    try
+    {
+      task();
+    }
+    catch (...)
+    {
+      Fmi::Exception exception(BCP, "Query task failed!", nullptr);
+      exception.printError();
+    }
+
+    if (bulk)
+    {
+      {
+        std::lock_guard<std::mutex> lock(itsMutex);
+        itsRunningBulkTasks--;
+      }
+
+      itsCondition.notify_all();
+    }
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,84 @@
+// ======================================================================
+/*!
+ * \brief Bounded thread pool executing queries by priority
+ *
+ * Database queries and output formatting are run by the pool's threads,
+ * which bounds the number of concurrently executing queries, while the
+ * server thread handling the request waits for the result. Tasks are
+ * rejected when the queue is full.
+ *
+ * Operational and bulk queries have separate queues. Free threads take
+ * operational tasks first, and bulk tasks are run by at most a limited
+ * number of threads, so that the rest of the threads are reserved for
+ * operational queries.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class QueryExecutor
+{
+ public:
+  using Task = std::function<void()>;
+
+  enum class Priority
+  {
+    Operational,
+    Bulk
+  };
+
+  QueryExecutor(unsigned int theThreads,
+                std::size_t theMaxQueued,
+                unsigned int theBulkThreads,
+                std::size_t theBulkMaxQueued);
+  ~QueryExecutor();
+  QueryExecutor() = delete;
+  QueryExecutor(const QueryExecutor &other) = delete;
+  QueryExecutor &operator=(const QueryExecutor &other) = delete;
+
+  // Returns false if the queue is full or the executor has been shut down
+
+  bool submit(Task theTask, Priority thePriority = Priority::Operational);
+
+  // Discards queued tasks and waits for running tasks to complete
+
+  void shutdown();
+
+  std::size_t queued(Priority thePriority = Priority::Operational) const;
+
+ private:
+  void run();
+  bool hasRunnableTask() const;
+
+  const std::size_t itsMaxQueued;
+  const unsigned int itsBulkThreads;
+  const std::size_t itsBulkMaxQueued;
+
+  mutable std::mutex itsMutex;
+  std::condition_variable itsCondition;
+  std::deque<Task> itsTasks;
+  std::deque<Task> itsBulkTasks;
+  unsigned int itsRunningBulkTasks = 0;
+  std::vector<std::thread> itsThreads;
+  bool itsShutdown = false;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -8,11 +8,13 @@ class QueryLimits
   QueryLimits(int maxMessageStations = -1,
               int maxMessages = -1,
               int maxMessageTimeRangeDays = -1,
-              bool allowMultipleLocationOptions = false)
+              bool allowMultipleLocationOptions = false,
+              unsigned long long maxResultBytes = 0)
       : itsMaxMessageStations(maxMessageStations),
         itsMaxMessages(maxMessages),
         itsMaxMessageTimeRangeDays(maxMessageTimeRangeDays),
-        itsAllowMultipleLocationOptions(allowMultipleLocationOptions)
+        itsAllowMultipleLocationOptions(allowMultipleLocationOptions),
+        itsMaxResultBytes(maxResultBytes)
   {
   }
 
@@ -30,10 +32,19 @@ class QueryLimits
     itsAllowMultipleLocationOptions = allowMultipleLocationOptions;
   }
   bool getAllowMultipleLocationOptions() const { return itsAllowMultipleLocationOptions; }
+  void setMaxResultBytes(unsigned long long maxResultBytes) { itsMaxResultBytes = maxResultBytes; }
+  unsigned long long getMaxResultBytes() const { return itsMaxResultBytes; }
+  void setDeadline(unsigned int deadline) { itsDeadline = deadline; }
+  unsigned int getDeadline() const { return itsDeadline; }
+  void setBulkQueries(bool bulkQueries) { itsBulkQueries = bulkQueries; }
+  bool getBulkQueries() const { return itsBulkQueries; }
 
  private:
   int itsMaxMessageStations;
   int itsMaxMessages;
   int itsMaxMessageTimeRangeDays;
   bool itsAllowMultipleLocationOptions;
+  unsigned long long itsMaxResultBytes;
+  unsigned int itsDeadline = 0;
+  bool itsBulkQueries = false;
 };
@@ -0,0 +1,106 @@
+// ======================================================================
+
+#include "RequestArena.h"
+#include <macgyver/DateTime.h>
+#include <atomic>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+// First arena block; the following blocks grow geometrically. Blocks are
+// returned to the heap when the request completes
+
+const std::size_t initialBlockSize = 16 * 1024;
+
+// Statistics of all arenas
+
+const Fmi::DateTime startTime = Fmi::SecondClock::universal_time();
+std::atomic<std::size_t> requests{0};
+std::atomic<std::size_t> totalBytes{0};
+std::atomic<std::size_t> largestBytes{0};
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+RequestArena::RequestArena() : itsArena(initialBlockSize) {}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Destructor; the request's allocations are added to the statistics
+ */
+// ----------------------------------------------------------------------
+
+RequestArena::~RequestArena()
+{
+  requests++;
+  totalBytes += itsBytesAllocated;
+
+  auto largest = largestBytes.load();
+
+  while ((itsBytesAllocated > largest) &&
+         !largestBytes.compare_exchange_weak(largest, itsBytesAllocated))
+  {
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Statistics of released arenas
+ */
+// ----------------------------------------------------------------------
+
+Fmi::Cache::CacheStats RequestArena::statistics()
+{
+  Fmi::Cache::CacheStats stats;
+  stats.starttime = startTime;
+  stats.inserts = requests;
+  stats.size = totalBytes;
+  stats.maxsize = largestBytes;
+
+  return stats;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Allocate from the arena
+ */
+// ----------------------------------------------------------------------
+
+void *RequestArena::do_allocate(std::size_t theBytes, std::size_t theAlignment)
+{
+  void *ptr = itsArena.allocate(theBytes, theAlignment);
+  itsBytesAllocated += theBytes;
+  return ptr;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Memory is released when the arena is destroyed
+ */
+// ----------------------------------------------------------------------
+
+void RequestArena::do_deallocate(void * /* thePtr */,
+                                 std::size_t /* theBytes */,
+                                 std::size_t /* theAlignment */)
+{
+}
+
+bool RequestArena::do_is_equal(const std::pmr::memory_resource &theOther) const noexcept
+{
+  return (this == &theOther);
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,55 @@
+// ======================================================================
+/*!
+ * \brief Per-request monotonic memory arena
+ *
+ * The plugin's own temporary structures built while executing a request
+ * (column and row indexes, cursor, row selection and aggregation
+ * temporaries) are allocated from the arena and released all at once
+ * when the request completes. Engine results, formatter tables and the
+ * output use the engine's and server's own allocations.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <macgyver/Cache.h>
+#include <cstddef>
+#include <memory_resource>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class RequestArena : public std::pmr::memory_resource
+{
+ public:
+  RequestArena();
+  ~RequestArena() override;
+  RequestArena(const RequestArena &other) = delete;
+  RequestArena &operator=(const RequestArena &other) = delete;
+
+  // Bytes allocated from the arena by the request
+
+  std::size_t bytesAllocated() const { return itsBytesAllocated; }
+
+  // Statistics of released arenas: inserts is the number of requests, size the total
+  // and maxsize the largest number of bytes allocated by a request
+
+  static Fmi::Cache::CacheStats statistics();
+
+ private:
+  void *do_allocate(std::size_t theBytes, std::size_t theAlignment) override;
+  void do_deallocate(void *thePtr, std::size_t theBytes, std::size_t theAlignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &theOther) const noexcept override;
+
+  std::pmr::monotonic_buffer_resource itsArena;
+  std::size_t itsBytesAllocated = 0;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,78 @@
+// ======================================================================
+
+#include "ResultBudget.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+// Approximate formatted size of numeric and time values
+
+const std::size_t fixedValueSize = 16;
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add size of the values
+ */
+// ----------------------------------------------------------------------
+
+void ResultBudget::add(const SmartMet::Engine::Avi::ValueVector &theValues)
+{
+  try
+  {
+    std::size_t bytes = 0;
+
+    for (const auto &value : theValues)
+    {
+      if (const auto *str = std::get_if<std::string>(&value))
+        bytes += str->size();
+      else
+        bytes += fixedValueSize;
+    }
+
+    add(bytes);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add bytes; throws if the budget is exceeded
+ */
+// ----------------------------------------------------------------------
+
+void ResultBudget::add(std::size_t theBytes)
+{
+  itsBytes += theBytes;
+  check(itsBytes, itsMaxBytes);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check size against the maximum; zero maximum is unlimited
+ */
+// ----------------------------------------------------------------------
+
+void ResultBudget::check(std::size_t theBytes, std::size_t theMaxBytes)
+{
+  if ((theMaxBytes > 0) && (theBytes > theMaxBytes))
+    throw Fmi::Exception(BCP,
+                         "Result too large, maximum is " + Fmi::to_string(theMaxBytes) +
+                             " bytes; use shorter time range, fewer stations or parameters");
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,51 @@
+// ======================================================================
+/*!
+ * \brief Result size budget of a request
+ *
+ * The approximate size of the values filled into the output table is
+ * accumulated while the table is built. Exceeding the budget fails the
+ * request before the table is formatted. The engine result has already
+ * been materialized at that point; it is bounded by the row limit only.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+
+#include <cstddef>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class ResultBudget
+{
+ public:
+  // Zero budget is unlimited
+
+  explicit ResultBudget(std::size_t theMaxBytes) : itsMaxBytes(theMaxBytes) {}
+  ResultBudget() = delete;
+
+  void add(const SmartMet::Engine::Avi::ValueVector &theValues);
+  void add(std::size_t theBytes);
+
+  // Throws if the size exceeds the (nonzero) maximum
+
+  static void check(std::size_t theBytes, std::size_t theMaxBytes);
+
+  std::size_t bytes() const { return itsBytes; }
+  std::size_t maxBytes() const { return itsMaxBytes; }
+
+ private:
+  const std::size_t itsMaxBytes;
+  std::size_t itsBytes = 0;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,36 @@
+// ======================================================================
+/*!
+ * \brief Interface of output formats written in chunks
+ *
+ * Chunked formats are written directly from the result columns, so that
+ * the response can be sent while the rest of the result is formatted.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class ResultWriter
+{
+ public:
+  virtual ~ResultWriter() = default;
+
+  // Append output until at least theMinBytes have been appended; returns false
+  // when all output has been written
+
+  virtual bool write(std::string &theOutput, std::size_t theMinBytes) = 0;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
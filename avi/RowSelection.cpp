@@ -0,0 +1,219 @@
+// ======================================================================
+
+#include "RowSelection.h"
+#include "Utils.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+// Rows without message time sort before all others
+
+const std::int64_t noTime = std::numeric_limits<std::int64_t>::min();
+
+std::int64_t floorDiv(std::int64_t theValue, std::int64_t theDivisor)
+{
+  auto quotient = theValue / theDivisor;
+  return (((theValue % theDivisor) < 0) ? quotient - 1 : quotient);
+}
+
+}  // anonymous namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+RowSelection::RowSelection(std::size_t theLatestCount, std::int64_t theSampleInterval)
+    : itsLatestCount(theLatestCount), itsSampleInterval(theSampleInterval)
+{
+  try
+  {
+    if (itsSampleInterval < 0)
+      throw Fmi::Exception(BCP, "Sampling interval can't be negative");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse sampling interval
+ */
+// ----------------------------------------------------------------------
+
+std::int64_t RowSelection::parseInterval(const std::string &theValue)
+{
+  try
+  {
+    std::size_t end = 0;
+    long long value = -1;
+
+    try
+    {
+      value = std::stoll(theValue, &end);
+    }
+    catch (...)
+    {
+    }
+
+    auto unit = Fmi::ascii_tolower_copy(theValue.substr(end));
+    std::int64_t seconds = 0;
+
+    if (unit == "s")
+      seconds = 1;
+    else if (unit.empty() || (unit == "m") || (unit == "min"))
+      seconds = 60;
+    else if (unit == "h")
+      seconds = 3600;
+    else if (unit == "d")
+      seconds = 86400;
+
+    if ((value <= 0) || (seconds == 0) || (value > (365 * 86400) / seconds))
+      throw Fmi::Exception(BCP, "Invalid sampling interval '" + theValue + "'");
+
+    return value * seconds;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove messages not selected
+ *
+ *        Latest message of each interval is selected by hashing the rows by
+ *        interval; latest messages of a station are selected with partial
+ *        selection (nth_element) instead of sorting all rows
+ */
+// ----------------------------------------------------------------------
+
+void RowSelection::apply(SmartMet::Engine::Avi::StationQueryData &theStationData,
+                         std::pmr::memory_resource *theArena) const
+{
+  try
+  {
+    if ((itsLatestCount == 0) && (itsSampleInterval == 0))
+      return;
+
+    SmartMet::Engine::Avi::StationIdList stationIds;
+
+    for (auto stationId : theStationData.itsStationIds)
+    {
+      auto &values = theStationData.itsValues[stationId];
+      const auto &timeValues = values["messagetime"];
+
+      const auto nRows = timeValues.size();
+
+      if ((itsSampleInterval == 0) && (nRows <= itsLatestCount))
+      {
+        stationIds.push_back(stationId);
+        continue;
+      }
+
+      // Message times in seconds since epoch
+
+      std::pmr::vector<std::int64_t> times(theArena);
+      std::pmr::vector<std::size_t> rows(theArena);
+
+      times.reserve(nRows);
+
+      for (std::size_t row = 0; (row < nRows); row++)
+      {
+        auto t = timeValue(timeValues[row]);
+        times.push_back(t ? (*t - Fmi::epoch_time()).total_seconds() : noTime);
+      }
+
+      // Later message time (or later row on equal times) is preferred
+
+      auto isLater = [&times](std::size_t r1, std::size_t r2)
+      { return ((times[r1] != times[r2]) ? (times[r1] > times[r2]) : (r1 > r2)); };
+
+      if (itsSampleInterval > 0)
+      {
+        std::pmr::unordered_map<std::int64_t, std::size_t> intervals(theArena);
+
+        for (std::size_t row = 0; (row < nRows); row++)
+        {
+          if (times[row] == noTime)
+            continue;
+
+          auto pos = intervals.emplace(floorDiv(times[row], itsSampleInterval), row);
+
+          if (!pos.second && isLater(row, pos.first->second))
+            pos.first->second = row;
+        }
+
+        rows.reserve(intervals.size());
+
+        for (const auto &interval : intervals)
+          rows.push_back(interval.second);
+      }
+      else
+      {
+        rows.resize(nRows);
+
+        for (std::size_t row = 0; (row < nRows); row++)
+          rows[row] = row;
+      }
+
+      if ((itsLatestCount > 0) && (rows.size() > itsLatestCount))
+      {
+        std::nth_element(rows.begin(), rows.begin() + (itsLatestCount - 1), rows.end(), isLater);
+        rows.resize(itsLatestCount);
+      }
+
+      if (rows.empty())
+      {
+        theStationData.itsValues.erase(stationId);
+        continue;
+      }
+
+      std::sort(rows.begin(), rows.end());
+
+      for (auto &column : values)
+      {
+        if (column.second.size() != nRows)
+          continue;
+
+        std::remove_reference_t<decltype(column.second)> columnValues;
+        columnValues.reserve(rows.size());
+
+        for (auto row : rows)
+          columnValues.push_back(std::move(column.second[row]));
+
+        column.second.swap(columnValues);
+      }
+
+      stationIds.push_back(stationId);
+    }
+
+    theStationData.itsStationIds.swap(stationIds);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,58 @@
+// ======================================================================
+/*!
+ * \brief Selection of stations' latest and time sampled messages
+ *
+ * Keeps one message per station and sampling interval and/or the given
+ * number of latest messages of each station. Rows are selected in a
+ * single pass over the message times without sorting the result; the
+ * selected rows keep their original order.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class RowSelection
+{
+ public:
+  // Number of latest messages (0 for all) and sampling interval in seconds (0 for none)
+
+  RowSelection(std::size_t theLatestCount, std::int64_t theSampleInterval);
+  RowSelection() = delete;
+
+  // Parse sampling interval such as '30m', '1h' or '1d'; plain number is minutes
+
+  static std::int64_t parseInterval(const std::string &theValue);
+
+  std::size_t latestCount() const { return itsLatestCount; }
+  std::int64_t sampleInterval() const { return itsSampleInterval; }
+
+  // Remove messages not selected; within an interval the latest message is kept.
+  // Query result must contain 'messagetime' column. Temporary row indices are
+  // allocated from 'theArena'
+
+  void apply(SmartMet::Engine::Avi::StationQueryData &theStationData,
+             std::pmr::memory_resource *theArena = std::pmr::get_default_resource()) const;
+
+ private:
+  std::size_t itsLatestCount;
+  std::int64_t itsSampleInterval;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,814 @@
+// ======================================================================
+
+#include "StationIndex.h"
+#include "Parameters.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <numeric>
+#include <set>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+// Mean earth radius in meters
+
+const double earthRadius = 6371009.0;
+const double degToRad = M_PI / 180.0;
+const double radToDeg = 180.0 / M_PI;
+
+// Grid of 1x1 degree cells
+
+const int gridRows = 180;
+const int gridColumns = 360;
+
+int gridRow(double lat)
+{
+  return std::clamp(static_cast<int>(std::floor(lat + 90)), 0, gridRows - 1);
+}
+
+int gridColumn(double lon)
+{
+  int col = static_cast<int>(std::floor(lon + 180)) % gridColumns;
+  return (col < 0 ? col + gridColumns : col);
+}
+
+// Longitude difference wrapped to [-180,180]
+
+double lonDelta(double lon1, double lon2)
+{
+  double d = lon1 - lon2;
+
+  if (d > 180)
+    d -= 360;
+  else if (d < -180)
+    d += 360;
+
+  return d;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Minimal WKT parser for POINT, LINESTRING and POLYGON geometries
+ */
+// ----------------------------------------------------------------------
+
+class WKTParser
+{
+ public:
+  explicit WKTParser(const string &theWKT) : itsPos(theWKT.c_str()) {}
+
+  // Returns geometry type or empty string on error
+
+  string type()
+  {
+    skipSpace();
+
+    string name;
+
+    while (std::isalpha(static_cast<unsigned char>(*itsPos)))
+      name += static_cast<char>(std::toupper(static_cast<unsigned char>(*itsPos++)));
+
+    return name;
+  }
+
+  bool rings(vector<vector<pair<double, double>>> &theRings)
+  {
+    if (!expect('('))
+      return false;
+
+    do
+    {
+      theRings.emplace_back();
+
+      if (!ring(theRings.back()))
+        return false;
+    } while (accept(','));
+
+    return expect(')');
+  }
+
+  bool ring(vector<pair<double, double>> &theRing)
+  {
+    if (!expect('('))
+      return false;
+
+    do
+    {
+      double lon = 0;
+      double lat = 0;
+
+      if (!number(lon) || !number(lat))
+        return false;
+
+      if ((lon < -180) || (lon > 180) || (lat < -90) || (lat > 90))
+        return false;
+
+      theRing.emplace_back(lon, lat);
+    } while (accept(','));
+
+    return expect(')');
+  }
+
+  bool atEnd()
+  {
+    skipSpace();
+    return (*itsPos == '\0');
+  }
+
+ private:
+  void skipSpace()
+  {
+    while (std::isspace(static_cast<unsigned char>(*itsPos)))
+      itsPos++;
+  }
+
+  bool accept(char c)
+  {
+    skipSpace();
+
+    if (*itsPos != c)
+      return false;
+
+    itsPos++;
+    return true;
+  }
+
+  bool expect(char c) { return accept(c); }
+
+  bool number(double &theValue)
+  {
+    skipSpace();
+
+    char *end = nullptr;
+    theValue = std::strtod(itsPos, &end);
+
+    if (end == itsPos)
+      return false;
+
+    itsPos = end;
+    return true;
+  }
+
+  const char *itsPos;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if a line or ring crosses the antimeridian
+ *
+ *        Segments are taken as the shorter way around the globe; areas
+ *        given in lon/lat plane are not handled by the index across +-180
+ */
+// ----------------------------------------------------------------------
+
+bool crossesAntimeridian(const vector<pair<double, double>> &theRing)
+{
+  for (size_t i = 1; (i < theRing.size()); i++)
+    if (std::abs(theRing[i].first - theRing[i - 1].first) > 180)
+      return true;
+
+  return false;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Normalize wkt for cache key; uppercase, collapsed whitespace
+ *
+ *        '+' separating coordinates (unescaped url) is taken as whitespace
+ */
+// ----------------------------------------------------------------------
+
+string normalizeWKT(const string &theWKT)
+{
+  string key;
+  key.reserve(theWKT.size());
+  bool space = false;
+
+  for (auto c : theWKT)
+  {
+    if ((c == '+') && !key.empty() &&
+        (std::isdigit(static_cast<unsigned char>(key.back())) || (key.back() == '.')))
+      c = ' ';
+
+    if (std::isspace(static_cast<unsigned char>(c)))
+    {
+      space = true;
+      continue;
+    }
+
+    if ((c == ',') || (c == '(') || (c == ')'))
+      space = false;
+    else if (space && !key.empty() && (key.back() != ',') && (key.back() != '(') &&
+             (key.back() != ')'))
+      key += ' ';
+
+    space = false;
+    key += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  }
+
+  return key;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Point in ring test (lon/lat plane, ray casting)
+ */
+// ----------------------------------------------------------------------
+
+bool inRing(const vector<pair<double, double>> &theRing, double lon, double lat)
+{
+  bool inside = false;
+
+  for (size_t i = 0, j = theRing.size() - 1; (i < theRing.size()); j = i++)
+  {
+    const auto &pi = theRing[i];
+    const auto &pj = theRing[j];
+
+    if (((pi.second > lat) != (pj.second > lat)) &&
+        (lon < (pj.first - pi.first) * (lat - pi.second) / (pj.second - pi.second) + pi.first))
+      inside = !inside;
+  }
+
+  return inside;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the index
+ */
+// ----------------------------------------------------------------------
+
+StationIndex::StationIndex(vector<Station> theStations, size_t theCacheSize)
+    : itsCache(theCacheSize)
+{
+  try
+  {
+    // Sort the stations by grid cell (and by icao within the cell)
+
+    vector<int> cells;
+    cells.reserve(theStations.size());
+
+    for (const auto &station : theStations)
+      cells.push_back(gridRow(station.itsLat) * gridColumns + gridColumn(station.itsLon));
+
+    vector<size_t> order(theStations.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(),
+              order.end(),
+              [&](size_t a, size_t b)
+              {
+                if (cells[a] != cells[b])
+                  return cells[a] < cells[b];
+                return theStations[a].itsIcao < theStations[b].itsIcao;
+              });
+
+    itsIds.reserve(order.size());
+    itsIcaos.reserve(order.size());
+    itsLons.reserve(order.size());
+    itsLats.reserve(order.size());
+    itsCosLats.reserve(order.size());
+    itsCellStart.assign(gridRows * gridColumns + 1, 0);
+
+    for (auto i : order)
+    {
+      auto &station = theStations[i];
+
+      itsIds.push_back(station.itsId);
+      itsIcaos.push_back(std::move(station.itsIcao));
+      itsLons.push_back(station.itsLon * degToRad);
+      itsLats.push_back(station.itsLat * degToRad);
+      itsCosLats.push_back(std::cos(station.itsLat * degToRad));
+      itsCellStart[cells[i] + 1]++;
+    }
+
+    std::partial_sum(itsCellStart.begin(), itsCellStart.end(), itsCellStart.begin());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Visit stations in grid cells intersecting given lon/lat region
+ *
+ *        Longitudes may extend over +-180, the region is wrapped
+ */
+// ----------------------------------------------------------------------
+
+template <typename Visitor>
+void StationIndex::visitRegion(
+    double theWest, double theSouth, double theEast, double theNorth, Visitor &&theVisitor) const
+{
+  int firstRow = gridRow(theSouth);
+  int lastRow = gridRow(theNorth);
+  int nColumns = gridColumns;
+  int firstColumn = 0;
+
+  if ((theEast - theWest) < 360)
+  {
+    firstColumn = gridColumn(theWest);
+    nColumns = gridColumn(theEast) - firstColumn + 1;
+
+    if (nColumns <= 0)
+      nColumns += gridColumns;
+  }
+
+  for (int row = firstRow; (row <= lastRow); row++)
+    for (int n = 0; (n < nColumns); n++)
+    {
+      auto cell = row * gridColumns + ((firstColumn + n) % gridColumns);
+
+      for (auto i = itsCellStart[cell]; (i < itsCellStart[cell + 1]); i++)
+        theVisitor(i);
+    }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Great circle (haversine) distance in meters from station to lon/lat
+ */
+// ----------------------------------------------------------------------
+
+double StationIndex::distance(size_t theIndex, double theLon, double theLat) const
+{
+  double lat = theLat * degToRad;
+  double sinDLat = std::sin((lat - itsLats[theIndex]) / 2);
+  double sinDLon = std::sin((theLon * degToRad - itsLons[theIndex]) / 2);
+  double a = sinDLat * sinDLat + itsCosLats[theIndex] * std::cos(lat) * sinDLon * sinDLon;
+
+  return 2 * earthRadius * std::asin(std::min(1.0, std::sqrt(a)));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Distance in meters from station to a segment
+ *
+ *        The segment is projected to station's local equirectangular plane
+ */
+// ----------------------------------------------------------------------
+
+double StationIndex::segmentDistance(size_t theIndex,
+                                     const pair<double, double> &theStart,
+                                     const pair<double, double> &theEnd) const
+{
+  double lon = itsLons[theIndex] * radToDeg;
+  double lat = itsLats[theIndex] * radToDeg;
+  double xScale = earthRadius * degToRad * itsCosLats[theIndex];
+  double yScale = earthRadius * degToRad;
+
+  double ax = lonDelta(theStart.first, lon) * xScale;
+  double ay = (theStart.second - lat) * yScale;
+  double bx = lonDelta(theEnd.first, lon) * xScale;
+  double by = (theEnd.second - lat) * yScale;
+
+  double dx = bx - ax;
+  double dy = by - ay;
+  double len2 = dx * dx + dy * dy;
+  double t = (len2 > 0 ? std::clamp(-(ax * dx + ay * dy) / len2, 0.0, 1.0) : 0.0);
+
+  return std::hypot(ax + t * dx, ay + t * dy);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stations within bounding box or within given distance from it
+ */
+// ----------------------------------------------------------------------
+
+void StationIndex::bbox(double theWest,
+                        double theSouth,
+                        double theEast,
+                        double theNorth,
+                        double theMaxDistance,
+                        vector<size_t> &theResult) const
+{
+  try
+  {
+    vector<Ring> rings{{{theWest, theSouth},
+                        {theEast, theSouth},
+                        {theEast, theNorth},
+                        {theWest, theNorth},
+                        {theWest, theSouth}}};
+
+    polygon(rings, theMaxDistance, theResult);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Given number of nearest stations within given distance
+ */
+// ----------------------------------------------------------------------
+
+void StationIndex::nearest(double theLon,
+                           double theLat,
+                           double theMaxDistance,
+                           size_t theCount,
+                           vector<size_t> &theResult) const
+{
+  try
+  {
+    double dLat = theMaxDistance / earthRadius * radToDeg;
+    double maxLat = std::min(90.0, std::max(std::abs(theLat - dLat), std::abs(theLat + dLat)));
+    double dLon = (maxLat < 89.9 ? dLat / std::cos(maxLat * degToRad) : 360);
+
+    vector<pair<double, size_t>> candidates;
+
+    visitRegion(theLon - dLon,
+                theLat - dLat,
+                theLon + dLon,
+                theLat + dLat,
+                [&](size_t i)
+                {
+                  double d = distance(i, theLon, theLat);
+
+                  if (d <= theMaxDistance)
+                    candidates.emplace_back(d, i);
+                });
+
+    auto n = std::min(theCount, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end());
+
+    for (size_t i = 0; (i < n); i++)
+      theResult.push_back(candidates[i].second);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stations within given distance from a route
+ *
+ *        Stations are returned in route order; by the first near enough
+ *        segment and by distance from the segment's starting point
+ */
+// ----------------------------------------------------------------------
+
+void StationIndex::corridor(const Ring &theLine,
+                            double theMaxDistance,
+                            vector<size_t> &theResult) const
+{
+  double west = 180;
+  double east = -180;
+  double south = 90;
+  double north = -90;
+
+  for (const auto &p : theLine)
+  {
+    west = std::min(west, p.first);
+    east = std::max(east, p.first);
+    south = std::min(south, p.second);
+    north = std::max(north, p.second);
+  }
+
+  double dLat = theMaxDistance / earthRadius * radToDeg;
+  double maxLat = std::min(90.0, std::max(std::abs(south - dLat), std::abs(north + dLat)));
+  double dLon = (maxLat < 89.9 ? dLat / std::cos(maxLat * degToRad) : 360);
+
+  struct RoutePosition
+  {
+    size_t segment;
+    double distance;
+    size_t index;
+  };
+  vector<RoutePosition> positions;
+
+  visitRegion(west - dLon,
+              south - dLat,
+              east + dLon,
+              north + dLat,
+              [&](size_t i)
+              {
+                for (size_t s = 0; (s + 1 < theLine.size()); s++)
+                  if (segmentDistance(i, theLine[s], theLine[s + 1]) <= theMaxDistance)
+                  {
+                    positions.push_back({s, distance(i, theLine[s].first, theLine[s].second), i});
+                    return;
+                  }
+              });
+
+  std::sort(positions.begin(),
+            positions.end(),
+            [](const RoutePosition &a, const RoutePosition &b)
+            {
+              if (a.segment != b.segment)
+                return a.segment < b.segment;
+              return a.distance < b.distance;
+            });
+
+  for (const auto &position : positions)
+    theResult.push_back(position.index);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stations within polygon or within given distance from its boundary
+ */
+// ----------------------------------------------------------------------
+
+void StationIndex::polygon(const vector<Ring> &theRings,
+                           double theMaxDistance,
+                           vector<size_t> &theResult) const
+{
+  double west = 180;
+  double east = -180;
+  double south = 90;
+  double north = -90;
+
+  for (const auto &p : theRings.front())
+  {
+    west = std::min(west, p.first);
+    east = std::max(east, p.first);
+    south = std::min(south, p.second);
+    north = std::max(north, p.second);
+  }
+
+  double dLat = theMaxDistance / earthRadius * radToDeg;
+  double maxLat = std::min(90.0, std::max(std::abs(south - dLat), std::abs(north + dLat)));
+  double dLon = (maxLat < 89.9 ? dLat / std::cos(maxLat * degToRad) : 360);
+
+  visitRegion(west - dLon,
+              south - dLat,
+              east + dLon,
+              north + dLat,
+              [&](size_t i)
+              {
+                double lon = itsLons[i] * radToDeg;
+                double lat = itsLats[i] * radToDeg;
+                bool inside = inRing(theRings.front(), lon, lat);
+
+                for (size_t r = 1; (inside && (r < theRings.size())); r++)
+                  inside = !inRing(theRings[r], lon, lat);
+
+                for (size_t r = 0; (!inside && (r < theRings.size())); r++)
+                  for (size_t s = 0; (!inside && (s + 1 < theRings[r].size())); s++)
+                    inside = (segmentDistance(i, theRings[r][s], theRings[r][s + 1]) <=
+                              theMaxDistance);
+
+                if (inside)
+                  theResult.push_back(i);
+              });
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stations for POINT, LINESTRING or POLYGON wkt
+ *
+ *        Returns false if the wkt is not handled by the index
+ */
+// ----------------------------------------------------------------------
+
+bool StationIndex::wkt(const string &theWKT,
+                       double theMaxDistance,
+                       size_t theCount,
+                       vector<size_t> &theResult) const
+{
+  try
+  {
+    WKTParser parser(theWKT);
+    auto type = parser.type();
+    vector<Ring> rings;
+
+    if (type == "POINT")
+    {
+      rings.emplace_back();
+
+      if (!parser.ring(rings.back()) || (rings.back().size() != 1) || !parser.atEnd())
+        return false;
+
+      nearest(rings.back().front().first,
+              rings.back().front().second,
+              theMaxDistance,
+              theCount,
+              theResult);
+    }
+    else if (type == "LINESTRING")
+    {
+      rings.emplace_back();
+
+      if (!parser.ring(rings.back()) || (rings.back().size() < 2) || !parser.atEnd() ||
+          crossesAntimeridian(rings.back()))
+        return false;
+
+      corridor(rings.back(), theMaxDistance, theResult);
+    }
+    else if (type == "POLYGON")
+    {
+      if (!parser.rings(rings) || !parser.atEnd())
+        return false;
+
+      for (const auto &ring : rings)
+        if ((ring.size() < 4) || crossesAntimeridian(ring))
+          return false;
+
+      polygon(rings, theMaxDistance, theResult);
+    }
+    else
+      return false;
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if location options contain only types handled by the index
+ */
+// ----------------------------------------------------------------------
+
+bool StationIndex::resolvable(const SmartMet::Engine::Avi::LocationOptions &theOptions)
+{
+  return (theOptions.itsIcaos.empty() && theOptions.itsCountries.empty() &&
+          theOptions.itsPlaces.empty() && theOptions.itsStationIds.empty() &&
+          !(theOptions.itsBBoxes.empty() && theOptions.itsLonLats.empty() &&
+            theOptions.itsWKTs.itsWKTs.empty()));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if the index resolves the locations of a query as the engine
+ *
+ *        The index contains stations valid at current time, thus only latest
+ *        message queries at current time can use it.
+ *
+ *        When querying nearest stations for other message types than AWSMETAR,
+ *        the engine does not consider AWS stations unless only station metadata
+ *        is queried. AWS stations are not known by the index, such queries are
+ *        passed to the engine
+ */
+// ----------------------------------------------------------------------
+
+bool StationIndex::resolvable(const SmartMet::Engine::Avi::QueryOptions &theOptions)
+{
+  const auto &locationOptions = theOptions.itsLocationOptions;
+
+  if ((theOptions.itsValidity != SmartMet::Engine::Avi::Validity::Accepted) ||
+      (theOptions.itsTimeOptions.itsObservationTime != "current_timestamp") ||
+      !resolvable(locationOptions))
+    return false;
+
+  bool nearest = !locationOptions.itsLonLats.empty();
+
+  for (const auto &wkt : locationOptions.itsWKTs.itsWKTs)
+  {
+    WKTParser parser(wkt);
+    nearest = (nearest || (parser.type() == "POINT"));
+  }
+
+  if (!nearest)
+    return true;
+
+  const auto &messageTypes = theOptions.itsMessageTypes;
+
+  if ((messageTypes.size() == 1) && (messageTypes.front() == "AWSMETAR"))
+    return true;
+
+  for (const auto &param : theOptions.itsParameters)
+  {
+    auto id = Parameters::find(param);
+
+    if (!id || !Parameters::isStationParameter(*id))
+      return false;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if location is a route (single LINESTRING wkt)
+ */
+// ----------------------------------------------------------------------
+
+bool StationIndex::isRoute(const SmartMet::Engine::Avi::LocationOptions &theOptions)
+{
+  if ((theOptions.itsWKTs.itsWKTs.size() != 1) || !theOptions.itsBBoxes.empty() ||
+      !theOptions.itsLonLats.empty())
+    return false;
+
+  string wkt = theOptions.itsWKTs.itsWKTs.front();
+  WKTParser parser(wkt);
+
+  return (parser.type() == "LINESTRING");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Resolve location options to station id list
+ *
+ *        Route stations are returned in route order, otherwise in icao order
+ */
+// ----------------------------------------------------------------------
+
+StationIndex::StationIdListPtr StationIndex::resolve(
+    const SmartMet::Engine::Avi::LocationOptions &theOptions) const
+{
+  try
+  {
+    if (!resolvable(theOptions))
+      return nullptr;
+
+    // Bboxes crossing the antimeridian (west > east) are not handled
+
+    for (const auto &bbox : theOptions.itsBBoxes)
+      if (bbox.itsWest > bbox.itsEast)
+        return nullptr;
+
+    string key;
+
+    for (const auto &bbox : theOptions.itsBBoxes)
+      key += "B:" + Fmi::to_string(bbox.itsWest) + "," + Fmi::to_string(bbox.itsSouth) + "," +
+             Fmi::to_string(bbox.itsEast) + "," + Fmi::to_string(bbox.itsNorth) + ";";
+
+    for (const auto &lonlat : theOptions.itsLonLats)
+      key += "P:" + Fmi::to_string(lonlat.itsLon) + "," + Fmi::to_string(lonlat.itsLat) + ";";
+
+    for (const auto &wkt : theOptions.itsWKTs.itsWKTs)
+      key += "W:" + normalizeWKT(wkt) + ";";
+
+    key += "D:" + Fmi::to_string(theOptions.itsMaxDistance) +
+           ";N:" + Fmi::to_string(theOptions.itsNumberOfNearestStations);
+
+    auto cached = itsCache.find(key);
+
+    if (cached)
+      return *cached;
+
+    vector<size_t> indices;
+    double maxDistance = theOptions.itsMaxDistance;
+
+    for (const auto &bbox : theOptions.itsBBoxes)
+      this->bbox(bbox.itsWest, bbox.itsSouth, bbox.itsEast, bbox.itsNorth, maxDistance, indices);
+
+    for (const auto &lonlat : theOptions.itsLonLats)
+      nearest(lonlat.itsLon,
+              lonlat.itsLat,
+              maxDistance,
+              theOptions.itsNumberOfNearestStations,
+              indices);
+
+    for (const auto &wkt : theOptions.itsWKTs.itsWKTs)
+      if (!this->wkt(wkt, maxDistance, theOptions.itsNumberOfNearestStations, indices))
+        return nullptr;
+
+    // Remove duplicates keeping the first occurrence
+
+    vector<size_t> unique;
+    set<size_t> seen;
+
+    for (auto i : indices)
+      if (seen.insert(i).second)
+        unique.push_back(i);
+
+    if (!isRoute(theOptions))
+      std::sort(unique.begin(),
+                unique.end(),
+                [this](size_t a, size_t b) { return itsIcaos[a] < itsIcaos[b]; });
+
+    auto stationIds = std::make_shared<SmartMet::Engine::Avi::StationIdList>();
+
+    for (auto i : unique)
+      stationIds->push_back(itsIds[i]);
+
+    StationIdListPtr result(stationIds);
+    itsCache.insert(key, result);
+
+    return result;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,120 @@
+// ======================================================================
+/*!
+ * \brief In-memory spatial index of avi stations
+ *
+ * Resolves bbox, nearest station, POINT, LINESTRING and POLYGON wkt
+ * location options to station id lists without a database round trip.
+ * Stations are stored sorted by 1x1 degree grid cell so that the
+ * coordinates of each cell are contiguous for the distance loops.
+ *
+ * The index contains the stations valid at load time and does not know
+ * which stations are AWS stations. Queries the index can not resolve as
+ * the engine would (other times, nearest station queries for messages,
+ * areas crossing the antimeridian) are passed to the engine.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+#include <macgyver/Cache.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class StationIndex
+{
+ public:
+  struct Station
+  {
+    SmartMet::Engine::Avi::StationIdType itsId;
+    std::string itsIcao;
+    double itsLon;
+    double itsLat;
+  };
+
+  using StationIdListPtr = std::shared_ptr<const SmartMet::Engine::Avi::StationIdList>;
+
+  StationIndex(std::vector<Station> theStations, std::size_t theCacheSize);
+  StationIndex() = delete;
+  StationIndex(const StationIndex &other) = delete;
+  StationIndex &operator=(const StationIndex &other) = delete;
+
+  std::size_t size() const { return itsIds.size(); }
+
+  // Returns nullptr if the options contain location types not handled by the index
+
+  StationIdListPtr resolve(const SmartMet::Engine::Avi::LocationOptions &theOptions) const;
+
+  static bool resolvable(const SmartMet::Engine::Avi::LocationOptions &theOptions);
+  static bool resolvable(const SmartMet::Engine::Avi::QueryOptions &theOptions);
+  static bool isRoute(const SmartMet::Engine::Avi::LocationOptions &theOptions);
+
+  Fmi::Cache::CacheStats getCacheStats() const { return itsCache.statistics(); }
+
+  // Individual searches; result station indices are appended to 'theResult'
+
+  void bbox(double theWest,
+            double theSouth,
+            double theEast,
+            double theNorth,
+            double theMaxDistance,
+            std::vector<std::size_t> &theResult) const;
+  void nearest(double theLon,
+               double theLat,
+               double theMaxDistance,
+               std::size_t theCount,
+               std::vector<std::size_t> &theResult) const;
+  bool wkt(const std::string &theWKT,
+           double theMaxDistance,
+           std::size_t theCount,
+           std::vector<std::size_t> &theResult) const;
+
+  SmartMet::Engine::Avi::StationIdType id(std::size_t theIndex) const { return itsIds[theIndex]; }
+  const std::string &icao(std::size_t theIndex) const { return itsIcaos[theIndex]; }
+
+ private:
+  using Ring = std::vector<std::pair<double, double>>;
+
+  template <typename Visitor>
+  void visitRegion(
+      double theWest, double theSouth, double theEast, double theNorth, Visitor &&theVisitor) const;
+
+  double distance(std::size_t theIndex, double theLon, double theLat) const;
+  double segmentDistance(std::size_t theIndex,
+                         const std::pair<double, double> &theStart,
+                         const std::pair<double, double> &theEnd) const;
+
+  void corridor(const Ring &theLine,
+                double theMaxDistance,
+                std::vector<std::size_t> &theResult) const;
+  void polygon(const std::vector<Ring> &theRings,
+               double theMaxDistance,
+               std::vector<std::size_t> &theResult) const;
+
+  // Station data sorted by grid cell, coordinates in radians
+
+  std::vector<SmartMet::Engine::Avi::StationIdType> itsIds;
+  std::vector<std::string> itsIcaos;
+  std::vector<double> itsLons;
+  std::vector<double> itsLats;
+  std::vector<double> itsCosLats;
+  std::vector<std::size_t> itsCellStart;
+
+  // Resolved station id lists by normalized location options
+
+  mutable Fmi::Cache::Cache<std::string, StationIdListPtr> itsCache;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,272 @@
+// ======================================================================
+
+#include "SubscriptionHub.h"
+#include "Utils.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Event stream of one subscriber
+ */
+// ----------------------------------------------------------------------
+
+class SubscriptionStream : public SmartMet::Spine::HTTP::ContentStreamer
+{
+ public:
+  SubscriptionStream(std::shared_ptr<SubscriptionHub> theHub,
+                     SubscriptionHub::Filter theFilter,
+                     std::uint64_t thePosition)
+      : itsHub(std::move(theHub)), itsFilter(std::move(theFilter)), itsPosition(thePosition)
+  {
+  }
+
+  ~SubscriptionStream() override { itsHub->unsubscribe(); }
+
+  SubscriptionStream(const SubscriptionStream &other) = delete;
+  SubscriptionStream &operator=(const SubscriptionStream &other) = delete;
+
+  // Returns matching events, or a comment line if none have been sent within the keepalive
+  // interval. Never waits: an empty chunk is returned when there is nothing to send, and
+  // the server asks for the next chunk later, so a subscriber does not occupy a thread
+
+  std::string getChunk() override
+  {
+    try
+    {
+      if (itsHub->isShutdown())
+      {
+        setStatus(StreamerStatus::EXIT_OK);
+        return "";
+      }
+
+      auto now = SubscriptionHub::Clock::now();
+
+      if (!itsStarted)
+      {
+        itsStarted = true;
+        itsLastSent = now;
+        return "retry: 5000\n\n";
+      }
+
+      auto nextId = itsHub->nextId();
+
+      // Skip events already overwritten if the subscriber has fallen behind
+
+      if (nextId - itsPosition > itsHub->bufferSize())
+        itsPosition = nextId - itsHub->bufferSize();
+
+      std::string chunk;
+
+      for (; (itsPosition < nextId); itsPosition++)
+      {
+        auto event = itsHub->event(itsPosition);
+
+        if (event && (event->itsId == itsPosition) && itsFilter.matches(*event))
+          chunk += event->itsFrame;
+      }
+
+      if (chunk.empty() && (now - itsLastSent >= itsHub->keepAliveInterval()))
+        chunk = ": keepalive\n\n";
+
+      if (!chunk.empty())
+        itsLastSent = now;
+
+      return chunk;
+    }
+    catch (...)
+    {
+      Fmi::Exception exception(BCP, "Subscription stream failed!", nullptr);
+      exception.printError();
+      setStatus(StreamerStatus::EXIT_ERROR);
+      return "";
+    }
+  }
+
+ private:
+  std::shared_ptr<SubscriptionHub> itsHub;
+  const SubscriptionHub::Filter itsFilter;
+  std::uint64_t itsPosition;
+  SubscriptionHub::Clock::time_point itsLastSent;
+  bool itsStarted = false;
+};
+
+}  // anonymous namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if event matches the filter
+ */
+// ----------------------------------------------------------------------
+
+bool SubscriptionHub::Filter::matches(const Event &theEvent) const
+{
+  if (!itsMessageTypes.empty() &&
+      (itsMessageTypes.find(theEvent.itsMessageType) == itsMessageTypes.end()))
+    return false;
+
+  if (itsMessageFilter && !itsMessageFilter->matches(theEvent.itsMessage))
+    return false;
+
+  if (itsStationIds.empty() && itsIcaos.empty())
+    return true;
+
+  return ((itsStationIds.find(theEvent.itsStationId) != itsStationIds.end()) ||
+          (itsIcaos.find(theEvent.itsIcao) != itsIcaos.end()));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+SubscriptionHub::SubscriptionHub(std::size_t theBufferSize,
+                                 unsigned int theKeepAliveInterval,
+                                 std::size_t theMaxSubscribers)
+    : itsKeepAliveInterval(theKeepAliveInterval),
+      itsMaxSubscribers(theMaxSubscribers),
+      itsEvents(std::max<std::size_t>(theBufferSize, 1))
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Render event frame
+ */
+// ----------------------------------------------------------------------
+
+std::string SubscriptionHub::frame(std::uint64_t theId, const MessageMonitor::Message &theMessage)
+{
+  try
+  {
+    std::string data;
+    data.reserve(theMessage.itsMessage.size() + 128);
+
+    data += "{\"stationid\":";
+    data += Fmi::to_string(theMessage.itsStationId);
+    data += ",\"icao\":";
+    appendJsonString(data, theMessage.itsIcao);
+    data += ",\"messagetype\":";
+    appendJsonString(data, theMessage.itsMessageType);
+    data += ",\"messageid\":";
+    data += Fmi::to_string(theMessage.itsMessageId);
+    data += ",\"messagetime\":";
+    appendJsonString(data, theMessage.itsMessageTime);
+    data += ",\"message\":";
+    appendJsonString(data, theMessage.itsMessage);
+    data += "}";
+
+    return "id: " + Fmi::to_string(theId) + "\nevent: message\ndata: " + data + "\n\n";
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Publish new messages
+ *
+ *        Each event is stored before the next id is advanced, thus readers
+ *        never see an id whose event is not yet stored
+ */
+// ----------------------------------------------------------------------
+
+void SubscriptionHub::publish(const MessageMonitor::Messages &theMessages)
+{
+  try
+  {
+    if (theMessages.empty())
+      return;
+
+    std::lock_guard<std::mutex> lock(itsPublishMutex);
+
+    auto id = itsNextId.load();
+
+    for (const auto &message : theMessages)
+    {
+      auto event = std::make_shared<Event>(Event{id,
+                                                 message.itsStationId,
+                                                 Fmi::ascii_toupper_copy(message.itsIcao),
+                                                 Fmi::ascii_toupper_copy(message.itsMessageType),
+                                                 message.itsMessage,
+                                                 frame(id, message)});
+
+      std::atomic_store(&itsEvents[id % itsEvents.size()], EventPtr(std::move(event)));
+      itsNextId.store(++id, std::memory_order_release);
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get event with given id; the event may have been overwritten by a later one
+ */
+// ----------------------------------------------------------------------
+
+SubscriptionHub::EventPtr SubscriptionHub::event(std::uint64_t theId) const
+{
+  return std::atomic_load(&itsEvents[theId % itsEvents.size()]);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create new subscription
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<SmartMet::Spine::HTTP::ContentStreamer> SubscriptionHub::subscribe(
+    Filter theFilter, std::optional<std::uint64_t> theLastEventId)
+{
+  try
+  {
+    if (++itsSubscribers > itsMaxSubscribers)
+    {
+      itsSubscribers--;
+      return nullptr;
+    }
+
+    auto position = nextId();
+
+    if (theLastEventId && (*theLastEventId < position) &&
+        (position - *theLastEventId <= itsEvents.size()))
+      position = *theLastEventId + 1;
+
+    return std::make_shared<SubscriptionStream>(shared_from_this(), std::move(theFilter), position);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stop all subscriptions
+ */
+// ----------------------------------------------------------------------
+
+void SubscriptionHub::shutdown()
+{
+  itsShutdown = true;
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
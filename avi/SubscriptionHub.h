@@ -0,0 +1,116 @@
+// ======================================================================
+/*!
+ * \brief Server-Sent Events fan-out of new messages
+ *
+ * New messages detected by the shared message monitor are published
+ * once into a fixed size ring of pre-rendered events. Each subscriber
+ * reads the ring from its own position and applies its own filter, so
+ * publishing does not depend on the number of subscribers and readers
+ * take no locks. Subscribers never wait for events; the server polls
+ * their streams, so a connected subscriber does not occupy a thread.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "MessageFilter.h"
+#include "MessageMonitor.h"
+#include <engines/avi/Engine.h>
+#include <spine/HTTP.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+class SubscriptionHub : public std::enable_shared_from_this<SubscriptionHub>
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Event
+  {
+    std::uint64_t itsId;
+    SmartMet::Engine::Avi::StationIdType itsStationId;
+    std::string itsIcao;
+    std::string itsMessageType;
+    std::string itsMessage;
+    std::string itsFrame;  // 'id:', 'event:' and 'data:' lines
+  };
+
+  using EventPtr = std::shared_ptr<const Event>;
+
+  // Subscriber's filter; empty sets match all
+
+  struct Filter
+  {
+    std::unordered_set<SmartMet::Engine::Avi::StationIdType> itsStationIds;
+    std::unordered_set<std::string> itsIcaos;
+    std::unordered_set<std::string> itsMessageTypes;
+    std::shared_ptr<const MessageFilter> itsMessageFilter;  // nullptr matches all
+
+    bool matches(const Event &theEvent) const;
+  };
+
+  SubscriptionHub(std::size_t theBufferSize,
+                  unsigned int theKeepAliveInterval,
+                  std::size_t theMaxSubscribers);
+  SubscriptionHub() = delete;
+  SubscriptionHub(const SubscriptionHub &other) = delete;
+  SubscriptionHub &operator=(const SubscriptionHub &other) = delete;
+
+  // Publish new messages; called by the message monitor (or test message source)
+
+  void publish(const MessageMonitor::Messages &theMessages);
+
+  // Returns nullptr if there are too many subscribers. Events after
+  // 'theLastEventId' are delivered if still buffered, otherwise only new events
+
+  std::shared_ptr<SmartMet::Spine::HTTP::ContentStreamer> subscribe(
+      Filter theFilter, std::optional<std::uint64_t> theLastEventId);
+
+  void shutdown();
+
+  // Event access for subscribers
+
+  std::uint64_t nextId() const { return itsNextId.load(std::memory_order_acquire); }
+  EventPtr event(std::uint64_t theId) const;
+  bool isShutdown() const { return itsShutdown.load(); }
+
+  std::size_t bufferSize() const { return itsEvents.size(); }
+  std::chrono::seconds keepAliveInterval() const { return itsKeepAliveInterval; }
+  std::size_t subscribers() const { return itsSubscribers.load(); }
+  void unsubscribe() { itsSubscribers--; }
+
+ private:
+  static std::string frame(std::uint64_t theId, const MessageMonitor::Message &theMessage);
+
+  const std::chrono::seconds itsKeepAliveInterval;
+  const std::size_t itsMaxSubscribers;
+
+  // Event with id N is stored in slot N % size; ids start from 1
+
+  std::vector<EventPtr> itsEvents;
+  std::atomic<std::uint64_t> itsNextId{1};
+  std::atomic<std::size_t> itsSubscribers{0};
+  std::atomic<bool> itsShutdown{false};
+
+  std::mutex itsPublishMutex;
+};
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,509 @@
+// ======================================================================
+
+#include "Tokenizer.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <cctype>
+#include <charconv>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace Tokenizer
+{
+namespace
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Option value for error messages; long lists are truncated
+ */
+// ----------------------------------------------------------------------
+
+std::string errorValue(std::string_view theList)
+{
+  const std::size_t maxLength = 100;
+
+  if (theList.size() <= maxLength)
+    return "'" + std::string(theList) + "'";
+
+  return "'" + std::string(theList.substr(0, maxLength)) + "...'";
+}
+
+Fmi::Exception emptyValue(const char *theOptionName,
+                          std::size_t thePosition,
+                          std::string_view theList)
+{
+  return Fmi::Exception(BCP,
+                        std::string("Empty value for option '") + theOptionName +
+                            "' at position " + Fmi::to_string(thePosition) + "; " +
+                            errorValue(theList));
+}
+
+Fmi::Exception invalidValue(const char *theOptionName,
+                            std::size_t thePosition,
+                            std::string_view theList)
+{
+  return Fmi::Exception(BCP,
+                        std::string("Invalid value for option '") + theOptionName +
+                            "' at position " + Fmi::to_string(thePosition) + "; " +
+                            errorValue(theList));
+}
+
+template <typename T>
+bool parseNumber(std::string_view theToken, T &theValue)
+{
+  if (!theToken.empty() && (theToken.front() == '+'))
+    theToken.remove_prefix(1);
+
+  auto result = std::from_chars(theToken.data(), theToken.data() + theToken.size(), theValue);
+
+  return ((result.ec == std::errc()) && (result.ptr == theToken.data() + theToken.size()));
+}
+
+unsigned int hexValue(char c)
+{
+  if ((c >= '0') && (c <= '9'))
+    return c - '0';
+  if ((c >= 'a') && (c <= 'f'))
+    return c - 'a' + 10;
+  if ((c >= 'A') && (c <= 'F'))
+    return c - 'A' + 10;
+
+  throw Fmi::Exception(BCP, "Invalid hexadecimal digit");
+}
+
+void appendUtf8(std::string &theOutput, unsigned int theCodePoint)
+{
+  if (theCodePoint < 0x80)
+    theOutput += static_cast<char>(theCodePoint);
+  else if (theCodePoint < 0x800)
+  {
+    theOutput += static_cast<char>(0xc0 | (theCodePoint >> 6));
+    theOutput += static_cast<char>(0x80 | (theCodePoint & 0x3f));
+  }
+  else if (theCodePoint < 0x10000)
+  {
+    theOutput += static_cast<char>(0xe0 | (theCodePoint >> 12));
+    theOutput += static_cast<char>(0x80 | ((theCodePoint >> 6) & 0x3f));
+    theOutput += static_cast<char>(0x80 | (theCodePoint & 0x3f));
+  }
+  else
+  {
+    theOutput += static_cast<char>(0xf0 | (theCodePoint >> 18));
+    theOutput += static_cast<char>(0x80 | ((theCodePoint >> 12) & 0x3f));
+    theOutput += static_cast<char>(0x80 | ((theCodePoint >> 6) & 0x3f));
+    theOutput += static_cast<char>(0x80 | (theCodePoint & 0x3f));
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Minimal JSON reader for flat request objects
+ */
+// ----------------------------------------------------------------------
+
+class JsonReader
+{
+ public:
+  explicit JsonReader(std::string_view theInput) : itsInput(theInput) {}
+
+  void skipSpace()
+  {
+    while ((itsPos < itsInput.size()) && std::isspace(static_cast<unsigned char>(itsInput[itsPos])))
+      itsPos++;
+  }
+
+  bool atEnd()
+  {
+    skipSpace();
+    return (itsPos >= itsInput.size());
+  }
+
+  char peek()
+  {
+    skipSpace();
+
+    if (itsPos >= itsInput.size())
+      throw error("Unexpected end of JSON");
+
+    return itsInput[itsPos];
+  }
+
+  void expect(char c)
+  {
+    if (peek() != c)
+      throw error(std::string("Expected '") + c + "' in JSON");
+
+    itsPos++;
+  }
+
+  bool accept(char c)
+  {
+    if (peek() != c)
+      return false;
+
+    itsPos++;
+    return true;
+  }
+
+  std::string string()
+  {
+    expect('"');
+
+    std::string value;
+    auto start = itsPos;
+
+    while (true)
+    {
+      if (itsPos >= itsInput.size())
+        throw error("Unterminated JSON string");
+
+      char c = itsInput[itsPos];
+
+      if (c == '"')
+        break;
+
+      if (c != '\\')
+      {
+        itsPos++;
+        continue;
+      }
+
+      value.append(itsInput.data() + start, itsPos - start);
+
+      if (++itsPos >= itsInput.size())
+        throw error("Unterminated JSON string");
+
+      switch (itsInput[itsPos++])
+      {
+        case '"':
+          value += '"';
+          break;
+        case '\\':
+          value += '\\';
+          break;
+        case '/':
+          value += '/';
+          break;
+        case 'b':
+          value += '\b';
+          break;
+        case 'f':
+          value += '\f';
+          break;
+        case 'n':
+          value += '\n';
+          break;
+        case 'r':
+          value += '\r';
+          break;
+        case 't':
+          value += '\t';
+          break;
+        case 'u':
+        {
+          if (itsPos + 4 > itsInput.size())
+            throw error("Invalid JSON string escape");
+
+          unsigned int codePoint = 0;
+
+          for (int i = 0; (i < 4); i++)
+            codePoint = (codePoint << 4) | hexValue(itsInput[itsPos++]);
+
+          appendUtf8(value, codePoint);
+          break;
+        }
+        default:
+          throw error("Invalid JSON string escape");
+      }
+
+      start = itsPos;
+    }
+
+    value.append(itsInput.data() + start, itsPos - start);
+    itsPos++;
+
+    return value;
+  }
+
+  // Number, true, false or null as such
+
+  std::string literal()
+  {
+    skipSpace();
+
+    auto start = itsPos;
+
+    while ((itsPos < itsInput.size()) && isLiteralChar(itsInput[itsPos]))
+      itsPos++;
+
+    if (itsPos == start)
+      throw error("Invalid JSON value");
+
+    return std::string(itsInput.substr(start, itsPos - start));
+  }
+
+  std::string scalar() { return ((peek() == '"') ? string() : literal()); }
+
+ private:
+  static bool isLiteralChar(char c)
+  {
+    return (std::isalnum(static_cast<unsigned char>(c)) || (c == '-') || (c == '+') ||
+            (c == '.'));
+  }
+
+  Fmi::Exception error(const std::string &theMessage) const
+  {
+    return Fmi::Exception(BCP, theMessage + " at offset " + Fmi::to_string(itsPos));
+  }
+
+  std::string_view itsInput;
+  std::size_t itsPos = 0;
+};
+
+}  // anonymous namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove leading and trailing whitespace
+ */
+// ----------------------------------------------------------------------
+
+std::string_view trim(std::string_view theValue)
+{
+  while (!theValue.empty() && std::isspace(static_cast<unsigned char>(theValue.front())))
+    theValue.remove_prefix(1);
+
+  while (!theValue.empty() && std::isspace(static_cast<unsigned char>(theValue.back())))
+    theValue.remove_suffix(1);
+
+  return theValue;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse comma separated values
+ */
+// ----------------------------------------------------------------------
+
+void parseValueList(std::string_view theList, const char *theOptionName, ValueList &theValues)
+{
+  try
+  {
+    forEachToken(theList,
+                 ',',
+                 [&](std::string_view value, std::size_t position)
+                 {
+                   if (value.empty())
+                     throw emptyValue(theOptionName, position, theList);
+
+                   theValues.push_back(value);
+                 });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse comma separated station ids
+ */
+// ----------------------------------------------------------------------
+
+void parseStationIdList(std::string_view theList,
+                        const char *theOptionName,
+                        StationIdList &theStationIds)
+{
+  try
+  {
+    forEachToken(theList,
+                 ',',
+                 [&](std::string_view token, std::size_t position)
+                 {
+                   if (token.empty())
+                     throw emptyValue(theOptionName, position, theList);
+
+                   SmartMet::Engine::Avi::StationIdType stationId = 0;
+
+                   if (!parseNumber(token, stationId))
+                     throw invalidValue(theOptionName, position, theList);
+
+                   theStationIds.push_back(stationId);
+                 });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse comma separated coordinates in lon,lat or lat,lon order
+ *
+ *        If 'theRequiredPairs' is nonzero, exactly that many pairs are expected
+ */
+// ----------------------------------------------------------------------
+
+void parseCoordinateList(std::string_view theList,
+                         const char *theOptionName,
+                         bool theLatLonOrder,
+                         std::size_t theRequiredPairs,
+                         LonLatList &theLonLats)
+{
+  try
+  {
+    std::size_t nValues = 0;
+    double first = 0;
+
+    forEachToken(theList,
+                 ',',
+                 [&](std::string_view token, std::size_t position)
+                 {
+                   if (token.empty())
+                     throw emptyValue(theOptionName, position, theList);
+
+                   double value = 0;
+                   nValues = position;
+
+                   if (!parseNumber(token, value))
+                     throw invalidValue(theOptionName, position, theList);
+
+                   bool isLon = (((position % 2) == 1) != theLatLonOrder);
+                   double limit = (isLon ? 180 : 90);
+
+                   if ((value < -limit) || (value > limit))
+                     throw Fmi::Exception(BCP,
+                                          std::string("Value in range [-") +
+                                              Fmi::to_string(static_cast<int>(limit)) + "," +
+                                              Fmi::to_string(static_cast<int>(limit)) +
+                                              "] expected for option '" + theOptionName +
+                                              "' at position " + Fmi::to_string(position) + "; " +
+                                              errorValue(theList));
+
+                   if ((position % 2) == 1)
+                     first = value;
+                   else if (theLatLonOrder)
+                     theLonLats.emplace_back(value, first);
+                   else
+                     theLonLats.emplace_back(first, value);
+                 });
+
+    if ((theRequiredPairs > 0) && (nValues != 2 * theRequiredPairs))
+      throw Fmi::Exception(BCP,
+                           Fmi::to_string(2 * theRequiredPairs) +
+                               " values required for option '" + theOptionName + "'; " +
+                               errorValue(theList));
+
+    if ((nValues % 2) != 0)
+      throw Fmi::Exception(BCP,
+                           std::string("Even number of values required for option '") +
+                               theOptionName + "'; " + errorValue(theList));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode url encoded value ('+' is a space)
+ */
+// ----------------------------------------------------------------------
+
+std::string urlDecode(std::string_view theValue)
+{
+  try
+  {
+    std::string value;
+    value.reserve(theValue.size());
+
+    for (std::size_t pos = 0; (pos < theValue.size()); pos++)
+    {
+      char c = theValue[pos];
+
+      if (c == '+')
+        value += ' ';
+      else if ((c == '%') && (pos + 2 < theValue.size()))
+      {
+        value +=
+            static_cast<char>((hexValue(theValue[pos + 1]) << 4) | hexValue(theValue[pos + 2]));
+        pos += 2;
+      }
+      else
+        value += c;
+    }
+
+    return value;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Invalid url encoded value");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse JSON object of request parameters
+ *
+ *        Member values can be strings, numbers, booleans or arrays of them
+ */
+// ----------------------------------------------------------------------
+
+void parseJsonObject(std::string_view theBody,
+                     std::vector<std::pair<std::string, std::string>> &theParameters)
+{
+  try
+  {
+    JsonReader reader(theBody);
+
+    reader.expect('{');
+
+    if (!reader.accept('}'))
+    {
+      do
+      {
+        auto name = reader.string();
+        reader.expect(':');
+
+        if (reader.accept('['))
+        {
+          if (!reader.accept(']'))
+          {
+            do
+              theParameters.emplace_back(name, reader.scalar());
+            while (reader.accept(','));
+
+            reader.expect(']');
+          }
+        }
+        else if (reader.peek() == '{')
+          throw Fmi::Exception(BCP, "Nested JSON objects are not supported");
+        else
+          theParameters.emplace_back(std::move(name), reader.scalar());
+      } while (reader.accept(','));
+
+      reader.expect('}');
+    }
+
+    if (!reader.atEnd())
+      throw Fmi::Exception(BCP, "Unexpected data after JSON object");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Invalid JSON request body");
+  }
+}
+
+}  // namespace Tokenizer
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
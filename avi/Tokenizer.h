@@ -0,0 +1,100 @@
+// ======================================================================
+/*!
+ * \brief Zero-copy tokenizing of option lists and POST request bodies
+ *
+ * Tokens are passed to callbacks as string_views into the input; values
+ * are validated in place and collected into contiguous vectors allocated
+ * from the caller's memory resource (typically a per-request arena).
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace Tokenizer
+{
+using LonLat = std::pair<double, double>;
+using ValueList = std::pmr::vector<std::string_view>;
+using StationIdList = std::pmr::vector<SmartMet::Engine::Avi::StationIdType>;
+using LonLatList = std::pmr::vector<LonLat>;
+
+std::string_view trim(std::string_view theValue);
+
+// Call 'theCallback(token, position)' for each separated and trimmed token
+
+template <typename Callback>
+void forEachToken(std::string_view theList, char theSeparator, Callback &&theCallback)
+{
+  std::size_t position = 1;
+
+  for (;;)
+  {
+    auto pos = theList.find(theSeparator);
+    theCallback(trim(theList.substr(0, pos)), position++);
+
+    if (pos == std::string_view::npos)
+      break;
+
+    theList.remove_prefix(pos + 1);
+  }
+}
+
+// Comma separated lists; empty values are errors. Returned values refer to 'theList'.
+// Coordinates are validated to be in range and returned as lon,lat pairs
+
+void parseValueList(std::string_view theList, const char *theOptionName, ValueList &theValues);
+void parseStationIdList(std::string_view theList,
+                        const char *theOptionName,
+                        StationIdList &theStationIds);
+void parseCoordinateList(std::string_view theList,
+                         const char *theOptionName,
+                         bool theLatLonOrder,
+                         std::size_t theRequiredPairs,
+                         LonLatList &theLonLats);
+
+// POST request bodies; 'theCallback(name, value)' is called for each decoded parameter.
+// JSON body must be an object; array values are passed as repeated parameters
+
+std::string urlDecode(std::string_view theValue);
+
+template <typename Callback>
+void forEachFormParameter(std::string_view theBody, Callback &&theCallback)
+{
+  forEachToken(theBody,
+               '&',
+               [&](std::string_view param, std::size_t /* position */)
+               {
+                 if (param.empty())
+                   return;
+
+                 auto pos = param.find('=');
+
+                 if (pos == std::string_view::npos)
+                   theCallback(urlDecode(param), std::string());
+                 else
+                   theCallback(urlDecode(param.substr(0, pos)), urlDecode(param.substr(pos + 1)));
+               });
+}
+
+void parseJsonObject(std::string_view theBody,
+                     std::vector<std::pair<std::string, std::string>> &theParameters);
+
+}  // namespace Tokenizer
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,187 @@
+// ======================================================================
+
+#include "Utils.h"
+#include <macgyver/DateTime.h>
+#include <macgyver/Exception.h>
+#include <macgyver/LocalDateTime.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get numeric value
+ */
+// ----------------------------------------------------------------------
+
+std::optional<double> numericValue(const TimeSeries::Value &theValue)
+{
+  if (const auto *d = std::get_if<double>(&theValue))
+    return *d;
+  if (const auto *i = std::get_if<int>(&theValue))
+    return *i;
+
+  return std::nullopt;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get string value
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::string> stringValue(const TimeSeries::Value &theValue)
+{
+  if (const auto *s = std::get_if<std::string>(&theValue))
+    return *s;
+
+  return std::nullopt;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get utc time value; time may also be given as a string
+ */
+// ----------------------------------------------------------------------
+
+std::optional<Fmi::DateTime> timeValue(const TimeSeries::Value &theValue)
+{
+  try
+  {
+    if (const auto *t = std::get_if<Fmi::LocalDateTime>(&theValue))
+      return t->utc_time();
+    if (const auto *s = std::get_if<std::string>(&theValue))
+      if (!s->empty())
+        return Fmi::TimeParser::parse(*s);
+
+    return std::nullopt;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Time range query option value
+ */
+// ----------------------------------------------------------------------
+
+std::string timestampOption(const Fmi::DateTime &theTime)
+{
+  return std::string("timestamptz '") + Fmi::to_iso_string(theTime) + "Z'";
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Number of rows in query result
+ */
+// ----------------------------------------------------------------------
+
+std::size_t rowCount(const SmartMet::Engine::Avi::StationQueryData &theStationData)
+{
+  try
+  {
+    std::size_t rows = 0;
+
+    for (auto stationId : theStationData.itsStationIds)
+    {
+      auto it = theStationData.itsValues.find(stationId);
+
+      if ((it != theStationData.itsValues.end()) && !it->second.empty())
+        rows += it->second.begin()->second.size();
+    }
+
+    return rows;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::size_t rowCount(const SmartMet::Engine::Avi::QueryData &theQueryData)
+{
+  return (theQueryData.itsValues.empty() ? 0 : theQueryData.itsValues.begin()->second.size());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Hexadecimal presentation of 64-bit value
+ */
+// ----------------------------------------------------------------------
+
+std::string hexString(std::uint64_t theValue)
+{
+  static const char *digits = "0123456789abcdef";
+  std::string hex(16, '0');
+
+  for (int i = 15; (i >= 0); i--, theValue >>= 4)
+    hex[i] = digits[theValue & 0xf];
+
+  return hex;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append JSON string literal to output
+ *
+ *        Runs of characters not needing escaping are appended at once
+ */
+// ----------------------------------------------------------------------
+
+void appendJsonString(std::string &theOutput, std::string_view theValue)
+{
+  static const char *hexDigits = "0123456789abcdef";
+
+  theOutput += '"';
+
+  std::size_t start = 0;
+
+  for (std::size_t pos = 0; (pos < theValue.size()); pos++)
+  {
+    auto c = static_cast<unsigned char>(theValue[pos]);
+
+    if ((c >= 0x20) && (c != '"') && (c != '\\'))
+      continue;
+
+    theOutput.append(theValue.data() + start, pos - start);
+    start = pos + 1;
+
+    switch (c)
+    {
+      case '"':
+        theOutput += "\\\"";
+        break;
+      case '\\':
+        theOutput += "\\\\";
+        break;
+      case '\n':
+        theOutput += "\\n";
+        break;
+      case '\r':
+        theOutput += "\\r";
+        break;
+      case '\t':
+        theOutput += "\\t";
+        break;
+      default:
+        theOutput += "\\u00";
+        theOutput += hexDigits[c >> 4];
+        theOutput += hexDigits[c & 0xf];
+    }
+  }
+
+  theOutput.append(theValue.data() + start, theValue.size() - start);
+  theOutput += '"';
+}
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,61 @@
+// ======================================================================
+/*!
+ * \brief Utility functions for engine query results
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/avi/Engine.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+std::optional<double> numericValue(const TimeSeries::Value &theValue);
+std::optional<std::string> stringValue(const TimeSeries::Value &theValue);
+std::optional<Fmi::DateTime> timeValue(const TimeSeries::Value &theValue);
+
+// Time range query option value (timestamptz literal)
+
+std::string timestampOption(const Fmi::DateTime &theTime);
+
+// Number of message (or station) rows in query result
+
+std::size_t rowCount(const SmartMet::Engine::Avi::StationQueryData &theStationData);
+std::size_t rowCount(const SmartMet::Engine::Avi::QueryData &theQueryData);
+
+// 64-bit FNV-1a hash and its hexadecimal presentation
+
+inline std::uint64_t hash64(std::string_view theData,
+                            std::uint64_t theSeed = 14695981039346656037ULL)
+{
+  std::uint64_t hash = theSeed;
+
+  for (auto c : theData)
+  {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+std::string hexString(std::uint64_t theValue);
+
+// Append JSON string literal (with quotes) to output
+
+void appendJsonString(std::string &theOutput, std::string_view theValue);
+
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
+
+// ======================================================================
@@ -31,7 +31,11 @@ BuildRequires: smartmet-engine-avi-devel >= 26.6.24
 BuildRequires: smartmet-engine-authentication-devel >= 26.6.24
 BuildRequires: bzip2-devel
 BuildRequires: zlib-devel
+BuildRequires: brotli-devel
+BuildRequires: libzstd-devel
 Requires: libconfig17
+Requires: brotli
+Requires: libzstd
 Requires: smartmet-library-macgyver >= 26.6.15
 Requires: smartmet-library-timeseries >= 26.5.5
 Requires: smartmet-library-spine >= 26.6.24
@@ -0,0 +1,132 @@
+// ======================================================================
+/*!
+ * \brief Query option parsing benchmark
+ *
+ * Parses the query strings of the test/input requests repeatedly and
+ * reports the time and the number of heap allocations per parse.
+ */
+// ======================================================================
+
+#include "Config.h"
+#include "Query.h"
+#include "Tokenizer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace SmartMet::Plugin::Avi;
+
+namespace
+{
+const int iterations = 1000;
+
+std::atomic<std::size_t> allocations{0};
+
+// Query strings of the test requests; 'GET\t/avi?<query> HTTP/1.0'
+
+std::vector<std::string> queryStrings()
+{
+  std::vector<std::string> queries;
+
+  for (const auto &entry : std::filesystem::directory_iterator("../input"))
+  {
+    if (entry.path().extension() != ".get")
+      continue;
+
+    std::ifstream in(entry.path());
+    std::string line;
+    std::getline(in, line);
+
+    auto start = line.find('?');
+    auto end = line.rfind(' ');
+
+    if ((start != std::string::npos) && (end != std::string::npos) && (end > start))
+      queries.push_back(line.substr(start + 1, end - start - 1));
+  }
+
+  return queries;
+}
+
+SmartMet::Spine::HTTP::Request makeRequest(const std::string &theQuery)
+{
+  SmartMet::Spine::HTTP::Request request;
+
+  Tokenizer::forEachFormParameter(theQuery,
+                                  [&](const std::string &name, const std::string &value)
+                                  {
+                                    if (!name.empty())
+                                      request.addParameter(name, value);
+                                  });
+
+  return request;
+}
+}  // namespace
+
+void *operator new(std::size_t theSize)
+{
+  allocations++;
+
+  if (void *ptr = std::malloc(theSize ? theSize : 1))
+    return ptr;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void *thePtr) noexcept
+{
+  std::free(thePtr);
+}
+
+void operator delete(void *thePtr, std::size_t /* theSize */) noexcept
+{
+  std::free(thePtr);
+}
+
+int main()
+{
+  std::unique_ptr<Config> config(new Config("../cnf/aviplugin.conf"));
+
+  std::vector<SmartMet::Spine::HTTP::Request> requests;
+
+  for (const auto &query : queryStrings())
+    requests.push_back(makeRequest(query));
+
+  // Requests failing validation are part of the corpus too
+
+  std::size_t count = 0;
+  std::size_t failed = 0;
+
+  allocations = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; (i < iterations); i++)
+    for (const auto &request : requests)
+    {
+      try
+      {
+        Query query(request, nullptr, config);
+      }
+      catch (...)
+      {
+        failed++;
+      }
+
+      count++;
+    }
+
+  auto end = std::chrono::steady_clock::now();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+  std::cout << "requests: " << requests.size() << " (" << (failed / iterations) << " failing)\n"
+            << "query parsing: " << (ns / static_cast<long>(count)) << " ns per request, "
+            << (allocations / count) << " allocations per request\n";
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+// ======================================================================
+/*!
+ * \brief Location list parsing benchmark
+ *
+ * Parses 10000 station icao and coordinate lists with the tokenizer and
+ * with the earlier boost::split + std::list approach.
+ */
+// ======================================================================
+
+#include "Tokenizer.h"
+
+#include <boost/algorithm/string.hpp>
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+using namespace SmartMet::Plugin::Avi;
+
+namespace
+{
+const std::size_t stationCount = 10000;
+const int iterations = 100;
+
+std::string icaoList()
+{
+  std::string list;
+
+  for (std::size_t i = 0; (i < stationCount); i++)
+  {
+    if (i > 0)
+      list += ',';
+
+    list += static_cast<char>('A' + (i / 1000) % 26);
+    list += static_cast<char>('A' + (i / 100) % 10);
+    list += static_cast<char>('0' + (i / 10) % 10);
+    list += static_cast<char>('0' + i % 10);
+  }
+
+  return list;
+}
+
+std::string coordinateList()
+{
+  std::string list;
+
+  for (std::size_t i = 0; (i < stationCount); i++)
+  {
+    if (i > 0)
+      list += ',';
+
+    list += std::to_string(-179.5 + static_cast<double>(i % 359)) + "," +
+            std::to_string(-89.5 + static_cast<double>(i % 179));
+  }
+
+  return list;
+}
+
+std::list<std::string> splitList(const std::string &theList)
+{
+  std::vector<std::string> flds;
+  boost::split(flds, theList, boost::is_any_of(","));
+
+  std::list<std::string> values;
+
+  for (auto &fld : flds)
+    values.push_back(boost::trim_copy(fld));
+
+  return values;
+}
+
+std::list<std::pair<double, double>> splitCoordinates(const std::string &theList)
+{
+  std::list<std::pair<double, double>> values;
+  auto flds = splitList(theList);
+
+  for (auto it = flds.begin(); (it != flds.end());)
+  {
+    auto lon = std::stod(*it++);
+    auto lat = std::stod(*it++);
+    values.emplace_back(lon, lat);
+  }
+
+  return values;
+}
+
+template <typename Function>
+void run(const char *theName, Function &&theFunction)
+{
+  auto start = std::chrono::steady_clock::now();
+  std::size_t count = 0;
+
+  for (int i = 0; (i < iterations); i++)
+    count += theFunction();
+
+  auto end = std::chrono::steady_clock::now();
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+  std::cout << theName << ": " << (us / iterations) << " us per list, "
+            << (1000 * us / static_cast<long>(count)) << " ns per value\n";
+}
+}  // namespace
+
+int main()
+{
+  auto icaos = icaoList();
+  auto coordinates = coordinateList();
+
+  run("icaos (split)", [&] { return splitList(icaos).size(); });
+  run("icaos (tokenizer)",
+      [&]
+      {
+        Tokenizer::ValueList values;
+        Tokenizer::parseValueList(icaos, "icaos", values);
+        return values.size();
+      });
+
+  run("lonlats (split)", [&] { return splitCoordinates(coordinates).size(); });
+  run("lonlats (tokenizer)",
+      [&]
+      {
+        Tokenizer::LonLatList values;
+        Tokenizer::parseCoordinateList(coordinates, "lonlats", false, 0, values);
+        return values.size();
+      });
+
+  return 0;
+}
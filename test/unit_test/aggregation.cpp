@@ -0,0 +1,138 @@
+#define BOOST_TEST_MODULE "AggregationClassModule"
+
+#include "Aggregation.h"
+
+#include <boost/test/included/unit_test.hpp>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+using Keys = std::vector<Aggregation::Key>;
+
+std::string messageTime(int minute)
+{
+  Fmi::DateTime t(Fmi::Date(2024, 1, 1), Fmi::TimeDuration(12, 0, 0));
+  return Fmi::to_iso_extended_string(t + Fmi::Minutes(minute)) + "Z";
+}
+
+std::string hourStart(int minute)
+{
+  return messageTime(minute - (minute % 60));
+}
+
+void addMessage(Engine::Avi::StationQueryData& data,
+                Engine::Avi::StationIdType stationId,
+                const std::string& icao,
+                const std::string& messageType,
+                int minute)
+{
+  auto& values = data.itsValues[stationId];
+  values["icao"].push_back(icao);
+  values["messagetype"].push_back(messageType);
+  values["messagetime"].push_back(messageTime(minute));
+}
+
+Engine::Avi::StationQueryData stationData()
+{
+  Engine::Avi::StationQueryData data;
+  data.itsColumns = {{Engine::Avi::ColumnType::String, "icao"},
+                     {Engine::Avi::ColumnType::String, "messagetype"},
+                     {Engine::Avi::ColumnType::DateTime, "messagetime"}};
+  data.itsStationIds = {1, 2};
+
+  addMessage(data, 1, "EFHK", "METAR", 0);
+  addMessage(data, 1, "EFHK", "SPECI", 10);
+  addMessage(data, 1, "EFHK", "METAR", 30);
+  addMessage(data, 1, "EFHK", "METAR", 60);
+  addMessage(data, 2, "EFRO", "METAR", 20);
+
+  return data;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(aggregation_groups)
+{
+  auto data = stationData();
+
+  Aggregation aggregation({{"icao", "icao", 0},
+                           {"messagetype", "messagetype", 0},
+                           {"hour", "messagetime", 3600}});
+  aggregation.apply(data);
+
+  // Groups in the order of their first row as a single station
+
+  BOOST_CHECK((data.itsStationIds == Engine::Avi::StationIdList{0}));
+  BOOST_REQUIRE_EQUAL(data.itsColumns.size(), 4);
+  BOOST_CHECK_EQUAL(data.itsColumns.back().itsName, "count");
+  BOOST_CHECK(data.itsColumns.front().itsType == Engine::Avi::ColumnType::String);
+
+  auto& values = data.itsValues[0];
+  const auto& counts = values["count"];
+  BOOST_REQUIRE_EQUAL(counts.size(), 4);
+  BOOST_CHECK_EQUAL(std::get<int>(counts[0]), 2);
+  BOOST_CHECK_EQUAL(std::get<int>(counts[1]), 1);
+  BOOST_CHECK_EQUAL(std::get<int>(counts[2]), 1);
+  BOOST_CHECK_EQUAL(std::get<int>(counts[3]), 1);
+
+  BOOST_CHECK_EQUAL(std::get<std::string>(values["messagetype"][1]), "SPECI");
+  BOOST_CHECK_EQUAL(std::get<std::string>(values["hour"][2]), hourStart(60));
+  BOOST_CHECK_EQUAL(std::get<std::string>(values["icao"][3]), "EFRO");
+  BOOST_CHECK_EQUAL(std::get<std::string>(values["hour"][3]), hourStart(20));
+}
+
+BOOST_AUTO_TEST_CASE(aggregation_total)
+{
+  // Without keys there is one row, also for an empty result
+
+  auto data = stationData();
+  Aggregation aggregation(Keys{});
+  aggregation.apply(data);
+
+  BOOST_REQUIRE_EQUAL(data.itsValues[0]["count"].size(), 1);
+  BOOST_CHECK_EQUAL(std::get<int>(data.itsValues[0]["count"][0]), 5);
+
+  Engine::Avi::StationQueryData empty;
+  aggregation.apply(empty);
+  BOOST_REQUIRE_EQUAL(empty.itsValues[0]["count"].size(), 1);
+  BOOST_CHECK_EQUAL(std::get<int>(empty.itsValues[0]["count"][0]), 0);
+
+  Engine::Avi::StationQueryData noGroups;
+  Aggregation(Keys{{"icao", "icao", 0}}).apply(noGroups);
+  BOOST_CHECK(noGroups.itsStationIds.empty());
+  BOOST_CHECK_EQUAL(noGroups.itsColumns.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(aggregation_rejected)
+{
+  Engine::Avi::QueryData data;
+  data.itsColumns = {{Engine::Avi::ColumnType::String, "messagerejectedicao"},
+                     {Engine::Avi::ColumnType::Integer, "messagerejectedreason"}};
+  data.itsValues["messagerejectedicao"] = {std::string("XXXX"), std::string("YYYY"),
+                                           std::string("XXXX"), TimeSeries::None()};
+  data.itsValues["messagerejectedreason"] = {1, 1, 2, 1};
+
+  Aggregation(Keys{{"icao", "messagerejectedicao", 0}}).apply(data);
+
+  BOOST_CHECK_EQUAL(data.itsColumns.front().itsName, "icao");
+  BOOST_CHECK_EQUAL(data.itsValues.count("messagerejectedreason"), 0);
+
+  const auto& counts = data.itsValues["count"];
+  BOOST_REQUIRE_EQUAL(counts.size(), 3);
+  BOOST_CHECK_EQUAL(std::get<int>(counts[0]), 2);
+  BOOST_CHECK_EQUAL(std::get<int>(counts[2]), 1);
+  BOOST_CHECK(std::holds_alternative<TimeSeries::None>(data.itsValues["icao"][2]));
+}
+
+BOOST_AUTO_TEST_CASE(aggregation_keys)
+{
+  BOOST_CHECK_THROW(Aggregation(Keys{{"icao", "icao", 0}, {"icao", "icao", 0}}), std::exception);
+  BOOST_CHECK_THROW(Aggregation(Keys{{"hour", "messagetime", -1}}), std::exception);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
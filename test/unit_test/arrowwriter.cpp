@@ -0,0 +1,203 @@
+#define BOOST_TEST_MODULE "ArrowWriterModule"
+
+#include "ArrowWriter.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+template <typename T>
+T read(const std::string &theData, std::size_t thePos)
+{
+  BOOST_REQUIRE(thePos + sizeof(T) <= theData.size());
+  T value;
+  std::memcpy(&value, theData.data() + thePos, sizeof(T));
+  return value;
+}
+
+struct Message
+{
+  std::uint8_t itsHeaderType;
+  std::int64_t itsBodyLength;
+};
+
+// Scalar field of the root (Message) table of flatbuffer metadata
+
+template <typename T>
+T rootField(const std::string &theMetadata, int theSlot)
+{
+  auto table = read<std::uint32_t>(theMetadata, 0);
+  auto vtable = table - read<std::int32_t>(theMetadata, table);
+  auto offset = read<std::uint16_t>(theMetadata, vtable + 4 + 2 * theSlot);
+  return (offset == 0 ? T(0) : read<T>(theMetadata, table + offset));
+}
+
+// Encapsulated messages of the stream; checks the end-of-stream marker
+
+std::vector<Message> messages(const std::string &theStream)
+{
+  std::vector<Message> result;
+  std::size_t pos = 0;
+
+  while (true)
+  {
+    BOOST_REQUIRE_EQUAL(read<std::uint32_t>(theStream, pos), 0xFFFFFFFF);
+    auto size = read<std::int32_t>(theStream, pos + 4);
+    pos += 8;
+
+    if (size == 0)
+      break;
+
+    BOOST_CHECK_EQUAL(size % 8, 0);
+
+    auto metadata = theStream.substr(pos, size);
+    Message message{rootField<std::uint8_t>(metadata, 1), rootField<std::int64_t>(metadata, 3)};
+    BOOST_CHECK_EQUAL(rootField<std::int16_t>(metadata, 0), 4);
+    BOOST_CHECK_EQUAL(message.itsBodyLength % 8, 0);
+
+    result.push_back(message);
+    pos += size + message.itsBodyLength;
+  }
+
+  BOOST_CHECK_EQUAL(pos, theStream.size());
+  return result;
+}
+
+std::vector<ArrowWriter::Field> fields()
+{
+  return {{"stationid", ArrowWriter::Type::Int64},
+          {"icao", ArrowWriter::Type::Utf8},
+          {"latitude", ArrowWriter::Type::Float64},
+          {"messagetime", ArrowWriter::Type::Timestamp}};
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(arrowwriter_empty)
+{
+  ArrowWriter writer(fields());
+  std::string out;
+  writer.finish(out);
+
+  auto result = messages(out);
+  BOOST_REQUIRE_EQUAL(result.size(), 1);
+  BOOST_CHECK_EQUAL(result[0].itsHeaderType, 1);
+  BOOST_CHECK_EQUAL(result[0].itsBodyLength, 0);
+}
+
+BOOST_AUTO_TEST_CASE(arrowwriter_batches)
+{
+  ArrowWriter writer(fields());
+  std::string out;
+
+  for (int batch = 0; (batch < 2); batch++)
+  {
+    for (int i = 0; (i < 3); i++)
+      writer.appendInt(0, 7 + i);
+
+    writer.appendString(1, "EFHK");
+    writer.appendNull(1);
+    writer.appendString(1, "EFRO");
+
+    for (int i = 0; (i < 3); i++)
+      writer.appendDouble(2, 60.3 + i);
+
+    writer.appendInt(3, 1700000000);
+    writer.appendInt(3, 1700003600);
+    writer.appendNull(3);
+
+    BOOST_CHECK_EQUAL(writer.rows(), 3);
+    BOOST_CHECK_EQUAL(writer.bytes(), 3 * 8 + 8 + 3 * 8 + 3 * 8);
+    writer.writeBatch(out);
+    BOOST_CHECK_EQUAL(writer.rows(), 0);
+  }
+
+  writer.finish(out);
+
+  // Schema and two record batches; validity, offsets and values of strings are in the body
+
+  auto result = messages(out);
+  BOOST_REQUIRE_EQUAL(result.size(), 3);
+  BOOST_CHECK_EQUAL(result[0].itsHeaderType, 1);
+  BOOST_CHECK_EQUAL(result[1].itsHeaderType, 3);
+  BOOST_CHECK_EQUAL(result[2].itsHeaderType, 3);
+  BOOST_CHECK_EQUAL(result[1].itsBodyLength, result[2].itsBodyLength);
+  BOOST_CHECK(out.find("EFHKEFRO") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(arrowwriter_errors)
+{
+  ArrowWriter writer(fields());
+  std::string out;
+
+  BOOST_CHECK_THROW(writer.appendString(0, "7"), std::exception);
+  BOOST_CHECK_THROW(writer.appendDouble(1, 1.0), std::exception);
+  BOOST_CHECK_THROW(writer.appendInt(4, 1), std::exception);
+
+  // Columns must have the same number of values
+
+  writer.appendInt(0, 7);
+  BOOST_CHECK_THROW(writer.writeBatch(out), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(arrowwriter_result_columns)
+{
+  // Two stations with 3 and 2 rows; the second station has no longitude values
+
+  Engine::Avi::Columns columns{{Engine::Avi::ColumnType::Integer, "stationid"},
+                               {Engine::Avi::ColumnType::String, "icao"},
+                               {Engine::Avi::ColumnType::Double, "longitude"}};
+
+  Engine::Avi::ValueVector ids1(3, 7);
+  Engine::Avi::ValueVector ids2(2, 22);
+  Engine::Avi::ValueVector icaos1(3, std::string("EFHK"));
+  Engine::Avi::ValueVector icaos2(2, std::string("EFRO"));
+  Engine::Avi::ValueVector lons1(3, 24.9);
+  Engine::Avi::ValueVector lons2;
+
+  ArrowWriter::ColumnValues values{&ids1, &ids2, &icaos1, &icaos2, &lons1, &lons2};
+
+  // A batch is written for each station when the minimum size is small
+
+  ArrowWriter writer(columns, values, 2);
+  std::string out;
+  int chunks = 0;
+
+  while (writer.write(out, 1))
+    chunks++;
+
+  BOOST_CHECK_EQUAL(chunks, 2);
+  BOOST_CHECK(!writer.write(out, 1));
+
+  auto result = messages(out);
+  BOOST_REQUIRE_EQUAL(result.size(), 3);
+  BOOST_CHECK_EQUAL(result[0].itsHeaderType, 1);
+  BOOST_CHECK_EQUAL(result[1].itsHeaderType, 3);
+  BOOST_CHECK_EQUAL(result[2].itsHeaderType, 3);
+
+  // All rows in one batch
+
+  ArrowWriter single(columns, values, 2);
+  std::string all;
+  BOOST_CHECK(!single.write(all, std::numeric_limits<std::size_t>::max()));
+  BOOST_CHECK_EQUAL(messages(all).size(), 2);
+  BOOST_CHECK(all.find("EFHKEFHKEFHKEFROEFRO") != std::string::npos);
+
+  // Values must match the columns
+
+  ArrowWriter::ColumnValues missing{&ids1, &icaos1};
+  BOOST_CHECK_THROW(ArrowWriter(columns, missing, 2), std::exception);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
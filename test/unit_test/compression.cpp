@@ -0,0 +1,174 @@
+#define BOOST_TEST_MODULE "CompressionModule"
+
+#include "Compression.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <brotli/decode.h>
+#include <zlib.h>
+#include <zstd.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+using Compression::Encoding;
+
+const Compression::Encodings allEncodings{false, true, true, true, false};
+
+std::string message()
+{
+  std::string text;
+
+  for (int i = 0; (i < 100); i++)
+    text += "METAR EFHK 171220Z 24012KT 9999 FEW020 SCT045 17/09 Q1012 NOSIG=\n";
+
+  return text;
+}
+
+std::string gunzip(const std::string &theData, std::size_t theSize)
+{
+  z_stream stream{};
+  BOOST_REQUIRE_EQUAL(inflateInit2(&stream, 15 + 16), Z_OK);
+
+  std::string out(theSize, '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(theData.data()));
+  stream.avail_in = theData.size();
+  stream.next_out = reinterpret_cast<Bytef *>(out.data());
+  stream.avail_out = out.size();
+
+  BOOST_CHECK_EQUAL(inflate(&stream, Z_FINISH), Z_STREAM_END);
+  out.resize(stream.total_out);
+  inflateEnd(&stream);
+  return out;
+}
+
+std::string unbrotli(const std::string &theData, std::size_t theSize)
+{
+  std::string out(theSize, '\0');
+  std::size_t size = out.size();
+
+  BOOST_CHECK(BrotliDecoderDecompress(theData.size(),
+                                      reinterpret_cast<const std::uint8_t *>(theData.data()),
+                                      &size,
+                                      reinterpret_cast<std::uint8_t *>(out.data())) ==
+              BROTLI_DECODER_RESULT_SUCCESS);
+  out.resize(size);
+  return out;
+}
+
+std::string unzstd(const std::string &theData, std::size_t theSize)
+{
+  std::string out(theSize, '\0');
+  auto size = ZSTD_decompress(out.data(), out.size(), theData.data(), theData.size());
+
+  BOOST_REQUIRE(!ZSTD_isError(size));
+  out.resize(size);
+  return out;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(compression_negotiate)
+{
+  BOOST_CHECK(Compression::negotiate("", allEncodings) == Encoding::Identity);
+  BOOST_CHECK(Compression::negotiate("deflate", allEncodings) == Encoding::Identity);
+  BOOST_CHECK(Compression::negotiate("gzip", allEncodings) == Encoding::Gzip);
+  BOOST_CHECK(Compression::negotiate("gzip, deflate, br", allEncodings) == Encoding::Brotli);
+  BOOST_CHECK(Compression::negotiate("gzip, deflate, br, zstd", allEncodings) == Encoding::Zstd);
+  BOOST_CHECK(Compression::negotiate("GZIP;q=0.9, br;q=0.5", allEncodings) == Encoding::Gzip);
+  BOOST_CHECK(Compression::negotiate("*", allEncodings) == Encoding::Zstd);
+  BOOST_CHECK(Compression::negotiate("*, zstd;q=0", allEncodings) == Encoding::Brotli);
+  BOOST_CHECK(Compression::negotiate("br;q=0", allEncodings) == Encoding::Identity);
+
+  // Disabled encodings are not used
+
+  Compression::Encodings gzipOnly{false, true, false, false, false};
+  BOOST_CHECK(Compression::negotiate("br, zstd", gzipOnly) == Encoding::Identity);
+  BOOST_CHECK(Compression::negotiate("br, zstd, gzip;q=0.1", gzipOnly) == Encoding::Gzip);
+
+  // The dictionary is used only if available and accepted by the client
+
+  auto withDictionary = allEncodings;
+  withDictionary[Compression::index(Encoding::ZstdDictionary)] = true;
+  BOOST_CHECK(Compression::negotiate("zstd, zstd-dict", allEncodings) == Encoding::Zstd);
+  BOOST_CHECK(Compression::negotiate("zstd, zstd-dict", withDictionary) ==
+              Encoding::ZstdDictionary);
+  BOOST_CHECK(Compression::negotiate("gzip, br", withDictionary) == Encoding::Brotli);
+
+  // Wildcard does not select the dictionary
+
+  BOOST_CHECK(Compression::negotiate("*", withDictionary) == Encoding::Zstd);
+  BOOST_CHECK(Compression::negotiate("*, zstd;q=0", withDictionary) == Encoding::Brotli);
+  BOOST_CHECK(Compression::negotiate("*, zstd-dict", withDictionary) ==
+              Encoding::ZstdDictionary);
+}
+
+BOOST_AUTO_TEST_CASE(compression_compress)
+{
+  auto text = message();
+
+  BOOST_CHECK_EQUAL(Compression::compress(text, Encoding::Identity), text);
+
+  auto gzip = Compression::compress(text, Encoding::Gzip);
+  auto brotli = Compression::compress(text, Encoding::Brotli);
+  auto zstd = Compression::compress(text, Encoding::Zstd);
+
+  BOOST_CHECK_LT(gzip.size(), text.size() / 10);
+  BOOST_CHECK_LT(brotli.size(), text.size() / 10);
+  BOOST_CHECK_LT(zstd.size(), text.size() / 10);
+
+  BOOST_CHECK_EQUAL(gunzip(gzip, text.size()), text);
+  BOOST_CHECK_EQUAL(unbrotli(brotli, text.size()), text);
+  BOOST_CHECK_EQUAL(unzstd(zstd, text.size()), text);
+
+  BOOST_CHECK_EQUAL(gunzip(Compression::compress("", Encoding::Gzip), 1), "");
+}
+
+BOOST_AUTO_TEST_CASE(compression_dictionary)
+{
+  // Raw content dictionary of typical messages
+
+  std::string dictionary =
+      "METAR EFHK 170150Z 15013KT 9999 -RA BKN008 06/05 Q1003 NOSIG=\n"
+      "METAR EFRO 170220Z AUTO 14008KT 6000 -SG SCT001 BKN003 BKN008 M02/M02 Q1003=\n"
+      "TAF EFHK 202343Z 2100/2124 30009KT 3000 -DZ BKN004 TEMPO 2100/2102 5000 BKN006=\n";
+
+  const std::string filename = "/tmp/avi-compression-test.dict";
+  std::ofstream(filename, std::ios::binary) << dictionary;
+
+  BOOST_CHECK_THROW(Compression::Dictionary("/nonexistent/avi.dict"), std::exception);
+  BOOST_CHECK_THROW(Compression::compress("METAR", Encoding::ZstdDictionary), std::exception);
+
+  Compression::Dictionary dict(filename);
+  std::remove(filename.c_str());
+  BOOST_CHECK_EQUAL(dict.id(), 0);
+
+  std::string text = "METAR EFHK 170220Z 15014KT 9999 BKN007 06/05 Q1002 NOSIG=\n";
+  auto compressed = Compression::compress(text, Encoding::ZstdDictionary, &dict);
+
+  BOOST_CHECK_LT(compressed.size(), Compression::compress(text, Encoding::Zstd).size());
+
+  std::string out(text.size(), '\0');
+  auto *context = ZSTD_createDCtx();
+  auto size = ZSTD_decompress_usingDict(context,
+                                        out.data(),
+                                        out.size(),
+                                        compressed.data(),
+                                        compressed.size(),
+                                        dictionary.data(),
+                                        dictionary.size());
+  ZSTD_freeDCtx(context);
+
+  BOOST_REQUIRE(!ZSTD_isError(size));
+  out.resize(size);
+  BOOST_CHECK_EQUAL(out, text);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
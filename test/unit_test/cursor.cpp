@@ -0,0 +1,80 @@
+#define BOOST_TEST_MODULE "CursorClassModule"
+
+#include "Cursor.h"
+
+#include <boost/test/included/unit_test.hpp>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+Fmi::DateTime created(int minute)
+{
+  return Fmi::DateTime(Fmi::Date(2024, 1, 1), Fmi::TimeDuration(12, minute, 0));
+}
+
+void addMessage(Engine::Avi::StationQueryData& data,
+                Engine::Avi::StationIdType stationId,
+                int minute,
+                int messageId)
+{
+  auto& values = data.itsValues[stationId];
+  values["messagecreated"].push_back(Fmi::to_iso_extended_string(created(minute)) + "Z");
+  values["messageid"].push_back(messageId);
+  values["message"].push_back("message " + std::to_string(messageId));
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(cursor_parse)
+{
+  Cursor cursor(created(5), 123);
+
+  auto parsed = Cursor::parse(cursor.str());
+  BOOST_CHECK(parsed.created() == created(5));
+  BOOST_CHECK_EQUAL(parsed.messageId(), 123);
+
+  // Plain time value
+
+  parsed = Cursor::parse("20240101T120500");
+  BOOST_CHECK(parsed.created() == created(5));
+  BOOST_CHECK_EQUAL(parsed.messageId(), 0);
+
+  BOOST_CHECK_THROW(Cursor::parse("c123"), std::exception);
+  BOOST_CHECK_THROW(Cursor::parse("c12x.5"), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(cursor_filter)
+{
+  Engine::Avi::StationQueryData data;
+  data.itsStationIds = {1, 2};
+
+  addMessage(data, 1, 10, 30);
+  addMessage(data, 1, 5, 20);
+  addMessage(data, 1, 5, 10);
+  addMessage(data, 2, 1, 5);
+
+  auto next = Cursor(created(5), 10).filter(data);
+
+  // Station 2 has no new messages, station 1 messages in creation order
+
+  BOOST_CHECK((data.itsStationIds == Engine::Avi::StationIdList{1}));
+  const auto& messages = data.itsValues[1]["message"];
+  BOOST_REQUIRE_EQUAL(messages.size(), 2);
+  BOOST_CHECK(std::get<std::string>(messages[0]) == "message 20");
+  BOOST_CHECK(std::get<std::string>(messages[1]) == "message 30");
+
+  BOOST_CHECK(next.created() == created(10));
+  BOOST_CHECK_EQUAL(next.messageId(), 30);
+
+  // Nothing new after the returned cursor
+
+  BOOST_CHECK(next.filter(data).messageId() == 30);
+  BOOST_CHECK(data.itsStationIds.empty());
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,131 @@
+#define BOOST_TEST_MODULE "GeoJsonWriterModule"
+
+#include "GeoJsonWriter.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+using SmartMet::Engine::Avi::Column;
+using SmartMet::Engine::Avi::Columns;
+using SmartMet::Engine::Avi::ColumnType;
+using SmartMet::Engine::Avi::ValueVector;
+
+const std::string sigmet =
+    "UNKL SIGMET 1 VALID 010100/010400 UNKL- UNKL KRASNOYARSK FIR SEV TURB FCST WI N7555 "
+    "E11443 - N7337 E10805 - N7323 E09100 - N7630 E10635 - N7555 E11443 SFC/FL010 MOV NE "
+    "30KMH NC=";
+
+GeoJsonWriter writer(const Columns &theColumns,
+                     std::initializer_list<const ValueVector *> theValues,
+                     std::size_t theStations,
+                     double theSimplifyTolerance)
+{
+  return GeoJsonWriter(theColumns,
+                       GeoJsonWriter::ColumnValues(theValues),
+                       theStations,
+                       2,
+                       nullptr,
+                       std::nullopt,
+                       theSimplifyTolerance);
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(geojsonwriter_area)
+{
+  auto points = GeoJsonWriter::area(sigmet);
+  BOOST_REQUIRE_EQUAL(points.size(), 5);
+  BOOST_CHECK_CLOSE(points[0].itsLat, 75 + 55 / 60.0, 1e-9);
+  BOOST_CHECK_CLOSE(points[0].itsLon, 114 + 43 / 60.0, 1e-9);
+  BOOST_CHECK_CLOSE(points[2].itsLon, 91, 1e-9);
+
+  // Ring is closed; degrees without minutes and southern/western hemispheres
+
+  points = GeoJsonWriter::area("WI S60 W025 - S6130 W02530 - S62 W024 SFC/FL100");
+  BOOST_REQUIRE_EQUAL(points.size(), 4);
+  BOOST_CHECK_CLOSE(points[1].itsLat, -61.5, 1e-9);
+  BOOST_CHECK_CLOSE(points[1].itsLon, -25.5, 1e-9);
+  BOOST_CHECK_EQUAL(points[3].itsLat, points[0].itsLat);
+
+  // Less than three points is not an area
+
+  BOOST_CHECK(GeoJsonWriter::area("METAR EFHK 170150Z 15013KT 9999 BKN008 06/05 Q1003=").empty());
+  BOOST_CHECK(GeoJsonWriter::area("WI N60 E025 - N61 E026 SFC/FL100").empty());
+}
+
+BOOST_AUTO_TEST_CASE(geojsonwriter_simplify)
+{
+  GeoJsonWriter::Points line{{0, 0}, {1, 0.01}, {2, 1}, {3, -0.01}, {4, 0}};
+
+  BOOST_CHECK_EQUAL(GeoJsonWriter::simplify(line, 0).size(), 5);
+  BOOST_CHECK_EQUAL(GeoJsonWriter::simplify(line, 0.1).size(), 5);
+
+  auto simplified = GeoJsonWriter::simplify(line, 0.5);
+  BOOST_REQUIRE_EQUAL(simplified.size(), 3);
+  BOOST_CHECK_EQUAL(simplified[1].itsLon, 2);
+
+  BOOST_CHECK_EQUAL(GeoJsonWriter::simplify(line, 10).size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(geojsonwriter_features)
+{
+  Columns columns{Column(ColumnType::String, "icao"),
+                  Column(ColumnType::Double, "longitude"),
+                  Column(ColumnType::Double, "latitude"),
+                  Column(ColumnType::String, "message")};
+
+  ValueVector icaos{std::string("UNKL"), std::string("EFHK")};
+  ValueVector longitudes{92.5, 24.9};
+  ValueVector latitudes{56.25, 60.3};
+  ValueVector messages{sigmet, std::string("METAR EFHK 170150Z 15013KT 9999=")};
+
+  auto geojson = writer(columns, {&icaos, &longitudes, &latitudes, &messages}, 1, 0);
+
+  // Header and one feature per call
+
+  std::string out;
+  int calls = 1;
+
+  while (geojson.write(out, 1))
+    calls++;
+
+  BOOST_CHECK_EQUAL(calls, 3);
+  BOOST_CHECK(!geojson.write(out, 1));
+
+  BOOST_CHECK_EQUAL(out.substr(0, 41), "{\"type\":\"FeatureCollection\",\"features\":[\n");
+  BOOST_CHECK(out.find("{\"type\":\"Feature\",\"geometry\":{\"type\":\"Polygon\",\"coordinates\":"
+                       "[[[114.72,75.92],[108.08,73.62],[91.00,73.38],[106.58,76.50],"
+                       "[114.72,75.92]]]},\"properties\":{\"icao\":\"UNKL\"") !=
+              std::string::npos);
+  BOOST_CHECK(out.find(",\n{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":"
+                       "[24.90,60.30]},\"properties\":{\"icao\":\"EFHK\",\"longitude\":24.90,"
+                       "\"latitude\":60.30,\"message\":\"METAR EFHK 170150Z 15013KT 9999=\"}}") !=
+              std::string::npos);
+  BOOST_CHECK_EQUAL(out.substr(out.size() - 4), "\n]}\n");
+
+  // Area is written unsimplified if simplification would degenerate it
+
+  auto simplified = writer(columns, {&icaos, &longitudes, &latitudes, &messages}, 1, 100);
+  std::string simplifiedOut;
+  BOOST_CHECK(!simplified.write(simplifiedOut, std::numeric_limits<std::size_t>::max()));
+  BOOST_CHECK(simplifiedOut.find("[[[114.72,75.92],[108.08,73.62]") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(geojsonwriter_empty)
+{
+  auto geojson = writer(Columns(), {}, 0, 0);
+
+  std::string out;
+  BOOST_CHECK(!geojson.write(out, 1));
+  BOOST_CHECK_EQUAL(out, "{\"type\":\"FeatureCollection\",\"features\":[\n]}\n");
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,83 @@
+#define BOOST_TEST_MODULE "JsonLayoutWriterModule"
+
+#include "JsonLayoutWriter.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+using SmartMet::Engine::Avi::Column;
+using SmartMet::Engine::Avi::Columns;
+using SmartMet::Engine::Avi::ColumnType;
+using SmartMet::Engine::Avi::ValueVector;
+
+Columns columns()
+{
+  return {Column(ColumnType::Integer, "stationid"),
+          Column(ColumnType::String, "icao"),
+          Column(ColumnType::String, "message")};
+}
+
+// Two messages of EFHK, none of EFRO and one of EFTU
+
+const ValueVector ids1{1, 1}, ids2, ids3{3};
+const ValueVector icaos1{std::string("EFHK"), std::string("EFHK")}, icaos2,
+    icaos3{std::string("EFTU")};
+const ValueVector messages1{std::string("A"), std::string("B")}, messages2,
+    messages3{std::string("C")};
+
+JsonLayoutWriter::ColumnValues values()
+{
+  return {&ids1, &ids2, &ids3, &icaos1, &icaos2, &icaos3, &messages1, &messages2, &messages3};
+}
+
+const JsonValueFormatter valueFormatter(2, nullptr, std::nullopt);
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(jsonlayoutwriter_columns)
+{
+  auto columnValues = values();
+  JsonLayoutWriter writer(columns(), columnValues, 3, valueFormatter);
+
+  std::string out;
+  writer.writeColumns(out);
+  BOOST_CHECK_EQUAL(out,
+                    "{\"stationid\":[1,1,3],\"icao\":[\"EFHK\",\"EFHK\",\"EFTU\"],"
+                    "\"message\":[\"A\",\"B\",\"C\"]}");
+}
+
+BOOST_AUTO_TEST_CASE(jsonlayoutwriter_stations)
+{
+  auto columnValues = values();
+  JsonLayoutWriter writer(columns(), columnValues, 3, valueFormatter);
+
+  std::string out;
+  writer.writeStations(out);
+  BOOST_CHECK_EQUAL(out,
+                    "[{\"stationid\":1,\"icao\":\"EFHK\",\"messages\":[{\"message\":\"A\"},"
+                    "{\"message\":\"B\"}]},"
+                    "{\"stationid\":3,\"icao\":\"EFTU\",\"messages\":[{\"message\":\"C\"}]}]");
+}
+
+BOOST_AUTO_TEST_CASE(jsonlayoutwriter_empty)
+{
+  JsonLayoutWriter::ColumnValues noValues;
+  JsonLayoutWriter writer(Columns(), noValues, 0, valueFormatter);
+
+  std::string out;
+  writer.writeColumns(out);
+  writer.writeStations(out);
+  BOOST_CHECK_EQUAL(out, "{}[]");
+
+  BOOST_CHECK_THROW(JsonLayoutWriter(columns(), noValues, 1, valueFormatter), std::exception);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
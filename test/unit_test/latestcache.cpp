@@ -0,0 +1,158 @@
+#define BOOST_TEST_MODULE "LatestCacheClassModule"
+
+#include "LatestCache.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <macgyver/Exception.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+LatestCache::RenditionPtr rendition(const std::string& content, int maxAge = 60)
+{
+  auto result = std::make_shared<LatestCache::Rendition>();
+  result->itsContent = content;
+  result->setETag("\"" + content + "\"");
+  result->itsExpires = std::chrono::steady_clock::now() + std::chrono::seconds(maxAge);
+  return result;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(latestcache_key)
+{
+  LatestCache::Key key("efhk", "metar", "json");
+  BOOST_CHECK(key.valid());
+  BOOST_CHECK_EQUAL(key.icao(), "EFHK");
+  BOOST_CHECK_EQUAL(key.type(), "METAR");
+  BOOST_CHECK_EQUAL(key.format(), "json");
+  BOOST_CHECK(key == LatestCache::Key("EFHK", "METAR", "json"));
+  BOOST_CHECK(!LatestCache::Key("EFHK", "METAR", std::string(40, 'x')).valid());
+}
+
+BOOST_AUTO_TEST_CASE(latestcache_etags)
+{
+  auto result = rendition("abc");
+  BOOST_CHECK_EQUAL(result->etag(Compression::Encoding::Identity), "\"abc\"");
+  BOOST_CHECK_EQUAL(result->etag(Compression::Encoding::Gzip), "\"abc-gzip\"");
+  BOOST_CHECK_EQUAL(result->etag(Compression::Encoding::Zstd), "\"abc-zstd\"");
+}
+
+BOOST_AUTO_TEST_CASE(latestcache_find)
+{
+  LatestCache cache(10, 60);
+  LatestCache::Key key("EFHK", "METAR", "json");
+
+  BOOST_CHECK(!cache.find(key));
+
+  cache.insert(key, rendition("EFHK"));
+  auto found = cache.find(LatestCache::Key("efhk", "metar", "json"));
+  BOOST_REQUIRE(found);
+  BOOST_CHECK_EQUAL(found->itsContent, "EFHK");
+  BOOST_CHECK(!cache.find(LatestCache::Key("EFHK", "METAR", "ascii")));
+
+  // Expired renditions are not returned
+
+  LatestCache::Key expired("EFRO", "METAR", "json");
+  cache.insert(expired, rendition("EFRO", 0));
+  BOOST_CHECK(!cache.find(expired));
+
+  auto stats = cache.getCacheStats();
+  BOOST_CHECK_EQUAL(stats.size, 2);
+  BOOST_CHECK_EQUAL(stats.inserts, 2);
+  BOOST_CHECK_EQUAL(stats.hits, 1);
+  BOOST_CHECK_EQUAL(stats.misses, 3);
+}
+
+BOOST_AUTO_TEST_CASE(latestcache_invalidate)
+{
+  LatestCache cache(10, 60);
+  LatestCache::Key metar("EFHK", "METAR", "json");
+  LatestCache::Key taf("EFHK", "TAF", "ascii");
+  LatestCache::Key other("EFRO", "METAR", "json");
+
+  cache.insert(metar, rendition("1"));
+  cache.insert(taf, rendition("2"));
+  cache.insert(other, rendition("3"));
+
+  // All renditions of the station are dropped
+
+  cache.invalidate("efhk");
+  BOOST_CHECK(!cache.find(metar));
+  BOOST_CHECK(!cache.find(taf));
+  BOOST_CHECK(cache.find(other));
+}
+
+BOOST_AUTO_TEST_CASE(latestcache_find_or_render)
+{
+  LatestCache cache(10, 60);
+  LatestCache::Key key("EFHK", "METAR", "json");
+  std::atomic<int> renders{0};
+
+  auto renderer = [&]
+  {
+    renders++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return rendition("EFHK");
+  };
+
+  // Concurrent requests are rendered once
+
+  std::vector<std::thread> threads;
+  std::atomic<int> found{0};
+
+  for (int i = 0; i < 8; i++)
+    threads.emplace_back(
+        [&]
+        {
+          if (cache.findOrRender(key, renderer)->itsContent == "EFHK")
+            found++;
+        });
+
+  for (auto& thread : threads)
+    thread.join();
+
+  BOOST_CHECK_EQUAL(renders, 1);
+  BOOST_CHECK_EQUAL(found, 8);
+  BOOST_CHECK(cache.find(key));
+
+  // Renderer errors are thrown and not cached
+
+  LatestCache::Key failing("EFRO", "METAR", "json");
+  auto failure = []() -> LatestCache::RenditionPtr { throw std::runtime_error("failed"); };
+
+  BOOST_CHECK_THROW(cache.findOrRender(failing, failure), Fmi::Exception);
+  BOOST_CHECK(!cache.find(failing));
+  BOOST_CHECK_EQUAL(cache.findOrRender(failing, renderer)->itsContent, "EFHK");
+  BOOST_CHECK_EQUAL(renders, 2);
+}
+
+BOOST_AUTO_TEST_CASE(latestcache_matches)
+{
+  const std::string etag = "\"abc-gzip\"";
+
+  BOOST_CHECK(LatestCache::matches("\"abc-gzip\"", etag));
+  BOOST_CHECK(LatestCache::matches("W/\"abc-gzip\"", etag));
+  BOOST_CHECK(LatestCache::matches("\"abc\", \"abc-gzip\"", etag));
+  BOOST_CHECK(LatestCache::matches("\"x,y\",W/\"abc-gzip\"", etag));
+  BOOST_CHECK(LatestCache::matches("*", etag));
+  BOOST_CHECK(LatestCache::matches("\"abc-gzip\"", "W/" + etag));
+
+  BOOST_CHECK(!LatestCache::matches("", etag));
+  BOOST_CHECK(!LatestCache::matches("\"abc\"", etag));
+  BOOST_CHECK(!LatestCache::matches("abc-gzip", etag));
+  BOOST_CHECK(!LatestCache::matches("\"abc-gzip", etag));
+  BOOST_CHECK(!LatestCache::matches("\"abc-gzip, x\"", etag));
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
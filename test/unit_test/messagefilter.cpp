@@ -0,0 +1,90 @@
+#define BOOST_TEST_MODULE "MessageFilterClassModule"
+
+#include "MessageFilter.h"
+
+#include <boost/test/included/unit_test.hpp>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+const char *metar1 = "METAR EFHK 011220Z 24012KT 9999 VCTS FEW025CB 18/12 Q1012 NOSIG=";
+const char *metar2 = "METAR EFRO 011220Z 00000KT 0800 FZFG VV002 M05/M06 Q1025=";
+const char *metar3 = "METAR EFOU 011220Z 18005KT 3000 -FZRA BR OVC008 M01/M02 Q1008=";
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(messagefilter_contains)
+{
+  MessageFilter filter({"TS", "FZRA"}, {});
+
+  BOOST_CHECK(filter.matches(metar1));
+  BOOST_CHECK(!filter.matches(metar2));
+  BOOST_CHECK(filter.matches(metar3));
+
+  // Case insensitive; overlapping patterns
+
+  BOOST_CHECK(MessageFilter({"nosig"}, {}).matches(metar1));
+  BOOST_CHECK(MessageFilter({"CBX", "B0", "025CB"}, {}).matches(metar1));
+  BOOST_CHECK(!MessageFilter({"CBX", "Q1013"}, {}).matches(metar1));
+
+  // No patterns
+
+  BOOST_CHECK(MessageFilter({}, {}).matches(metar2));
+  BOOST_CHECK_THROW(MessageFilter({""}, {}), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(messagefilter_match)
+{
+  // Whole tokens only
+
+  BOOST_CHECK(!MessageFilter({}, {"TS"}).matches(metar1));
+  BOOST_CHECK(MessageFilter({}, {"TS", "VCTS"}).matches(metar1));
+  BOOST_CHECK(MessageFilter({}, {"-fzra"}).matches(metar3));
+  BOOST_CHECK(!MessageFilter({}, {"FZRA"}).matches(metar3));
+  BOOST_CHECK(MessageFilter({}, {"METAR"}).matches(metar2));
+  BOOST_CHECK(MessageFilter({}, {"Q1025"}).matches(metar2));
+  BOOST_CHECK(!MessageFilter({}, {"Q102"}).matches(metar2));
+  BOOST_CHECK(MessageFilter({}, {"BR"}).matches(metar3));
+
+  // Both conditions must match
+
+  BOOST_CHECK(MessageFilter({"FZ"}, {"BR"}).matches(metar3));
+  BOOST_CHECK(!MessageFilter({"FZ"}, {"BR"}).matches(metar2));
+}
+
+BOOST_AUTO_TEST_CASE(messagefilter_apply)
+{
+  Engine::Avi::StationQueryData data;
+  data.itsStationIds = {1, 2};
+
+  auto &values1 = data.itsValues[1];
+  values1["message"] = {std::string(metar1), std::string(metar3), TimeSeries::None()};
+  values1["messageid"] = {10, 11, 12};
+
+  auto &values2 = data.itsValues[2];
+  values2["message"] = {std::string(metar2)};
+  values2["messageid"] = {20};
+
+  MessageFilter filter({"TS", "FZRA"}, {});
+  filter.apply(data);
+
+  BOOST_CHECK((data.itsStationIds == Engine::Avi::StationIdList{1}));
+  BOOST_CHECK_EQUAL(data.itsValues.count(2), 0);
+  BOOST_REQUIRE_EQUAL(data.itsValues[1]["messageid"].size(), 2);
+  BOOST_CHECK_EQUAL(std::get<int>(data.itsValues[1]["messageid"][1]), 11);
+
+  Engine::Avi::QueryData rejected;
+  rejected.itsValues["message"] = {std::string(metar1), std::string(metar2)};
+  rejected.itsValues["messageid"] = {30, 31};
+
+  MessageFilter({}, {"FZFG"}).apply(rejected);
+  BOOST_REQUIRE_EQUAL(rejected.itsValues["messageid"].size(), 1);
+  BOOST_CHECK_EQUAL(std::get<int>(rejected.itsValues["messageid"][0]), 31);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,72 @@
+#define BOOST_TEST_MODULE "MessageMonitorModule"
+
+#include "MessageMonitor.h"
+#include "NegativeCache.h"
+
+#include <boost/test/included/unit_test.hpp>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+// Stand-in message source
+
+MessageMonitor::Messages messages(std::initializer_list<long> theMessageIds)
+{
+  MessageMonitor::Messages result;
+
+  for (auto messageId : theMessageIds)
+    result.push_back({7, "EFHK", "METAR", messageId, "", ""});
+
+  return result;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(messagemonitor_new_messages)
+{
+  MessageMonitor monitor(nullptr, 60);
+
+  std::vector<long> notified;
+  monitor.addListener(
+      [&](const MessageMonitor::Messages& newMessages)
+      {
+        for (const auto& message : newMessages)
+          notified.push_back(message.itsMessageId);
+      });
+
+  // The first update only initializes the known messages
+
+  monitor.update(messages({1, 2}));
+  BOOST_CHECK(notified.empty());
+
+  monitor.update(messages({1, 2}));
+  BOOST_CHECK(notified.empty());
+
+  monitor.update(messages({2, 3, 4}));
+  BOOST_CHECK((notified == std::vector<long>{3, 4}));
+}
+
+BOOST_AUTO_TEST_CASE(messagemonitor_invalidates_empty_results)
+{
+  MessageMonitor monitor(nullptr, 60);
+  NegativeCache cache(10, 60);
+
+  monitor.addListener([&](const MessageMonitor::Messages& /* messages */)
+                      { cache.clearEmptyResults(); });
+
+  monitor.update(messages({1}));
+  cache.addEmptyResult("q1");
+
+  monitor.update(messages({1}));
+  BOOST_CHECK(cache.isEmptyResult("q1"));
+
+  monitor.update(messages({1, 2}));
+  BOOST_CHECK(!cache.isEmptyResult("q1"));
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,101 @@
+#define BOOST_TEST_MODULE "NdjsonWriterModule"
+
+#include "NdjsonWriter.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <cmath>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+using SmartMet::Engine::Avi::Column;
+using SmartMet::Engine::Avi::Columns;
+using SmartMet::Engine::Avi::ColumnType;
+using SmartMet::Engine::Avi::ValueVector;
+
+Columns columns()
+{
+  return {Column(ColumnType::Integer, "stationid"),
+          Column(ColumnType::String, "message"),
+          Column(ColumnType::Double, "latitude"),
+          Column(ColumnType::TS_LatLon, "latlon")};
+}
+
+NdjsonWriter writer(const Columns &theColumns,
+                    std::initializer_list<const ValueVector *> theValues,
+                    std::size_t theStations)
+{
+  return NdjsonWriter(theColumns,
+                      NdjsonWriter::ColumnValues(theValues),
+                      theStations,
+                      2,
+                      nullptr,
+                      std::nullopt);
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(ndjsonwriter_rows)
+{
+  // Values of two stations in column order; the second station has a missing latitude
+
+  ValueVector ids1{1, 1}, ids2{2};
+  ValueVector messages1{std::string("METAR \"A\""), std::string("B\nC")};
+  ValueVector messages2{std::string("D")};
+  ValueVector latitudes1{60.25, std::nan("")}, latitudes2;
+  ValueVector latlons1{TimeSeries::LonLat(25.0, 60.0), TimeSeries::None()};
+  ValueVector latlons2{TimeSeries::None()};
+
+  auto ndjson = writer(columns(),
+                       {&ids1,
+                        &ids2,
+                        &messages1,
+                        &messages2,
+                        &latitudes1,
+                        &latitudes2,
+                        &latlons1,
+                        &latlons2},
+                       2);
+  std::string out;
+  BOOST_CHECK(!ndjson.write(out, std::numeric_limits<std::size_t>::max()));
+
+  BOOST_CHECK_EQUAL(out,
+                    "{\"stationid\":1,\"message\":\"METAR \\\"A\\\"\",\"latitude\":60.25,"
+                    "\"latlon\":[60.00,25.00]}\n"
+                    "{\"stationid\":1,\"message\":\"B\\nC\",\"latitude\":null,\"latlon\":null}\n"
+                    "{\"stationid\":2,\"message\":\"D\",\"latitude\":null,\"latlon\":null}\n");
+}
+
+BOOST_AUTO_TEST_CASE(ndjsonwriter_chunks)
+{
+  Columns idColumns{Column(ColumnType::Integer, "stationid")};
+  ValueVector ids{1, 2, 3};
+  auto ndjson = writer(idColumns, {&ids}, 1);
+
+  // Each call writes at least the requested number of bytes if rows remain
+
+  std::string out;
+  BOOST_CHECK(ndjson.write(out, 1));
+  BOOST_CHECK_EQUAL(out, "{\"stationid\":1}\n");
+  BOOST_CHECK(ndjson.write(out, 1));
+  BOOST_CHECK(!ndjson.write(out, 1));
+  BOOST_CHECK_EQUAL(out, "{\"stationid\":1}\n{\"stationid\":2}\n{\"stationid\":3}\n");
+
+  std::string rest;
+  BOOST_CHECK(!ndjson.write(rest, 1));
+  BOOST_CHECK(rest.empty());
+}
+
+BOOST_AUTO_TEST_CASE(ndjsonwriter_errors)
+{
+  ValueVector ids{1};
+  BOOST_CHECK_THROW(writer(columns(), {&ids}, 1), std::exception);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
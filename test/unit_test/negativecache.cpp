@@ -0,0 +1,98 @@
+#define BOOST_TEST_MODULE "NegativeCacheModule"
+
+#include "NegativeCache.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+BOOST_AUTO_TEST_CASE(negativecache_unknown_locations)
+{
+  NegativeCache cache(10, 60);
+
+  SmartMet::Engine::Avi::LocationOptions options;
+  options.itsIcaos = {"EFHK", "efxx"};
+  options.itsStationIds = {7};
+
+  BOOST_CHECK(!cache.findUnknownLocation(options));
+
+  // Icao codes are case insensitive
+
+  cache.addUnknownLocation(NegativeCache::icaoKey("EFXX"));
+  auto unknown = cache.findUnknownLocation(options);
+  BOOST_REQUIRE(unknown);
+  BOOST_CHECK_EQUAL(*unknown, "icao 'efxx'");
+
+  options.itsIcaos = {"EFHK"};
+  BOOST_CHECK(!cache.findUnknownLocation(options));
+
+  cache.addUnknownLocation(NegativeCache::stationIdKey(7));
+  unknown = cache.findUnknownLocation(options);
+  BOOST_REQUIRE(unknown);
+  BOOST_CHECK_EQUAL(*unknown, "stationid 7");
+
+  // Station refresh forgets the locations
+
+  cache.clearUnknownLocations();
+  BOOST_CHECK(!cache.findUnknownLocation(options));
+}
+
+BOOST_AUTO_TEST_CASE(negativecache_empty_results)
+{
+  NegativeCache cache(10, 60);
+
+  BOOST_CHECK(!cache.isEmptyResult("q1"));
+
+  cache.addEmptyResult("q1");
+  BOOST_CHECK(cache.isEmptyResult("q1"));
+  BOOST_CHECK(!cache.isEmptyResult("q2"));
+
+  cache.clearEmptyResults();
+  BOOST_CHECK(!cache.isEmptyResult("q1"));
+
+  // Entries expire after the time to live
+
+  NegativeCache expiring(10, 0);
+  expiring.addEmptyResult("q1");
+  BOOST_CHECK(!expiring.isEmptyResult("q1"));
+}
+
+BOOST_AUTO_TEST_CASE(negativecache_overflow)
+{
+  NegativeCache cache(2, 60);
+
+  // The least recently used entry is dropped, the others are kept
+
+  cache.addEmptyResult("q1");
+  cache.addEmptyResult("q2");
+  BOOST_CHECK(cache.isEmptyResult("q1"));
+  cache.addEmptyResult("q3");
+
+  BOOST_CHECK(cache.isEmptyResult("q1"));
+  BOOST_CHECK(!cache.isEmptyResult("q2"));
+  BOOST_CHECK(cache.isEmptyResult("q3"));
+
+  SmartMet::Engine::Avi::LocationOptions options;
+
+  cache.addUnknownLocation(NegativeCache::icaoKey("EFXX"));
+  cache.addUnknownLocation(NegativeCache::icaoKey("EFYY"));
+  cache.addUnknownLocation(NegativeCache::icaoKey("EFZZ"));
+
+  options.itsIcaos = {"EFXX"};
+  BOOST_CHECK(!cache.findUnknownLocation(options));
+  options.itsIcaos = {"EFYY"};
+  BOOST_CHECK(cache.findUnknownLocation(options));
+  options.itsIcaos = {"EFZZ"};
+  BOOST_CHECK(cache.findUnknownLocation(options));
+
+  BOOST_CHECK_EQUAL(cache.getUnknownLocationStats().size, 2);
+  BOOST_CHECK_EQUAL(cache.getEmptyResultStats().size, 2);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
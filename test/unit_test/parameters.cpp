@@ -0,0 +1,39 @@
+#define BOOST_TEST_MODULE "ParametersModule"
+
+#include "Parameters.h"
+
+#include <boost/test/included/unit_test.hpp>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+static_assert(Parameters::find("icao") == Parameters::Id::Icao, "Compile time lookup");
+
+BOOST_AUTO_TEST_CASE(parameters_find)
+{
+  for (std::size_t i = 0; (i < Parameters::count); i++)
+  {
+    auto id = Parameters::find(Parameters::names[i]);
+    BOOST_REQUIRE(id);
+    BOOST_CHECK_EQUAL(Parameters::index(*id), i);
+    BOOST_CHECK(Parameters::name(*id) == Parameters::names[i]);
+  }
+
+  BOOST_CHECK(Parameters::find("messirheading") == Parameters::Id::MessirHeading);
+  BOOST_CHECK(Parameters::find("messagerejectedicao") == Parameters::Id::MessageRejectedIcao);
+}
+
+BOOST_AUTO_TEST_CASE(parameters_unknown)
+{
+  BOOST_CHECK(!Parameters::find(""));
+  BOOST_CHECK(!Parameters::find("ICAO"));
+  BOOST_CHECK(!Parameters::find("icao2"));
+  BOOST_CHECK(!Parameters::find("messag"));
+  BOOST_CHECK(!Parameters::find("temperature"));
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
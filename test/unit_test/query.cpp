@@ -6,7 +6,9 @@
 #include <smartmet/engines/avi/Engine.h>
 #include <spine/HTTP.h>
 #include <spine/Reactor.h>
+#include <array>
 #include <typeinfo>
+#include <vector>
 
 namespace SmartMet
 {
@@ -48,7 +50,7 @@ BOOST_AUTO_TEST_CASE(query_constructor, *boost::unit_test::depends_on("query_aut
 
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
   Query query(request, authEngine, config);
 
   BOOST_CHECK(typeid(query.itsPrecision) == typeid(unsignedIntVariable));
@@ -57,8 +59,13 @@ BOOST_AUTO_TEST_CASE(query_constructor, *boost::unit_test::depends_on("query_aut
   BOOST_CHECK_EQUAL(query.itsPrecision, 6);
   BOOST_CHECK_EQUAL(query.itsFormat, "ascii");
 
+  // Exception: unknown parameter
+
+  request.addParameter("param", "icao,value");
+  BOOST_CHECK_THROW({ Query query2(request, authEngine, config); }, std::exception);
+
   request.removeParameter("param");
-  BOOST_CHECK_THROW({ Query query2(request, authEngine, config); }, Spine::Exception);
+  BOOST_CHECK_THROW({ Query query3(request, authEngine, config); }, Spine::Exception);
 }
 
 BOOST_AUTO_TEST_CASE(query_constructor_allowMultipleLocationOptions_enabled,
@@ -69,7 +76,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_allowMultipleLocationOptions_enabled,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
   request.addParameter("place", "Göteborg");
   Query query1(request, authEngine, config);
 
@@ -85,7 +92,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_allowMultipleLocationOptions_disabled,
   const std::string filename = "cnf/aviplugin-with-authentication.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
   request.addParameter("place", "Göteborg");
   Query query1(request, authEngine, config);
 
@@ -94,6 +101,35 @@ BOOST_AUTO_TEST_CASE(query_constructor_allowMultipleLocationOptions_disabled,
   BOOST_CHECK_THROW({ Query query2(request, authEngine, config); }, Spine::Exception);
 }
 
+BOOST_AUTO_TEST_CASE(query_constructor_allowMultipleLocationOptions_disabled_siblings,
+                     *boost::unit_test::depends_on("query_constructor"))
+{
+  BOOST_CHECK(authEngine != nullptr);
+
+  const std::string filename = "cnf/aviplugin-with-authentication.conf";
+  std::unique_ptr<Config> config(new Config(filename));
+
+  // Options of the same location type are also different location options
+
+  const std::vector<std::array<std::pair<const char *, const char *>, 2>> pairs{
+      {{{"icao", "EFHK"}, {"icaos", "EFRO"}}},
+      {{{"lonlat", "24.9,60.3"}, {"latlon", "60.3,24.9"}}},
+      {{{"lonlats", "24.9,60.3"}, {"latlons", "60.3,24.9"}}},
+      {{{"stationid", "7"}, {"stationids", "8"}}}};
+
+  for (const auto& pair : pairs)
+  {
+    Spine::HTTP::Request request;
+    request.addParameter("param", "icao");
+    request.addParameter("maxdistance", "50");
+    request.addParameter(pair[0].first, pair[0].second);
+    Query query1(request, authEngine, config);
+
+    request.addParameter(pair[1].first, pair[1].second);
+    BOOST_CHECK_THROW({ Query query2(request, authEngine, config); }, std::exception);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(
     query_constructor_parseLocationOptions_places,
     *boost::unit_test::depends_on("query_constructor_allowMultipleLocationOptions_enabled"))
@@ -103,7 +139,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
   request.addParameter("place", " Göteborg");
   request.addParameter("place", "Helsinki ");
   request.addParameter("place", ",Turku");
@@ -133,7 +169,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Option maxdistance is required with latlon/lonlat, bbox and wkt options
   request.addParameter("bbox", "25,60,26,61");
@@ -178,7 +214,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Option maxdistance is required with latlon/lonlat, bbox and wkt options
   request.addParameter("lonlat", "25,60");
@@ -235,7 +271,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Option maxdistance is required with latlon/lonlat, bbox and wkt options
   request.addParameter("latlon", "60,25");
@@ -296,7 +332,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_parseLocationOptions_lonlats,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Option maxdistance is required with latlon/lonlat, bbox and wkt options
   request.addParameter("lonlats", "25,60");
@@ -345,7 +381,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_parseLocationOptions_latlons,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Option maxdistance is required with latlon/lonlat, bbox and wkt options
   request.addParameter("latlons", "60,25");
@@ -395,7 +431,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Option maxdistance is required with latlon/lonlat, bbox and wkt options
   request.addParameter("wkt", stringVariable1);
@@ -430,7 +466,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // One icao code with invalid value
   request.addParameter("icao", stringVariable1);
@@ -460,7 +496,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // One icao code with invalid value
   request.addParameter("icaos", stringVariable1);
@@ -497,7 +533,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // One country with invalid value
   request.addParameter("country", stringVariable1);
@@ -529,7 +565,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // One country with invalid value
   request.addParameter("countries", stringVariable1);
@@ -576,7 +612,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Option 'stationid' is empty
   request.addParameter("stationid", stringVariable1);
@@ -623,7 +659,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Option 'stationids' is empty
   request.addParameter("stationids", stringVariable1);
@@ -666,7 +702,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: [Invalid argument] Fmi::stoul failed to convert 'ab' to unsigned long
   request.addParameter("numberofstations", stringVariable1);
@@ -693,7 +729,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_parseMessageTypeOption_messagetype,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Option 'messagetype' is empty
   request.addParameter("messagetype", stringVariable1);
@@ -740,7 +776,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_parseTimeOptions_starttime_endtime,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: 'starttime' and 'endtime' options must be given simultaneously
   request.addParameter("starttime", stringVariable1);
@@ -807,6 +843,44 @@ BOOST_AUTO_TEST_CASE(query_constructor_parseTimeOptions_starttime_endtime,
   request.removeParameter("endtime");
 }
 
+BOOST_AUTO_TEST_CASE(query_constructor_parseTimeOptions_option_names,
+                     *boost::unit_test::depends_on("query_constructor"))
+{
+  BOOST_CHECK(authEngine != nullptr);
+
+  const std::string filename = "cnf/aviplugin.conf";
+  std::unique_ptr<Config> config(new Config(filename));
+  Spine::HTTP::Request request;
+  request.addParameter("param", "icao");
+  request.addParameter("icao", "EFHK");
+
+  BOOST_CHECK(!Query::isTimeRangeRequest(request));
+
+  request.addParameter(Query::startTimeOption, "2010-10-10T10:10:20Z");
+  BOOST_CHECK(Query::isTimeRangeRequest(request));
+  request.removeParameter(Query::startTimeOption);
+
+  request.addParameter(Query::endTimeOption, "2010-10-10T12:10:20Z");
+  BOOST_CHECK(Query::isTimeRangeRequest(request));
+
+  // The checked options are the parsed ones
+
+  request.addParameter(Query::startTimeOption, "2010-10-10T10:10:20Z");
+  Query query1(request, authEngine, config);
+  BOOST_CHECK(query1.itsQueryOptions.itsTimeOptions.itsObservationTime.empty());
+  BOOST_CHECK(!query1.itsQueryOptions.itsTimeOptions.itsStartTime.empty());
+  request.removeParameter(Query::startTimeOption);
+  request.removeParameter(Query::endTimeOption);
+
+  // Lower case option names are found as well
+
+  request.addParameter("starttime", "2010-10-10T10:10:20Z");
+  BOOST_CHECK(Query::isTimeRangeRequest(request));
+  request.addParameter("endtime", "2010-10-10T12:10:20Z");
+  Query query2(request, authEngine, config);
+  BOOST_CHECK(!query2.itsQueryOptions.itsTimeOptions.itsStartTime.empty());
+}
+
 BOOST_AUTO_TEST_CASE(query_constructor_parseTimeOptions_time,
                      *boost::unit_test::depends_on("query_constructor"))
 {
@@ -825,7 +899,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_parseTimeOptions_time,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: [Runtime error] Unknown time string 'a'
   request.addParameter("time", stringVariable1);
@@ -881,7 +955,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_parseTimeOptions_timeformat,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Unknown 'timeformat', use 'iso', 'timestamp', 'sql', 'xml' or 'epoch'
   request.addParameter("timeformat", stringVariable1);
@@ -910,7 +984,7 @@ BOOST_AUTO_TEST_CASE(
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Exception: Unknown 'validity', use 'accepted' or 'rejected'
   request.addParameter("validity", stringVariable1);
@@ -951,7 +1025,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_option_format,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   request.addParameter("format", stringVariable1);
   Query query1(request, authEngine, config);
@@ -982,7 +1056,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_option_distinct,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Default value of distict parameter
   Query query1(request, authEngine, config);
@@ -1024,7 +1098,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_option_filtermetars,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Default value of filtermetars request parameter
   Query query1(request, authEngine, config);
@@ -1061,7 +1135,7 @@ BOOST_AUTO_TEST_CASE(query_constructor_option_configured,
   const std::string filename = "cnf/aviplugin.conf";
   std::unique_ptr<Config> config(new Config(filename));
   Spine::HTTP::Request request;
-  request.addParameter("param", "value");
+  request.addParameter("param", "icao");
 
   // Values from configuration file
   // - maxstations
@@ -1071,6 +1145,197 @@ BOOST_AUTO_TEST_CASE(query_constructor_option_configured,
   BOOST_CHECK_EQUAL(query1.itsQueryOptions.itsMaxMessageStations, 0);
   BOOST_CHECK_EQUAL(query1.itsQueryOptions.itsMaxMessageRows, 0);
 }
+
+BOOST_AUTO_TEST_CASE(query_constructor_option_layout,
+                     *boost::unit_test::depends_on("query_constructor"))
+{
+  BOOST_CHECK(authEngine != nullptr);
+
+  const std::string filename = "cnf/aviplugin.conf";
+  std::unique_ptr<Config> config(new Config(filename));
+  Spine::HTTP::Request request;
+  request.addParameter("param", "icao,message");
+
+  // Default layout is rows
+  Query query1(request, authEngine, config);
+  BOOST_CHECK_EQUAL(query1.itsLayout, "rows");
+
+  request.addParameter("format", "json");
+  request.addParameter("layout", "stations");
+  Query query2(request, authEngine, config);
+  BOOST_CHECK_EQUAL(query2.itsLayout, "stations");
+
+  // Exception: Unknown 'layout'
+  request.removeParameter("layout");
+  request.addParameter("layout", "table");
+  BOOST_CHECK_THROW({ Query query3(request, authEngine, config); }, std::exception);
+
+  // Exception: rejected messages have no stations
+  request.removeParameter("layout");
+  request.addParameter("layout", "stations");
+  request.addParameter("validity", "rejected");
+  BOOST_CHECK_THROW({ Query query4(request, authEngine, config); }, std::exception);
+  request.removeParameter("validity");
+
+  // Exception: layout is available for json only
+  request.removeParameter("format");
+  request.removeParameter("layout");
+  request.addParameter("format", "ascii");
+  request.addParameter("layout", "columns");
+  BOOST_CHECK_THROW({ Query query5(request, authEngine, config); }, std::exception);
+}
+BOOST_AUTO_TEST_CASE(query_constructor_option_digest,
+                     *boost::unit_test::depends_on("query_constructor"))
+{
+  BOOST_CHECK(authEngine != nullptr);
+
+  const std::string filename = "cnf/aviplugin.conf";
+  std::unique_ptr<Config> config(new Config(filename));
+  Spine::HTTP::Request request;
+  request.addParameter("icao", "EFHK");
+
+  // Exception: param is required without digest
+  BOOST_CHECK_THROW({ Query query1(request, authEngine, config); }, std::exception);
+
+  // Identifying parameters and message (for digest) are queried in digest mode
+  request.addParameter("digest", "1");
+  Query query2(request, authEngine, config);
+  BOOST_CHECK(query2.itsDigest);
+
+  const auto& params = query2.itsQueryOptions.itsParameters;
+  BOOST_CHECK_EQUAL(params.size(), 7);
+  BOOST_CHECK(std::find(params.begin(), params.end(), "messageid") != params.end());
+  BOOST_CHECK(std::find(params.begin(), params.end(), "message") != params.end());
+
+  // Exception: digest is not available for rejected messages
+  request.addParameter("validity", "rejected");
+  BOOST_CHECK_THROW({ Query query3(request, authEngine, config); }, std::exception);
+}
+BOOST_AUTO_TEST_CASE(query_constructor_option_selection,
+                     *boost::unit_test::depends_on("query_constructor"))
+{
+  BOOST_CHECK(authEngine != nullptr);
+
+  const std::string filename = "cnf/aviplugin.conf";
+  std::unique_ptr<Config> config(new Config(filename));
+  Spine::HTTP::Request request;
+  request.addParameter("icao", "EFHK");
+  request.addParameter("param", "icao,message");
+
+  Query query1(request, authEngine, config);
+  BOOST_CHECK(!query1.itsRowSelection);
+
+  // Message time is queried for the selection but not returned
+
+  request.addParameter("latestperstation", "3");
+  request.addParameter("sample", "1h");
+  Query query2(request, authEngine, config);
+  BOOST_REQUIRE(query2.itsRowSelection);
+  BOOST_CHECK_EQUAL(query2.itsRowSelection->latestCount(), 3);
+  BOOST_CHECK_EQUAL(query2.itsRowSelection->sampleInterval(), 3600);
+  BOOST_CHECK((query2.itsSelectionColumns == std::list<std::string>{"messagetime"}));
+
+  // Exception: invalid interval
+
+  request.addParameter("sample", "1x");
+  BOOST_CHECK_THROW({ Query query3(request, authEngine, config); }, std::exception);
+
+  // Exception: selection is not available for rejected messages
+
+  request.addParameter("sample", "30m");
+  request.addParameter("validity", "rejected");
+  BOOST_CHECK_THROW({ Query query4(request, authEngine, config); }, std::exception);
+}
+BOOST_AUTO_TEST_CASE(query_constructor_option_message_filter,
+                     *boost::unit_test::depends_on("query_constructor"))
+{
+  BOOST_CHECK(authEngine != nullptr);
+
+  const std::string filename = "cnf/aviplugin.conf";
+  std::unique_ptr<Config> config(new Config(filename));
+  Spine::HTTP::Request request;
+  request.addParameter("icao", "EFHK");
+  request.addParameter("param", "icao");
+
+  Query query1(request, authEngine, config);
+  BOOST_CHECK(!query1.itsMessageFilter);
+
+  // Message is queried for the filtering but not returned
+
+  request.addParameter("contains", "TS,FZRA");
+  request.addParameter("match", "TSRA");
+  Query query2(request, authEngine, config);
+  BOOST_REQUIRE(query2.itsMessageFilter);
+  BOOST_CHECK(query2.itsMessageFilter->matches("METAR EFHK 011220Z TSRA FEW025CB="));
+  BOOST_CHECK(!query2.itsMessageFilter->matches("METAR EFHK 011220Z -TSRA FEW025CB="));
+  BOOST_CHECK((query2.itsSelectionColumns == std::list<std::string>{"message"}));
+
+  // Exception: empty option
+
+  request.addParameter("match", "");
+  BOOST_CHECK_THROW({ Query query3(request, authEngine, config); }, std::exception);
+
+  // Exception: too many patterns or too long patterns in total
+
+  std::string patterns = "TS";
+  for (unsigned int i = 1; i <= config->maxFilterPatterns(); i++)
+    patterns += ",TS";
+
+  request.addParameter("match", "TSRA");
+  request.addParameter("contains", patterns);
+  BOOST_CHECK_THROW({ Query query4(request, authEngine, config); }, std::exception);
+
+  request.addParameter("contains", std::string(config->maxFilterBytes(), 'X'));
+  BOOST_CHECK_THROW({ Query query5(request, authEngine, config); }, std::exception);
+}
+BOOST_AUTO_TEST_CASE(query_constructor_option_aggregate,
+                     *boost::unit_test::depends_on("query_constructor"))
+{
+  BOOST_CHECK(authEngine != nullptr);
+
+  const std::string filename = "cnf/aviplugin.conf";
+  std::unique_ptr<Config> config(new Config(filename));
+  Spine::HTTP::Request request;
+  request.addParameter("icao", "EFHK");
+  request.addParameter("starttime", "2024-01-01T00:00:00Z");
+  request.addParameter("endtime", "2024-01-02T00:00:00Z");
+
+  // Exception: groupby without aggregate
+
+  request.addParameter("groupby", "icao");
+  BOOST_CHECK_THROW({ Query query1(request, authEngine, config); }, std::exception);
+
+  // Grouping columns are queried; param is not required
+
+  request.addParameter("aggregate", "count");
+  request.addParameter("groupby", "icao,messagetype,hour");
+  Query query2(request, authEngine, config);
+  BOOST_REQUIRE(query2.itsAggregation);
+
+  const auto& keys = query2.itsAggregation->keys();
+  BOOST_REQUIRE_EQUAL(keys.size(), 3);
+  BOOST_CHECK_EQUAL(keys[2].itsColumn, "messagetime");
+  BOOST_CHECK_EQUAL(keys[2].itsInterval, 3600);
+  BOOST_CHECK((query2.itsQueryOptions.itsParameters ==
+               std::list<std::string>{"icao", "messagetype", "messagetime"}));
+
+  // Rejected messages are grouped by rejected icao and creation time
+
+  request.addParameter("validity", "rejected");
+  Query query3(request, authEngine, config);
+  BOOST_REQUIRE(query3.itsAggregation);
+  BOOST_CHECK_EQUAL(query3.itsAggregation->keys()[0].itsColumn, "messagerejectedicao");
+  BOOST_CHECK_EQUAL(query3.itsAggregation->keys()[2].itsColumn, "messagecreated");
+
+  // Exceptions: unknown aggregate or grouping column
+
+  request.addParameter("aggregate", "sum");
+  BOOST_CHECK_THROW({ Query query4(request, authEngine, config); }, std::exception);
+
+  request.addParameter("aggregate", "count");
+  request.addParameter("groupby", "icao,minute");
+  BOOST_CHECK_THROW({ Query query5(request, authEngine, config); }, std::exception);
+}
 }  // namespace Avi
 }  // namespace Plugin
 }  // namespace SmartMet
@@ -0,0 +1,175 @@
+#define BOOST_TEST_MODULE "QueryExecutorModule"
+
+#include "QueryExecutor.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+BOOST_AUTO_TEST_CASE(queryexecutor_submit)
+{
+  QueryExecutor executor(4, 100, 2, 10);
+  std::atomic<int> count{0};
+  std::promise<void> done;
+
+  for (int i = 0; (i < 100); i++)
+    BOOST_CHECK(executor.submit(
+        [&]()
+        {
+          if (++count == 100)
+            done.set_value();
+        }));
+
+  done.get_future().wait();
+  BOOST_CHECK_EQUAL(count, 100);
+}
+
+BOOST_AUTO_TEST_CASE(queryexecutor_queue_full)
+{
+  QueryExecutor executor(1, 2, 1, 2);
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::promise<void> started;
+
+  // The thread is blocked by the first task, the next two are queued
+
+  BOOST_CHECK(executor.submit(
+      [&]()
+      {
+        started.set_value();
+        released.wait();
+      }));
+  started.get_future().wait();
+
+  BOOST_CHECK(executor.submit([]() {}));
+  BOOST_CHECK(executor.submit([]() {}));
+  BOOST_CHECK(!executor.submit([]() {}));
+  BOOST_CHECK_EQUAL(executor.queued(), 2);
+
+  release.set_value();
+}
+
+BOOST_AUTO_TEST_CASE(queryexecutor_shutdown)
+{
+  // Queued tasks are discarded, which breaks their promises
+
+  QueryExecutor executor(1, 10, 1, 10);
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::promise<void> started;
+
+  BOOST_CHECK(executor.submit(
+      [&]()
+      {
+        started.set_value();
+        released.wait();
+      }));
+  started.get_future().wait();
+
+  auto task = std::make_shared<std::packaged_task<int()>>([]() { return 1; });
+  auto result = task->get_future();
+  BOOST_CHECK(executor.submit([task]() { (*task)(); }));
+  task.reset();
+
+  // Shutdown discards the queue before waiting for the running task
+
+  auto stopped = std::async(std::launch::async, [&]() { executor.shutdown(); });
+
+  while (executor.queued() > 0)
+    std::this_thread::yield();
+
+  release.set_value();
+  stopped.get();
+
+  BOOST_CHECK_THROW(result.get(), std::future_error);
+  BOOST_CHECK(!executor.submit([]() {}));
+}
+
+BOOST_AUTO_TEST_CASE(queryexecutor_priority)
+{
+  // Queued operational tasks are run before bulk tasks queued earlier
+
+  QueryExecutor executor(1, 10, 1, 10);
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::promise<void> started;
+  std::promise<void> done;
+  std::mutex mutex;
+  std::string order;
+
+  BOOST_CHECK(executor.submit(
+      [&]()
+      {
+        started.set_value();
+        released.wait();
+      }));
+  started.get_future().wait();
+
+  auto add = [&](char c)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    order += c;
+
+    if (order.size() == 3)
+      done.set_value();
+  };
+
+  BOOST_CHECK(executor.submit([&]() { add('b'); }, QueryExecutor::Priority::Bulk));
+  BOOST_CHECK(executor.submit([&]() { add('B'); }, QueryExecutor::Priority::Bulk));
+  BOOST_CHECK(executor.submit([&]() { add('o'); }));
+
+  release.set_value();
+  done.get_future().wait();
+  BOOST_CHECK_EQUAL(order, "obB");
+}
+
+BOOST_AUTO_TEST_CASE(queryexecutor_bulk_threads)
+{
+  // Bulk tasks can not occupy the threads reserved for operational tasks
+
+  QueryExecutor executor(2, 10, 1, 10);
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::promise<void> started;
+  std::promise<void> operational;
+  std::atomic<int> bulkRuns{0};
+
+  BOOST_CHECK(executor.submit(
+      [&]()
+      {
+        started.set_value();
+        released.wait();
+      },
+      QueryExecutor::Priority::Bulk));
+  started.get_future().wait();
+
+  BOOST_CHECK(executor.submit([&]() { bulkRuns++; }, QueryExecutor::Priority::Bulk));
+  BOOST_CHECK(executor.submit([&]() { operational.set_value(); }));
+
+  operational.get_future().wait();
+  BOOST_CHECK_EQUAL(bulkRuns, 0);
+  BOOST_CHECK_EQUAL(executor.queued(QueryExecutor::Priority::Bulk), 1);
+
+  // Bulk queue has its own limit
+
+  for (int i = 1; (i < 10); i++)
+    BOOST_CHECK(executor.submit([]() {}, QueryExecutor::Priority::Bulk));
+
+  BOOST_CHECK(!executor.submit([]() {}, QueryExecutor::Priority::Bulk));
+  BOOST_CHECK(executor.submit([]() {}));
+
+  release.set_value();
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,83 @@
+#define BOOST_TEST_MODULE "RequestArenaModule"
+
+#include "RequestArena.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+BOOST_AUTO_TEST_CASE(requestarena_allocate)
+{
+  RequestArena arena;
+  BOOST_CHECK_EQUAL(arena.bytesAllocated(), 0);
+
+  std::pmr::vector<long> values(&arena);
+  values.reserve(100);
+  BOOST_CHECK_EQUAL(arena.bytesAllocated(), 100 * sizeof(long));
+
+  for (long i = 0; (i < 100000); i++)
+    values.push_back(i);
+
+  BOOST_CHECK_EQUAL(values.back(), 99999);
+  BOOST_CHECK(arena.bytesAllocated() >= 100000 * sizeof(long));
+}
+
+BOOST_AUTO_TEST_CASE(requestarena_strings)
+{
+  RequestArena arena;
+
+  std::pmr::vector<std::pmr::string> strings(&arena);
+
+  for (int i = 0; (i < 1000); i++)
+    strings.emplace_back(std::string(100, static_cast<char>('a' + i % 26)));
+
+  BOOST_CHECK_EQUAL(strings[27], std::pmr::string(100, 'b'));
+  BOOST_CHECK(arena.bytesAllocated() >= 1000 * 100);
+}
+
+BOOST_AUTO_TEST_CASE(requestarena_concurrent)
+{
+  // Concurrent requests have their own arenas
+
+  std::vector<std::thread> threads;
+
+  for (int t = 0; (t < 4); t++)
+    threads.emplace_back(
+        []
+        {
+          for (int i = 0; (i < 100); i++)
+          {
+            RequestArena arena;
+            std::pmr::vector<char> buffer(200000, 'x', &arena);
+            BOOST_CHECK_EQUAL(buffer.back(), 'x');
+          }
+        });
+
+  for (auto &thread : threads)
+    thread.join();
+}
+
+BOOST_AUTO_TEST_CASE(requestarena_statistics)
+{
+  auto before = RequestArena::statistics();
+
+  {
+    RequestArena arena;
+    std::pmr::vector<char> buffer(5000000, 'x', &arena);
+  }
+
+  auto after = RequestArena::statistics();
+  BOOST_CHECK_EQUAL(after.inserts, before.inserts + 1);
+  BOOST_CHECK_EQUAL(after.size, before.size + 5000000);
+  BOOST_CHECK_EQUAL(after.maxsize, 5000000);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
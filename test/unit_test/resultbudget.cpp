@@ -0,0 +1,43 @@
+#define BOOST_TEST_MODULE "ResultBudgetModule"
+
+#include "ResultBudget.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+BOOST_AUTO_TEST_CASE(resultbudget_unlimited)
+{
+  ResultBudget budget(0);
+  budget.add(1000000000);
+  BOOST_CHECK_EQUAL(budget.bytes(), 1000000000);
+}
+
+BOOST_AUTO_TEST_CASE(resultbudget_values)
+{
+  ResultBudget budget(100);
+
+  SmartMet::Engine::Avi::ValueVector values{std::string(40, 'x'), 1.5, std::string(10, 'y')};
+  budget.add(values);
+  BOOST_CHECK_EQUAL(budget.bytes(), 66);
+
+  budget.add(34);
+  BOOST_CHECK_EQUAL(budget.bytes(), 100);
+
+  BOOST_CHECK_THROW(budget.add(values), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(resultbudget_check)
+{
+  BOOST_CHECK_NO_THROW(ResultBudget::check(100, 100));
+  BOOST_CHECK_NO_THROW(ResultBudget::check(1000000000, 0));
+  BOOST_CHECK_THROW(ResultBudget::check(101, 100), std::exception);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,123 @@
+#define BOOST_TEST_MODULE "RowSelectionClassModule"
+
+#include "RowSelection.h"
+
+#include <boost/test/included/unit_test.hpp>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+std::string messageTime(int minute)
+{
+  Fmi::DateTime t(Fmi::Date(2024, 1, 1), Fmi::TimeDuration(12, 0, 0));
+  return Fmi::to_iso_extended_string(t + Fmi::Minutes(minute)) + "Z";
+}
+
+void addMessage(Engine::Avi::StationQueryData& data,
+                Engine::Avi::StationIdType stationId,
+                int minute,
+                int messageId)
+{
+  auto& values = data.itsValues[stationId];
+  values["messagetime"].push_back(messageTime(minute));
+  values["messageid"].push_back(messageId);
+}
+
+std::vector<int> messageIds(Engine::Avi::StationQueryData& data,
+                            Engine::Avi::StationIdType stationId)
+{
+  std::vector<int> ids;
+
+  for (const auto& value : data.itsValues[stationId]["messageid"])
+    ids.push_back(std::get<int>(value));
+
+  return ids;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(rowselection_parse_interval)
+{
+  BOOST_CHECK_EQUAL(RowSelection::parseInterval("1h"), 3600);
+  BOOST_CHECK_EQUAL(RowSelection::parseInterval("30m"), 1800);
+  BOOST_CHECK_EQUAL(RowSelection::parseInterval("30"), 1800);
+  BOOST_CHECK_EQUAL(RowSelection::parseInterval("10min"), 600);
+  BOOST_CHECK_EQUAL(RowSelection::parseInterval("1D"), 86400);
+
+  BOOST_CHECK_THROW(RowSelection::parseInterval(""), std::exception);
+  BOOST_CHECK_THROW(RowSelection::parseInterval("0h"), std::exception);
+  BOOST_CHECK_THROW(RowSelection::parseInterval("-1h"), std::exception);
+  BOOST_CHECK_THROW(RowSelection::parseInterval("1w"), std::exception);
+  BOOST_CHECK_THROW(RowSelection::parseInterval("h"), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(rowselection_latest)
+{
+  Engine::Avi::StationQueryData data;
+  data.itsStationIds = {1, 2};
+
+  addMessage(data, 1, 0, 10);
+  addMessage(data, 1, 50, 11);
+  addMessage(data, 1, 20, 12);
+  addMessage(data, 1, 30, 13);
+  addMessage(data, 1, 50, 14);
+  addMessage(data, 2, 0, 20);
+
+  RowSelection(2, 0).apply(data);
+
+  // Latest rows in their original order; of equal times the later row is preferred
+
+  BOOST_CHECK((data.itsStationIds == Engine::Avi::StationIdList{1, 2}));
+  BOOST_CHECK((messageIds(data, 1) == std::vector<int>{11, 14}));
+  BOOST_CHECK((messageIds(data, 2) == std::vector<int>{20}));
+  BOOST_CHECK_EQUAL(data.itsValues[1]["messagetime"].size(), 2);
+
+  RowSelection(1, 0).apply(data);
+  BOOST_CHECK((messageIds(data, 1) == std::vector<int>{14}));
+}
+
+BOOST_AUTO_TEST_CASE(rowselection_sample)
+{
+  Engine::Avi::StationQueryData data;
+  data.itsStationIds = {1};
+
+  addMessage(data, 1, 0, 10);
+  addMessage(data, 1, 20, 11);
+  addMessage(data, 1, 50, 12);
+  addMessage(data, 1, 65, 13);
+  addMessage(data, 1, 200, 14);
+
+  // Latest message of each hour
+
+  auto sampled = data;
+  RowSelection(0, 3600).apply(sampled);
+  BOOST_CHECK((messageIds(sampled, 1) == std::vector<int>{12, 13, 14}));
+
+  // Latest two of the sampled messages
+
+  RowSelection(2, 3600).apply(data);
+  BOOST_CHECK((messageIds(data, 1) == std::vector<int>{13, 14}));
+}
+
+BOOST_AUTO_TEST_CASE(rowselection_missing_time)
+{
+  Engine::Avi::StationQueryData data;
+  data.itsStationIds = {1};
+
+  auto& values = data.itsValues[1];
+  values["messagetime"].push_back(TimeSeries::None());
+  values["messageid"].push_back(10);
+
+  // Messages without time are not sampled; stations without rows are removed
+
+  RowSelection(0, 600).apply(data);
+  BOOST_CHECK(data.itsStationIds.empty());
+  BOOST_CHECK(data.itsValues.empty());
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,189 @@
+#define BOOST_TEST_MODULE "StationIndexClassModule"
+
+#include "StationIndex.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <algorithm>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+std::vector<StationIndex::Station> stations()
+{
+  return {{7, "EFHK", 24.907, 60.316},
+          {8, "EFIV", 27.419, 68.613},
+          {22, "EFRO", 25.822, 66.562},
+          {30, "EFTU", 22.262, 60.514},
+          {31, "EFTP", 23.604, 61.414},
+          {40, "NZCH", 172.532, -43.489},
+          {41, "NZCI", -176.457, -43.810}};
+}
+
+std::vector<Engine::Avi::StationIdType> ids(const StationIndex::StationIdListPtr& list)
+{
+  BOOST_REQUIRE(list);
+  return {list->begin(), list->end()};
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(stationindex_constructor)
+{
+  StationIndex index(stations(), 10);
+  BOOST_CHECK_EQUAL(index.size(), 7);
+}
+
+BOOST_AUTO_TEST_CASE(stationindex_bbox)
+{
+  StationIndex index(stations(), 10);
+  Engine::Avi::LocationOptions options;
+  options.itsBBoxes.emplace_back(24.9, 24.92, 60.31, 60.32);
+  options.itsBBoxes.emplace_back(27.417, 27.42, 68.612, 68.614);
+  options.itsMaxDistance = 0;
+
+  auto result = ids(index.resolve(options));
+  BOOST_CHECK((result == std::vector<Engine::Avi::StationIdType>{7, 8}));
+
+  // Station outside the bbox but within maxdistance
+
+  options.itsBBoxes.clear();
+  options.itsBBoxes.emplace_back(24.95, 25.0, 60.31, 60.32);
+  BOOST_CHECK(ids(index.resolve(options)).empty());
+  options.itsMaxDistance = 5000;
+  BOOST_CHECK((ids(index.resolve(options)) == std::vector<Engine::Avi::StationIdType>{7}));
+}
+
+BOOST_AUTO_TEST_CASE(stationindex_nearest)
+{
+  StationIndex index(stations(), 10);
+  Engine::Avi::LocationOptions options;
+  options.itsLonLats.emplace_back(24.916970, 60.325830);
+  options.itsMaxDistance = 2000;
+  options.itsNumberOfNearestStations = 1;
+  BOOST_CHECK((ids(index.resolve(options)) == std::vector<Engine::Avi::StationIdType>{7}));
+
+  // Nearest 3 within 300km, returned in icao order
+
+  options.itsMaxDistance = 300000;
+  options.itsNumberOfNearestStations = 3;
+  BOOST_CHECK((ids(index.resolve(options)) == std::vector<Engine::Avi::StationIdType>{7, 31, 30}));
+
+  // Across the dateline
+
+  options.itsLonLats.clear();
+  options.itsLonLats.emplace_back(179.9, -43.7);
+  options.itsMaxDistance = 700000;
+  options.itsNumberOfNearestStations = 1;
+  BOOST_CHECK((ids(index.resolve(options)) == std::vector<Engine::Avi::StationIdType>{41}));
+}
+
+BOOST_AUTO_TEST_CASE(stationindex_route)
+{
+  StationIndex index(stations(), 10);
+  Engine::Avi::LocationOptions options;
+  options.itsWKTs.itsWKTs.push_back("LINESTRING(27.413 68.607, 25.822 66.562,24.906 60.315)");
+  options.itsMaxDistance = 10000;
+
+  BOOST_CHECK(StationIndex::isRoute(options));
+  BOOST_CHECK((ids(index.resolve(options)) == std::vector<Engine::Avi::StationIdType>{8, 22, 7}));
+}
+
+BOOST_AUTO_TEST_CASE(stationindex_polygon)
+{
+  StationIndex index(stations(), 10);
+  Engine::Avi::LocationOptions options;
+  options.itsWKTs.itsWKTs.push_back(
+      "POLYGON((24.9 60.31,24.9 60.32,24.92 60.32,24.92 60.31,24.9 60.31))");
+  options.itsMaxDistance = 0;
+
+  BOOST_CHECK(!StationIndex::isRoute(options));
+  BOOST_CHECK((ids(index.resolve(options)) == std::vector<Engine::Avi::StationIdType>{7}));
+}
+
+BOOST_AUTO_TEST_CASE(stationindex_unresolvable)
+{
+  StationIndex index(stations(), 10);
+  Engine::Avi::LocationOptions options;
+  options.itsWKTs.itsWKTs.push_back("MULTIPOINT((24.9 60.31))");
+  options.itsMaxDistance = 0;
+  BOOST_CHECK(!index.resolve(options));
+
+  options.itsWKTs.itsWKTs.clear();
+  options.itsIcaos.push_back("EFHK");
+  BOOST_CHECK(!StationIndex::resolvable(options));
+  BOOST_CHECK(!index.resolve(options));
+}
+
+BOOST_AUTO_TEST_CASE(stationindex_antimeridian)
+{
+  StationIndex index(stations(), 10);
+  Engine::Avi::LocationOptions options;
+  options.itsBBoxes.emplace_back(170, -170, -50, -40);
+  options.itsMaxDistance = 0;
+  BOOST_CHECK(!index.resolve(options));
+
+  options.itsBBoxes.clear();
+  options.itsWKTs.itsWKTs.push_back("LINESTRING(172 -43.5,-176 -43.8)");
+  options.itsMaxDistance = 10000;
+  BOOST_CHECK(!index.resolve(options));
+
+  options.itsWKTs.itsWKTs.clear();
+  options.itsWKTs.itsWKTs.push_back("POLYGON((170 -50,-170 -50,-170 -40,170 -40,170 -50))");
+  BOOST_CHECK(!index.resolve(options));
+
+  // Areas near the antimeridian not crossing it are resolved
+
+  options.itsWKTs.itsWKTs.clear();
+  options.itsWKTs.itsWKTs.push_back("POLYGON((172 -44,173 -44,173 -43,172 -43,172 -44))");
+  options.itsMaxDistance = 0;
+  BOOST_CHECK((ids(index.resolve(options)) == std::vector<Engine::Avi::StationIdType>{40}));
+}
+
+BOOST_AUTO_TEST_CASE(stationindex_query_options)
+{
+  Engine::Avi::QueryOptions options;
+  options.itsTimeOptions.itsObservationTime = "current_timestamp";
+  options.itsParameters = {"icao", "message"};
+  options.itsLocationOptions.itsBBoxes.emplace_back(24.9, 24.92, 60.31, 60.32);
+  BOOST_CHECK(StationIndex::resolvable(options));
+
+  // Stations are valid at current time
+
+  options.itsTimeOptions.itsObservationTime = "timestamptz '20101010T101020Z'";
+  BOOST_CHECK(!StationIndex::resolvable(options));
+
+  options.itsTimeOptions.itsObservationTime.clear();
+  options.itsTimeOptions.itsStartTime = "timestamptz '20101010T101020Z'";
+  options.itsTimeOptions.itsEndTime = "timestamptz '20101011T101020Z'";
+  BOOST_CHECK(!StationIndex::resolvable(options));
+
+  options.itsTimeOptions = Engine::Avi::TimeOptions();
+  options.itsTimeOptions.itsObservationTime = "current_timestamp";
+  options.itsValidity = Engine::Avi::Validity::Rejected;
+  BOOST_CHECK(!StationIndex::resolvable(options));
+  options.itsValidity = Engine::Avi::Validity::Accepted;
+
+  // Nearest station queries for messages other than AWSMETAR exclude AWS stations
+
+  options.itsLocationOptions = Engine::Avi::LocationOptions();
+  options.itsLocationOptions.itsLonLats.emplace_back(24.916970, 60.325830);
+  BOOST_CHECK(!StationIndex::resolvable(options));
+
+  options.itsLocationOptions = Engine::Avi::LocationOptions();
+  options.itsLocationOptions.itsWKTs.itsWKTs.push_back("POINT(24.916970 60.325830)");
+  BOOST_CHECK(!StationIndex::resolvable(options));
+
+  options.itsMessageTypes = {"AWSMETAR"};
+  BOOST_CHECK(StationIndex::resolvable(options));
+
+  options.itsMessageTypes = {"METAR"};
+  options.itsParameters = {"icao", "name", "lonlat"};
+  BOOST_CHECK(StationIndex::resolvable(options));
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,127 @@
+#define BOOST_TEST_MODULE "SubscriptionHubClassModule"
+
+#include "SubscriptionHub.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <chrono>
+#include <thread>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+namespace
+{
+// Stand-in message source
+
+MessageMonitor::Messages messages(long firstId)
+{
+  return {{7, "EFHK", "METAR", firstId, "2024-01-01T12:20:00Z", "METAR EFHK 011220Z ..."},
+          {7, "EFHK", "TAF", firstId + 1, "2024-01-01T11:30:00Z", "TAF EFHK 011130Z ..."},
+          {8, "EFIV", "METAR", firstId + 2, "2024-01-01T12:20:00Z", "METAR EFIV 011220Z ..."}};
+}
+
+std::size_t events(const std::string& chunk)
+{
+  std::size_t count = 0;
+
+  for (auto pos = chunk.find("event: message"); (pos != std::string::npos);
+       pos = chunk.find("event: message", pos + 1))
+    count++;
+
+  return count;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(subscriptionhub_filter)
+{
+  auto hub = std::make_shared<SubscriptionHub>(10, 1, 10);
+
+  SubscriptionHub::Filter filter;
+  filter.itsIcaos.insert("EFHK");
+  filter.itsMessageTypes.insert("METAR");
+
+  auto stream = hub->subscribe(filter, std::nullopt);
+  BOOST_REQUIRE(stream);
+  BOOST_CHECK_EQUAL(hub->subscribers(), 1);
+
+  BOOST_CHECK_EQUAL(stream->getChunk(), "retry: 5000\n\n");
+
+  hub->publish(messages(100));
+
+  auto chunk = stream->getChunk();
+  BOOST_CHECK_EQUAL(events(chunk), 1);
+  BOOST_CHECK(chunk.find("\"messageid\":100") != std::string::npos);
+
+  // Nothing is sent before the keepalive interval has passed, and the stream does not wait
+
+  BOOST_CHECK_EQUAL(stream->getChunk(), "");
+  BOOST_CHECK(stream->getStatus() == SmartMet::Spine::HTTP::ContentStreamer::StreamerStatus::OK);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  BOOST_CHECK_EQUAL(stream->getChunk(), ": keepalive\n\n");
+  BOOST_CHECK_EQUAL(stream->getChunk(), "");
+
+  stream.reset();
+  BOOST_CHECK_EQUAL(hub->subscribers(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(subscriptionhub_message_filter)
+{
+  auto hub = std::make_shared<SubscriptionHub>(10, 1, 10);
+
+  SubscriptionHub::Filter filter;
+  filter.itsMessageFilter =
+      std::make_shared<MessageFilter>(std::vector<std::string>{}, std::vector<std::string>{"TAF"});
+
+  auto stream = hub->subscribe(filter, std::nullopt);
+  BOOST_REQUIRE(stream);
+  BOOST_CHECK_EQUAL(stream->getChunk(), "retry: 5000\n\n");
+
+  hub->publish(messages(100));
+
+  auto chunk = stream->getChunk();
+  BOOST_CHECK_EQUAL(events(chunk), 1);
+  BOOST_CHECK(chunk.find("\"messageid\":101") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(subscriptionhub_last_event_id)
+{
+  auto hub = std::make_shared<SubscriptionHub>(4, 1, 10);
+
+  hub->publish(messages(100));
+
+  // Events after id 1 are still buffered
+
+  auto stream = hub->subscribe(SubscriptionHub::Filter(), 1);
+  stream->getChunk();
+  BOOST_CHECK_EQUAL(events(stream->getChunk()), 2);
+
+  // Subscriber falling behind loses overwritten events
+
+  auto lagging = hub->subscribe(SubscriptionHub::Filter(), std::nullopt);
+  lagging->getChunk();
+  hub->publish(messages(200));
+  hub->publish(messages(300));
+  BOOST_CHECK_EQUAL(events(lagging->getChunk()), 4);
+}
+
+BOOST_AUTO_TEST_CASE(subscriptionhub_limits)
+{
+  auto hub = std::make_shared<SubscriptionHub>(10, 1, 1);
+
+  auto stream = hub->subscribe(SubscriptionHub::Filter(), std::nullopt);
+  BOOST_CHECK(stream);
+  BOOST_CHECK(!hub->subscribe(SubscriptionHub::Filter(), std::nullopt));
+
+  stream->getChunk();
+  hub->shutdown();
+  BOOST_CHECK_EQUAL(stream->getChunk(), "");
+  BOOST_CHECK(stream->getStatus() ==
+              SmartMet::Spine::HTTP::ContentStreamer::StreamerStatus::EXIT_OK);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet
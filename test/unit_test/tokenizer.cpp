@@ -0,0 +1,98 @@
+#define BOOST_TEST_MODULE "TokenizerModule"
+
+#include "Tokenizer.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <array>
+#include <cstddef>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Avi
+{
+BOOST_AUTO_TEST_CASE(tokenizer_icaos)
+{
+  Tokenizer::ValueList icaos;
+  Tokenizer::parseValueList(" EFHK, efro ,12abcDE#)", "icaos", icaos);
+  BOOST_CHECK((icaos == Tokenizer::ValueList{"EFHK", "efro", "12abcDE#)"}));
+
+  BOOST_CHECK_THROW(Tokenizer::parseValueList("EFHK,,EFRO", "icaos", icaos), std::exception);
+  BOOST_CHECK_THROW(Tokenizer::parseValueList("EFHK, ", "icaos", icaos), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(tokenizer_coordinates)
+{
+  Tokenizer::LonLatList lonlats;
+  Tokenizer::parseCoordinateList("24.9,60.3, -176.5,-43.8", "lonlats", false, 0, lonlats);
+  BOOST_REQUIRE_EQUAL(lonlats.size(), 2);
+  BOOST_CHECK_EQUAL(lonlats[1].first, -176.5);
+  BOOST_CHECK_EQUAL(lonlats[1].second, -43.8);
+
+  lonlats.clear();
+  Tokenizer::parseCoordinateList("60.3,24.9", "latlon", true, 1, lonlats);
+  BOOST_REQUIRE_EQUAL(lonlats.size(), 1);
+  BOOST_CHECK_EQUAL(lonlats[0].first, 24.9);
+
+  BOOST_CHECK_THROW(Tokenizer::parseCoordinateList("24.9,60.3,25", "lonlats", false, 0, lonlats),
+                    std::exception);
+  BOOST_CHECK_THROW(Tokenizer::parseCoordinateList("24.9,60.3,25,26", "lonlat", false, 1, lonlats),
+                    std::exception);
+  BOOST_CHECK_THROW(Tokenizer::parseCoordinateList("24.9,91", "lonlat", false, 1, lonlats),
+                    std::exception);
+  BOOST_CHECK_THROW(Tokenizer::parseCoordinateList("24.9x,60", "lonlat", false, 1, lonlats),
+                    std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(tokenizer_values)
+{
+  std::array<std::byte, 256> buffer;
+  std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+
+  Tokenizer::ValueList values(&arena);
+  Tokenizer::parseValueList("metar, taf ,speci", "messagetype", values);
+  BOOST_CHECK((values == Tokenizer::ValueList{"metar", "taf", "speci"}));
+
+  BOOST_CHECK_THROW(Tokenizer::parseValueList("metar,", "messagetype", values), std::exception);
+
+  Tokenizer::StationIdList stationIds(&arena);
+  Tokenizer::parseStationIdList("7, 8,22", "stationids", stationIds);
+  BOOST_CHECK((stationIds == Tokenizer::StationIdList{7, 8, 22}));
+
+  BOOST_CHECK_THROW(Tokenizer::parseStationIdList("7,x", "stationids", stationIds),
+                    std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(tokenizer_form)
+{
+  std::vector<std::pair<std::string, std::string>> params;
+  Tokenizer::forEachFormParameter("icaos=EFHK%2CEFRO&param=icao,message&&place=Helsinki+Vantaa",
+                                  [&](std::string name, std::string value)
+                                  { params.emplace_back(name, value); });
+
+  BOOST_REQUIRE_EQUAL(params.size(), 3);
+  BOOST_CHECK_EQUAL(params[0].second, "EFHK,EFRO");
+  BOOST_CHECK_EQUAL(params[2].second, "Helsinki Vantaa");
+}
+
+BOOST_AUTO_TEST_CASE(tokenizer_json)
+{
+  std::vector<std::pair<std::string, std::string>> params;
+  Tokenizer::parseJsonObject(
+      R"json({"icao": ["EFHK", "EFRO"], "param": "icao,message", "maxdistance": 50,
+          "wkt": "POINT (24.9 60.3)", "place": "Sein\u00e4joki"})json",
+      params);
+
+  BOOST_REQUIRE_EQUAL(params.size(), 6);
+  BOOST_CHECK_EQUAL(params[1].first, "icao");
+  BOOST_CHECK_EQUAL(params[1].second, "EFRO");
+  BOOST_CHECK_EQUAL(params[3].second, "50");
+  BOOST_CHECK_EQUAL(params[5].second, "Sein\xc3\xa4joki");
+
+  BOOST_CHECK_THROW(Tokenizer::parseJsonObject(R"({"icao": {"a": 1}})", params), std::exception);
+  BOOST_CHECK_THROW(Tokenizer::parseJsonObject(R"({"icao": "EFHK")", params), std::exception);
+}
+}  // namespace Avi
+}  // namespace Plugin
+}  // namespace SmartMet